@@ -2,20 +2,26 @@
 
 #include "analytics/models.h"
 
-#include <unordered_map>
 #include <vector>
 
 namespace analytics {
 
 class AlertEngine {
  public:
-  AlertEngine(double jump_threshold = 5.0, double spread_threshold = 10.0);
+  // liquidity_drop_threshold: fraction of resting depth (bid + ask) that must vanish
+  // between two book-backed features to raise liquidity_withdrawal.
+  AlertEngine(double jump_threshold = 5.0, double spread_threshold = 10.0, double liquidity_drop_threshold = 0.5);
   std::vector<Alert> Evaluate(const FeatureRow &feature);
+  // Seeds the previous feature of a ticker not yet evaluated (e.g. from storage at
+  // startup) without raising alerts.
+  void Restore(const FeatureRow &feature);
 
  private:
   double jump_threshold_;
   double spread_threshold_;
-  std::unordered_map<std::string, FeatureRow> last_feature_;
+  double liquidity_drop_threshold_;
+  // Indexed by ticker id; a slot whose ticker is kNoTicker has not been seen yet.
+  std::vector<FeatureRow> last_feature_;
 };
 
 }  // namespace analytics
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "analytics/models.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace analytics {
+
+// Remembers a fingerprint of the last snapshot ingested per ticker so idle markets can
+// be dropped before any storage or alert work. The fingerprint covers every field that
+// feeds features or the markets table except updated_at, which moves on every poll.
+class ChangeDetector {
+ public:
+  // Returns true (and records the new fingerprint) when the ticker is new or any
+  // tracked field differs from the previous snapshot.
+  bool Changed(const MarketSnapshot &snapshot);
+  // Records the fingerprint of a ticker not seen yet (e.g. its stored markets row at
+  // startup) without counting it as processed.
+  void Restore(const MarketSnapshot &snapshot);
+
+  static uint64_t Fingerprint(const MarketSnapshot &snapshot);
+
+  uint64_t processed() const { return processed_.load(std::memory_order_relaxed); }
+  uint64_t skipped() const { return skipped_.load(std::memory_order_relaxed); }
+  size_t tracked() const;
+
+ private:
+  mutable std::mutex mutex_;
+  // Indexed by ticker id.
+  std::vector<uint64_t> fingerprints_;
+  size_t tracked_ = 0;
+  std::atomic<uint64_t> processed_{0};
+  std::atomic<uint64_t> skipped_{0};
+};
+
+}  // namespace analytics
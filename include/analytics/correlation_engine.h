@@ -0,0 +1,124 @@
+#pragma once
+
+#include "analytics/models.h"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace analytics {
+
+struct CorrelationOptions {
+  // Tickers tracked at once. The statistics take 24 bytes per ordered pair of slots in
+  // use (about 25 MB at 1024); tickers seen while every slot is taken are not tracked.
+  size_t max_tickers = 1024;
+  // Steps after which a sample counts half as much; 0 weighs the whole history equally.
+  double half_life_steps = 120;
+  // Pairs observed together for fewer (decayed) steps than this have no correlation.
+  double min_samples = 10;
+  // A tracked ticker not observed for this many steps gives up its slot.
+  uint64_t idle_steps = 1000;
+  // Use the AVX2/FMA kernels when the CPU has them.
+  bool simd = true;
+};
+
+struct CorrelationStats {
+  size_t tracked = 0;
+  uint64_t steps = 0;
+  uint64_t admitted = 0;
+  uint64_t evicted = 0;         // idle tickers that gave up their slot
+  uint64_t not_tracked = 0;     // first sightings while every slot was taken
+  double last_step_seconds = 0.0;
+  const char *kernels = "";     // "avx2" or "scalar"
+};
+
+// Correlations of the requested tickers, in request order.
+struct CorrelationMatrix {
+  std::vector<TickerId> tickers;    // tracked ones
+  std::vector<TickerId> untracked;  // requested but not tracked
+  // Row-major, tickers.size() squared; NaN where a pair has too few samples or no
+  // movement. The diagonal is 1.
+  std::vector<double> values;
+  uint64_t steps = 0;
+};
+
+// Pairwise Pearson correlation of mid-price changes over many markets, kept up to date
+// incrementally. Every tracked ticker contributes one return per step (its mid change
+// since the previous step, 0 when it did not move), weighted by exponential decay.
+//
+// For each pair the engine keeps the sufficient statistics over the steps both were
+// tracked: sums and sums of squares of each side, and the cross products. The sums are
+// stored scaled by a global decay factor, so a ticker that did not move costs nothing
+// in a step and one that did updates its rows with vectorised kernels. The number of
+// shared steps follows from admission times, so it needs no storage.
+class CorrelationEngine {
+ public:
+  explicit CorrelationEngine(CorrelationOptions options = {});
+
+  // Latest mid of ticker, from any ingest path. Starts tracking it while slots are free.
+  void Observe(TickerId ticker, double mid);
+  // Closes a step (the server takes one per refresh).
+  void Step();
+
+  CorrelationMatrix Correlations(const std::vector<TickerId> &tickers) const;
+
+  uint64_t steps() const;
+  CorrelationStats stats() const;
+  const CorrelationOptions &options() const { return options_; }
+
+ private:
+  static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+  struct Slot {
+    TickerId ticker = kNoTicker;
+    double mid = 0.0;       // latest observed
+    double base_mid = 0.0;  // as of the last step
+    uint64_t joined = 0;    // first step that counts for it
+    uint64_t last_seen = 0;
+  };
+
+  // Requires mutex_.
+  uint32_t Admit(TickerId ticker, double mid);
+  void Reserve(size_t slots);
+  void ClearSlot(uint32_t slot);
+  // Folds the pending decay into the stored sums.
+  void Renormalise();
+  // Decayed number of steps since slot was admitted.
+  double SharedWeight(uint32_t slot) const;
+  // n is the pair's shared weight.
+  double Correlation(uint32_t a, uint32_t b, double n) const;
+
+  CorrelationOptions options_;
+  double decay_;  // per step
+  mutable std::mutex mutex_;
+
+  std::vector<uint32_t> slot_of_;  // indexed by ticker id
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> free_slots_;
+
+  // stride_ x stride_, row-major over slots:
+  //   sums_[a][b]    sum of a's returns over the steps a and b were both tracked
+  //   squares_[a][b] the same for a's squared returns
+  //   cross_[a][b]   (a < b) sum of a's return times b's
+  // all divided by scale_.
+  size_t stride_ = 0;
+  std::vector<double> sums_;
+  std::vector<double> squares_;
+  std::vector<double> cross_;
+  // Stored sums times scale_ are the true decayed sums; scale_ = decay_^(steps since the
+  // last Renormalise()).
+  double scale_ = 1.0;
+
+  // Per step; reused.
+  std::vector<double> returns_;
+  std::vector<uint32_t> moved_;
+
+  uint64_t steps_ = 0;
+  uint64_t admitted_ = 0;
+  uint64_t evicted_ = 0;
+  uint64_t not_tracked_ = 0;
+  double last_step_seconds_ = 0.0;
+  bool avx2_ = false;
+};
+
+}  // namespace analytics
@@ -1,15 +1,32 @@
 #pragma once
 
+#include "analytics/market_parser.h"
 #include "analytics/models.h"
+#include "analytics/order_book.h"
+
+#include <string_view>
 
 #include <nlohmann/json.hpp>
 
 namespace analytics {
 
+// Midpoint of the quoted spread, or the last trade without a two-sided quote; 0 when
+// neither is known.
+double MidPrice(const MarketSnapshot &snapshot);
+
 class FeatureEngine {
  public:
+  // depth_levels is the N in the depth-at-N / imbalance features.
+  explicit FeatureEngine(int depth_levels = 5);
+
   MarketSnapshot ParseMarketSnapshot(const nlohmann::json &market) const;
-  FeatureRow ComputeFeatures(const MarketSnapshot &snapshot) const;
+  // Streaming path for whole /markets pages; see analytics::ParseMarketBatch.
+  bool ParseMarketBatch(std::string_view body, MarketBatch *batch) const;
+  // book, when given and non-empty, adds depth, imbalance and microprice.
+  FeatureRow ComputeFeatures(const MarketSnapshot &snapshot, const OrderBook *book = nullptr) const;
+
+ private:
+  int depth_levels_;
 };
 
 }  // namespace analytics
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "analytics/models.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace analytics {
+
+// One /markets page decoded straight from the response bytes. raw_json[i] is a view of
+// the i-th market object inside the body that was parsed, so the body must outlive
+// the batch.
+struct MarketBatch {
+  std::vector<MarketSnapshot> snapshots;
+  std::vector<std::string_view> raw_json;
+  std::string cursor;
+
+  void Clear() {
+    snapshots.clear();
+    raw_json.clear();
+    cursor.clear();
+  }
+};
+
+// Single-pass scanner over a /markets response ({"markets": [...], "cursor": "..."} or a
+// bare array). Only the fields MarketSnapshot needs are decoded; everything else is
+// skipped without building a DOM. Returns false on malformed input.
+bool ParseMarketBatch(std::string_view body, MarketBatch *batch);
+
+}  // namespace analytics
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace analytics {
 
+// Interned market ticker (see TickerRegistry); names are only looked up at the API,
+// spill and JSON boundaries.
+using TickerId = uint32_t;
+constexpr TickerId kNoTicker = 0;
+
+// Timestamps are unix nanoseconds (0 = unknown) and are formatted as ISO-8601 only when
+// they leave the process.
 struct MarketSnapshot {
-  std::string ticker;
+  TickerId ticker = kNoTicker;
   std::string event_ticker;
   std::string status;
   std::string category;
@@ -13,21 +21,43 @@ struct MarketSnapshot {
   double yes_ask = 0.0;
   double last_price = 0.0;
   double volume = 0.0;
-  std::string updated_at;
+  int64_t updated_at = 0;
 };
 
 struct FeatureRow {
-  std::string ticker;
-  std::string ts;
+  TickerId ticker = kNoTicker;
+  int64_t ts = 0;
   double mid = 0.0;
   double spread = 0.0;
   double prob = 0.0;
   double volume = 0.0;
+  // Orderbook features; only meaningful when has_book (a streamed L2 book was available).
+  bool has_book = false;
+  double bid_depth = 0.0;  // contracts on the best N YES bid levels
+  double ask_depth = 0.0;  // contracts on the best N YES ask (NO bid) levels
+  double imbalance = 0.0;  // (bid_depth - ask_depth) / (bid_depth + ask_depth)
+  double microprice = 0.0;
+};
+
+// A rollup bucket of feature history: OHLC of mid plus the last spread/prob/volume.
+struct FeatureBar {
+  TickerId ticker = kNoTicker;
+  int64_t ts = 0;   // bucket start
+  int seconds = 0;  // bucket width
+  double open = 0.0;
+  double high = 0.0;
+  double low = 0.0;
+  double close = 0.0;
+  double spread = 0.0;
+  double prob = 0.0;
+  double volume = 0.0;
+  double volume_delta = 0.0;  // volume traded during the bucket
+  int samples = 0;
 };
 
 struct Alert {
-  std::string ticker;
-  std::string ts;
+  TickerId ticker = kNoTicker;
+  int64_t ts = 0;
   std::string type;
   double score = 0.0;
   std::string details;
@@ -38,7 +68,7 @@ struct EventSummary {
   std::string category;
   int market_count = 0;
   double total_volume = 0.0;
-  std::string updated_at;
+  int64_t updated_at = 0;
 };
 
 }  // namespace analytics
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+
+namespace analytics {
+
+// L2 book for one binary market, held as two flat arrays of resting quantity indexed
+// by price in cents (1..99): YES bids and NO bids. A NO bid at p is a YES offer at
+// 100 - p, so the YES ask side is read off the NO array. Level updates are O(1); the
+// cached best prices are only rescanned when the best level empties.
+class OrderBook {
+ public:
+  static constexpr int kMinPrice = 1;
+  static constexpr int kMaxPrice = 99;
+
+  void Clear();
+  // Out-of-range prices are ignored; quantities are clamped at zero.
+  void SetLevel(bool yes_side, int price, long quantity);
+  void ApplyDelta(bool yes_side, int price, long delta);
+
+  bool empty() const { return best_yes_ == 0 && best_no_ == 0; }
+  // 0 when that side is empty.
+  int BestYesBid() const { return best_yes_; }
+  int BestYesAsk() const { return best_no_ > 0 ? 100 - best_no_ : 0; }
+  long QuantityAt(bool yes_side, int price) const;
+
+  // Resting quantity on the best `levels` price levels of each side.
+  long BidDepth(int levels) const { return Depth(yes_, best_yes_, levels); }
+  long AskDepth(int levels) const { return Depth(no_, best_no_, levels); }
+  // (bid - ask) / (bid + ask) over `levels` levels, in [-1, 1]; 0 for an empty book.
+  double Imbalance(int levels) const;
+  // Size-weighted mid of the touch: leans toward the side with less resting size.
+  // Falls back to the plain mid (or the one quoted side) when a side is empty.
+  double Microprice() const;
+
+ private:
+  using Levels = std::array<long, kMaxPrice + 1>;
+
+  static long Depth(const Levels &levels, int best, int count);
+  static int ScanDown(const Levels &levels, int from);
+
+  Levels yes_{};
+  Levels no_{};
+  int best_yes_ = 0;
+  int best_no_ = 0;
+};
+
+}  // namespace analytics
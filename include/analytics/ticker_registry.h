@@ -0,0 +1,51 @@
+#pragma once
+
+#include "analytics/models.h"
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace analytics {
+
+// Process-wide table of interned market tickers. Ids are dense (1, 2, ...) and never
+// reused, so per-ticker state can live in vectors indexed by id, and names stay valid
+// for the life of the process. SQLiteStore persists the table so ids survive restarts.
+class TickerRegistry {
+ public:
+  static TickerRegistry &Global();
+
+  // kNoTicker for an empty ticker.
+  TickerId Intern(std::string_view ticker);
+  // kNoTicker when the ticker was never interned; never adds one.
+  TickerId Find(std::string_view ticker) const;
+  // Empty for kNoTicker and unknown ids.
+  const std::string &Name(TickerId id) const;
+
+  // Registers a persisted id. False when the ticker or the id is already bound to
+  // something else.
+  bool Adopt(TickerId id, std::string_view ticker);
+
+  // Highest id handed out so far.
+  TickerId max_id() const;
+
+ private:
+  mutable std::shared_mutex mutex_;
+  // Indexed by id; slot 0 (kNoTicker) and ids skipped by Adopt stay null.
+  std::vector<std::unique_ptr<const std::string>> names_;
+  // Keys view the strings owned by names_.
+  std::unordered_map<std::string_view, TickerId> ids_;
+};
+
+inline TickerId InternTicker(std::string_view ticker) {
+  return TickerRegistry::Global().Intern(ticker);
+}
+
+inline const std::string &TickerName(TickerId id) {
+  return TickerRegistry::Global().Name(id);
+}
+
+}  // namespace analytics
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+namespace server {
+class HttpServer;
+}
+
+namespace bench {
+
+// Each benchmark logs its results via spdlog and returns a process exit code.
+
+// Signatures/sec with a fresh signer per request (the old path) and with the cached,
+// shared signer across 1..threads threads. Generates a throwaway RSA key when
+// private_key_path is empty.
+int RunSignerBenchmark(const std::string &private_key_path, int threads, double seconds);
+
+// Read latency (p50/p99/max) from `readers` threads hitting the query methods while a
+// writer runs back-to-back full refreshes of `markets` markets: on a single
+// rollback-journal connection, in WAL mode with a reader pool, and with /markets and
+// /events served from the in-memory market table. Uses a scratch database under /tmp.
+int RunStoreBenchmark(int readers, int markets, double seconds);
+
+// Writes `rows` feature snapshots for each of `markets` tickers into the SQLite features
+// table and into the columnar time-series store, then compares disk footprint, append
+// rate, full-history scans and latest-50 reads. Uses scratch files under /tmp.
+int RunTimeSeriesBenchmark(int markets, int rows);
+
+// Per-step cost of the rolling correlation engine for 100, 500 and 1000 tickers over
+// `steps` steps of a synthetic factor model, with every ticker moving and with a tenth
+// of them moving, on the AVX2 and scalar kernels; the cost of one full-matrix query;
+// and, for comparison, a from-scratch Pearson recompute over a 240-step window. Fails
+// when the undecayed engine disagrees with a direct computation.
+int RunCorrelationBenchmark(int steps);
+
+// Feeds the /markets pages of a capture file (KALSHI_CAPTURE_PATH) through server's
+// ingest pipeline, preserving the original inter-arrival gaps divided by speed
+// (speed <= 0 replays as fast as possible). Reports throughput and per-stage latency.
+int RunReplay(server::HttpServer &server, const std::string &capture_path, double speed);
+
+}  // namespace bench
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "utils/http_client.h"
+#include "utils/rate_limiter.h"
 
+#include <future>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -9,11 +12,18 @@
 
 namespace kalshi {
 
+class KalshiSigner;
+
 struct KalshiClientConfig {
   std::string base_url;
   std::string api_key;
   std::string private_key_path;
   bool use_demo = false;
+  // Outbound request budget shared by every call (0 = unlimited).
+  double requests_per_second = 10.0;
+  double burst = 10.0;
+  // How many times a 429 is retried (honouring Retry-After) before it is returned.
+  int max_retries = 3;
 };
 
 class KalshiClient {
@@ -24,17 +34,41 @@ class KalshiClient {
   nlohmann::json GetMarket(const std::string &ticker);
   nlohmann::json GetEvents(int limit = 100, const std::string &cursor = "");
 
+  // Non-blocking variants: the request is in flight as soon as these return and the
+  // JSON is parsed on the thread that calls get().
+  std::future<nlohmann::json> GetMarketsAsync(int limit = 100, const std::string &cursor = "");
+  std::future<nlohmann::json> GetMarketAsync(const std::string &ticker);
+  std::future<nlohmann::json> GetEventsAsync(int limit = 100, const std::string &cursor = "");
+
+  // Unparsed /markets page, for callers that decode the body themselves.
+  std::future<utils::HttpResponse> GetMarketsRawAsync(int limit = 100, const std::string &cursor = "");
+
   // Requires auth
   nlohmann::json GetPortfolio();
 
+  bool HasAuth() const;
+  // Auth headers for a bodyless request to path, e.g. the WebSocket upgrade.
+  std::map<std::string, std::string> SignedHeaders(const std::string &method, const std::string &path) const;
+
+  const utils::RateLimiter &limiter() const { return *limiter_; }
+  const utils::HttpClient &http() const { return *http_; }
+
  private:
+  // Every request funnels through here: waits for a rate-limit token, and retries 429s
+  // after backing off the shared limiter. Retries happen on the thread calling get().
+  std::future<utils::HttpResponse> Send(const std::string &path, bool sign);
+
   std::string BuildUrl(const std::string &path) const;
+  std::string ListPath(const std::string &resource, int limit, const std::string &cursor) const;
   std::map<std::string, std::string> BuildAuthHeaders(const std::string &method,
                                                       const std::string &path,
                                                       const std::string &body) const;
 
   KalshiClientConfig config_;
   std::shared_ptr<utils::HttpClient> http_;
+  // Loaded once from config_.private_key_path; null when auth is not configured.
+  std::shared_ptr<KalshiSigner> signer_;
+  std::shared_ptr<utils::RateLimiter> limiter_;
 };
 
 }  // namespace kalshi
@@ -2,20 +2,37 @@
 
 #include <openssl/evp.h>
 
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace kalshi {
 
+// Holds the parsed private key and a signing context primed with the RSA-PSS
+// parameters. Safe to share across threads: each signature runs on a context
+// checked out from a small pool and cloned from the primed one, so nothing is
+// re-read or re-initialised per request.
 class KalshiSigner {
  public:
   explicit KalshiSigner(const std::string &private_key_pem_path);
   ~KalshiSigner();
 
+  KalshiSigner(const KalshiSigner &) = delete;
+  KalshiSigner &operator=(const KalshiSigner &) = delete;
+
   std::string SignPssSha256(const std::string &payload) const;
 
  private:
+  void PrepareTemplate();
+  EVP_MD_CTX *AcquireContext() const;
+  void ReleaseContext(EVP_MD_CTX *ctx) const;
+
   EVP_PKEY *pkey_ = nullptr;
+  EVP_MD_CTX *template_ = nullptr;
+  size_t max_signature_size_ = 0;
+
+  mutable std::mutex pool_mutex_;
+  mutable std::vector<EVP_MD_CTX *> pool_;
 };
 
 }  // namespace kalshi
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace kalshi {
+
+class KalshiClient;
+
+struct TickerUpdate {
+  std::string ticker;
+  double yes_bid = 0.0;
+  double yes_ask = 0.0;
+  double last_price = 0.0;
+  double volume = 0.0;
+  int64_t ts = 0;  // exchange time, unix seconds
+  std::string raw_json;
+  std::chrono::steady_clock::time_point received;
+};
+
+struct OrderbookLevel {
+  int price = 0;  // cents, 1..99
+  long quantity = 0;
+};
+
+struct OrderbookSnapshot {
+  std::string ticker;
+  std::vector<OrderbookLevel> yes;
+  std::vector<OrderbookLevel> no;
+};
+
+struct OrderbookDelta {
+  std::string ticker;
+  int price = 0;
+  long delta = 0;
+  bool yes_side = true;
+};
+
+struct MarketStreamConfig {
+  std::string url;
+  // Markets to subscribe. Empty subscribes the ticker channel for every market and
+  // skips orderbook deltas, which Kalshi only serves per ticker.
+  std::vector<std::string> tickers;
+  bool orderbook = true;
+  // Reconnect when nothing (not even a ping) arrives for this long.
+  int idle_timeout_seconds = 30;
+  int max_backoff_seconds = 30;
+};
+
+// WebSocket client for the Kalshi market data feed. Runs its own thread, reconnects
+// with exponential backoff and forces a resync (reconnect + fresh orderbook snapshots,
+// plus the on_resync hook) when an orderbook sequence gap is detected.
+class MarketStream {
+ public:
+  struct Handlers {
+    std::function<void(const TickerUpdate &)> on_ticker;
+    std::function<void(const OrderbookSnapshot &)> on_orderbook_snapshot;
+    std::function<void(const OrderbookDelta &)> on_orderbook_delta;
+    // Called after every (re)connect so the owner can backfill what it missed over REST.
+    std::function<void()> on_resync;
+  };
+
+  struct Stats {
+    uint64_t messages = 0;
+    uint64_t connects = 0;
+    uint64_t sequence_gaps = 0;
+    bool connected = false;
+  };
+
+  // client may be null; when set, it signs the upgrade request.
+  MarketStream(MarketStreamConfig config, std::shared_ptr<KalshiClient> client);
+  ~MarketStream();
+
+  MarketStream(const MarketStream &) = delete;
+  MarketStream &operator=(const MarketStream &) = delete;
+
+  void SetHandlers(Handlers handlers);
+  void Start();
+  void Stop();
+
+  Stats stats() const;
+  const MarketStreamConfig &config() const { return config_; }
+
+ private:
+  void Run();
+  bool Connect();
+  void Disconnect();
+  bool Subscribe();
+  bool SendText(const std::string &text);
+  // Returns false when the connection must be re-established.
+  bool ReadMessages();
+  bool Dispatch(const std::string &text);
+
+  MarketStreamConfig config_;
+  std::shared_ptr<KalshiClient> client_;
+  Handlers handlers_;
+
+  CURL *curl_ = nullptr;
+  struct curl_slist *header_list_ = nullptr;
+  std::string frame_buffer_;
+  int next_command_id_ = 1;
+  std::unordered_map<int64_t, int64_t> last_seq_;
+  std::chrono::steady_clock::time_point last_activity_;
+
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> messages_{0};
+  std::atomic<uint64_t> connects_{0};
+  std::atomic<uint64_t> sequence_gaps_{0};
+  std::atomic<bool> connected_{false};
+  std::thread worker_;
+};
+
+}  // namespace kalshi
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kalshi {
+
+struct MockFeedConfig {
+  int port = 9001;  // 0 picks a free port
+  int markets = 20;
+  int updates_per_second = 50;
+  // Drop one orderbook sequence number every N deltas to exercise resync (0 = never).
+  int gap_every = 0;
+};
+
+// Local stand-in for the Kalshi WebSocket feed so MarketStream can run offline. Speaks
+// just enough of RFC 6455 and the Kalshi subscribe protocol to emit random-walk ticker
+// updates and orderbook snapshots/deltas for MOCK-<n> markets. POSIX only.
+class MockFeedServer {
+ public:
+  explicit MockFeedServer(MockFeedConfig config);
+  ~MockFeedServer();
+
+  MockFeedServer(const MockFeedServer &) = delete;
+  MockFeedServer &operator=(const MockFeedServer &) = delete;
+
+  bool Start();
+  void Stop();
+  int port() const { return port_; }
+
+ private:
+  void AcceptLoop();
+  void Serve(int fd);
+
+  MockFeedConfig config_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::atomic<bool> stop_{false};
+  std::thread acceptor_;
+  std::mutex clients_mutex_;
+  std::vector<std::thread> clients_;
+};
+
+}  // namespace kalshi
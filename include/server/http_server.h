@@ -1,33 +1,235 @@
 #pragma once
 
 #include "analytics/alert_engine.h"
+#include "analytics/change_detector.h"
+#include "analytics/correlation_engine.h"
 #include "analytics/feature_engine.h"
 #include "kalshi/kalshi_client.h"
+#include "kalshi/market_stream.h"
+#include "server/market_table.h"
+#include "server/push_hub.h"
+#include "server/refresh_scheduler.h"
+#include "server/response_cache.h"
+#include "storage/async_writer.h"
+#include "storage/compactor.h"
 #include "storage/sqlite_store.h"
+#include "storage/time_series_store.h"
+#include "utils/latency_histogram.h"
 
 #include <httplib.h>
+#include <nlohmann/json.hpp>
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace server {
 
+struct WarmStartOptions {
+  // Reader threads rebuilding engine state from SQLite at startup; 0 skips it.
+  int threads = 4;
+  // Tickers not restored by then start cold, as if seen for the first time.
+  double max_seconds = 10.0;
+};
+
+struct WarmStartStats {
+  uint64_t features = 0;  // tickers whose last feature row was restored
+  uint64_t markets = 0;   // markets rows restored
+  double seconds = 0.0;
+  bool complete = true;  // false when max_seconds cut it short
+};
+
+struct HttpServerOptions {
+  // Drop markets whose tracked fields did not change since the last refresh before
+  // any SQLite or alert work.
+  bool skip_unchanged = true;
+  // Request used for periodic refreshes and for stream resyncs of the whole universe.
+  RefreshRequest refresh;
+  // Seconds between scheduled refreshes (0 = only on demand).
+  int refresh_interval_seconds = 0;
+  // gzip/deflate JSON responses of at least compress_min_bytes when the client accepts it.
+  bool compress = true;
+  size_t compress_min_bytes = 1024;
+  // Serialised (and compressed) bodies of read-only JSON routes kept per route, query
+  // and encoding until the data changes; 0 builds every response afresh.
+  size_t response_cache_entries = 1024;
+  // Hand rows to a background writer thread instead of committing on the ingest path.
+  bool async_persist = true;
+  storage::AsyncWriterOptions persist;
+  // Rollup and retention of feature history; also decides resolution=auto on /features.
+  storage::RetentionOptions retention;
+  WarmStartOptions warm_start;
+  // Server-sent events on /stream.
+  PushOptions push;
+  // Rolling correlations on /correlations; one step per refresh.
+  analytics::CorrelationOptions correlation;
+};
+
+// Per-stage latency of the ingest pipeline. parse is per page, store per batch
+// handed off (queued, or committed when persistence is synchronous) and publish per
+// batch applied to the in-memory market table; detect, features, alerts and ingest are
+// per market.
+struct PipelineMetrics {
+  utils::LatencyHistogram parse;
+  utils::LatencyHistogram detect;
+  utils::LatencyHistogram features;
+  utils::LatencyHistogram alerts;
+  utils::LatencyHistogram store;
+  utils::LatencyHistogram publish;
+  utils::LatencyHistogram ingest;
+};
+
 class HttpServer {
  public:
+  // series may be null; when set, every feature row is also appended to it and
+  // /features is served from it instead of SQLite.
   HttpServer(std::shared_ptr<kalshi::KalshiClient> client,
              std::shared_ptr<storage::SQLiteStore> store,
+             std::shared_ptr<storage::TimeSeriesStore> series,
              std::shared_ptr<analytics::FeatureEngine> features,
-             std::shared_ptr<analytics::AlertEngine> alerts);
+             std::shared_ptr<analytics::AlertEngine> alerts,
+             HttpServerOptions options = {});
+  ~HttpServer();
 
+  // Starts the refresh scheduler and blocks serving HTTP.
   void Run(int port);
-  void RefreshMarkets(int limit);
+  void Stop();
+
+  // Rebuilds per-ticker state (previous features for alerts, change fingerprints, the
+  // live snapshots streams merge into) from the latest stored rows, so the first
+  // refresh after a restart behaves like any other. Call before ingesting anything.
+  WarmStartStats WarmStart();
+
+  // Both refresh paths close a correlation step when they finish.
+  RefreshStats RefreshMarkets(int limit);
+
+  // Parses and ingests one /markets page that was fetched (or captured) elsewhere.
+  RefreshStats IngestPage(utils::HttpResponse response);
+  // Waits until everything ingested so far has reached SQLite.
+  void FlushWrites();
+
+  // Follows the cursor until the exchange is exhausted (or max_pages is hit).
+  // The next page is fetched while the current one is ingested.
+  RefreshStats RefreshAllMarkets(int page_size, int max_pages = 0);
+
+  // Feeds a push stream into the same ingest pipeline as REST refreshes. Call before
+  // stream->Start(); the server keeps the stream alive for metrics.
+  void AttachStream(std::shared_ptr<kalshi::MarketStream> stream);
+  void ApplyTickerUpdate(const kalshi::TickerUpdate &update);
+  void ApplyOrderbookSnapshot(const kalshi::OrderbookSnapshot &snapshot);
+  void ApplyOrderbookDelta(const kalshi::OrderbookDelta &delta);
+
+  const PipelineMetrics &pipeline() const { return pipeline_; }
+  storage::WriteStats store_totals() const { return store_->write_totals(); }
 
  private:
   void RegisterRoutes();
+  // Serialises compactly and compresses per options_ and the request's Accept-Encoding.
+  void SendJson(const httplib::Request &req, httplib::Response &res, const nlohmann::json &body);
+  // Same, for a body that is already JSON text.
+  void SendBody(const httplib::Request &req, httplib::Response &res, std::string json);
+  // What a cached route is built from; each has its own generation.
+  enum class DataDomain : uint32_t {
+    kMarkets,       // the market table (/markets, /events)
+    kAlerts,        // alert rows in SQLite
+    kFeatures,      // feature history, raw and rolled up
+    kCorrelations,  // the correlation engine
+  };
+  // Sends the body build() returns through response_cache_, with an ETag, answering a
+  // matching If-None-Match with 304. build() runs only on a miss; it must depend on
+  // nothing but the request, variant and the data DataGeneration(domain) covers.
+  void SendCached(const httplib::Request &req, httplib::Response &res, DataDomain domain,
+                  const std::function<nlohmann::json()> &build, std::string_view variant = {});
+  // Serialised body plus the Content-Encoding it needs.
+  CachedResponse Encode(const httplib::Request &req, std::string json) const;
+  void Send(httplib::Response &res, CachedResponse response);
+  // Moves whenever the domain's data may have changed, and only then, so a stream tick
+  // that adds a feature row leaves cached /markets and /alerts bodies valid.
+  uint64_t DataGeneration(DataDomain domain) const;
+  // Returns the page body (which batch->raw_json points into), or null on failure.
+  std::shared_ptr<const std::string> ParsePage(utils::HttpResponse response, analytics::MarketBatch *batch);
+  // Returns the number of markets ingested; unchanged markets are counted in *skipped.
+  int IngestBatch(const analytics::MarketBatch &batch,
+                  const std::shared_ptr<const std::string> &body,
+                  int *skipped);
+  // Requires ingest_mutex_. Returns false when the market was unchanged.
+  // Rows are queued in pending_; owner keeps raw_json alive until they are written.
+  // Without store_market only the feature row (and alerts) are kept, e.g. for a market
+  // whose event and category are not known yet.
+  bool IngestLocked(const analytics::MarketSnapshot &snapshot,
+                    const std::shared_ptr<const std::string> &owner,
+                    std::string_view raw_json,
+                    bool store_market = true);
+  // Requires ingest_mutex_. Hands everything queued by IngestLocked to the persist
+  // stage, or writes it in one transaction when persistence is synchronous.
+  void CommitLocked();
+  // Requires ingest_mutex_. Offers pending_'s feature rows and alerts to /stream clients.
+  void PushLocked();
+  // Requires ingest_mutex_. Recomputes book features for ticker after an L2 change and
+  // stores them (with any alerts); the markets row is left to REST and ticker updates.
+  void IngestBookLocked(analytics::TickerId ticker);
+  void ResyncFromRest(const std::vector<std::string> &tickers);
+  // Raw feature rows with from_nanos <= ts <= to_nanos, newest first (limit <= 0 for
+  // all). Served from series_ when it is on, topped up from SQLite for anything older
+  // than the series' first row, e.g. history written before the series store existed.
+  std::vector<analytics::FeatureRow> RawFeatures(analytics::TickerId ticker, int64_t from_nanos, int64_t to_nanos,
+                                                 int limit) const;
 
   std::shared_ptr<kalshi::KalshiClient> client_;
   std::shared_ptr<storage::SQLiteStore> store_;
+  std::shared_ptr<storage::TimeSeriesStore> series_;
   std::shared_ptr<analytics::FeatureEngine> features_;
   std::shared_ptr<analytics::AlertEngine> alerts_;
+  HttpServerOptions options_;
+  analytics::ChangeDetector changes_;
+  PipelineMetrics pipeline_;
+
+  // Serialises REST and stream ingestion; AlertEngine keeps per-ticker state.
+  std::mutex ingest_mutex_;
+  // Last full snapshot per ticker, so partial stream updates can be merged.
+  std::unordered_map<analytics::TickerId, analytics::MarketSnapshot> live_;
+  // L2 books from the orderbook channel, keyed by ticker.
+  std::unordered_map<analytics::TickerId, analytics::OrderBook> books_;
+  // Last book-backed feature row stored per ticker; book updates that leave top of
+  // book, depth and imbalance where they were are not stored again.
+  std::unordered_map<analytics::TickerId, analytics::FeatureRow> book_features_;
+  // Tickers whose wide_spread the book path has raised since IngestLocked last saw them;
+  // book updates for them leave it out until the next REST or ticker update.
+  std::unordered_set<analytics::TickerId> book_spread_alerted_;
+  // Records for the batch being ingested; reused so its buffer stays allocated.
+  std::vector<storage::WriteRecord> pending_;
+  // Serves /markets and /events; loaded from SQLite at construction and patched by
+  // CommitLocked with every markets row it hands on.
+  MarketTable market_table_;
+  std::vector<const analytics::MarketSnapshot *> published_;
+  // Batches CommitLocked has appended to series_, for DataGeneration().
+  std::atomic<uint64_t> series_batches_{0};
+  ResponseCache response_cache_;
+  PushHub push_;
+  // Events for the batch being pushed; reused like pending_.
+  std::vector<PushEvent> push_events_;
+  // Fed every mid IngestLocked and IngestBookLocked see, changed or not.
+  analytics::CorrelationEngine correlations_;
+  // Null when options_.async_persist is off.
+  std::unique_ptr<storage::AsyncWriter> persist_;
+  // Null when options_.retention.interval_seconds is 0.
+  std::unique_ptr<storage::Compactor> compactor_;
+
+  std::unique_ptr<RefreshScheduler> scheduler_;
+  std::shared_ptr<kalshi::MarketStream> stream_;
+  std::atomic<uint64_t> json_bytes_{0};
+  std::atomic<uint64_t> sent_bytes_{0};
+  std::atomic<uint64_t> compressed_responses_{0};
+  std::atomic<uint64_t> stream_updates_{0};
+  std::atomic<uint64_t> stream_latency_total_us_{0};
+  std::atomic<uint64_t> stream_latency_max_us_{0};
+  // Written by WarmStart() before the server starts.
+  WarmStartStats warm_start_;
   httplib::Server server_;
 };
 
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "analytics/models.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace server {
+
+// A market as served by /markets: the snapshot plus its ticker text, so readers never
+// go back to the ticker registry.
+struct MarketRow {
+  analytics::MarketSnapshot snapshot;
+  std::string ticker;
+};
+
+// One sort order of a published version, split into immutable chunks that versions
+// share; a publish rebuilds only the chunks holding rows that changed.
+template <typename T>
+struct ChunkedOrder {
+  using Chunk = std::vector<std::shared_ptr<const T>>;
+  std::vector<std::shared_ptr<const Chunk>> chunks;
+  size_t size = 0;
+};
+
+// One published version of the market read model. Never modified once published, so
+// readers use it without locks for as long as they hold it. Rows are shared between
+// versions; only the ones that changed are new.
+class MarketView {
+ public:
+  // Newest updated_at first (ties by ticker id). search is a case-insensitive substring
+  // of ticker, event ticker or category; limit < 0 returns every match, like LIMIT in
+  // SQLite. Pointers stay valid while the view is held.
+  std::vector<const MarketRow *> Markets(int limit, const std::string &search) const;
+  // Same order and limit; search matches event ticker or category. Markets without an
+  // event are not summarised, and categories group as stored.
+  std::vector<const analytics::EventSummary *> Events(int limit, const std::string &search) const;
+
+  uint64_t generation() const { return generation_; }
+  size_t market_count() const { return markets_.size; }
+  size_t event_count() const { return events_.size; }
+
+ private:
+  friend class MarketTable;
+
+  uint64_t generation_ = 0;
+  ChunkedOrder<MarketRow> markets_;
+  ChunkedOrder<analytics::EventSummary> events_;
+};
+
+// The in-memory copy of the markets table that /markets and /events are served from;
+// SQLite stays the durable copy. Writers patch it and publish a new MarketView with an
+// atomic pointer swap (read-copy-update). A publish costs sorting the changed rows and
+// copying the chunks they fall in, plus one pointer per chunk, independent of how many
+// readers are active.
+class MarketTable {
+ public:
+  MarketTable();
+
+  // The latest published version; safe from any thread.
+  std::shared_ptr<const MarketView> Current() const;
+
+  // Writer side; callers serialise them (HttpServer holds its ingest mutex).
+  // Replaces the contents, e.g. with every markets row at startup.
+  void Load(const std::vector<analytics::MarketSnapshot> &markets);
+  // Upserts the given markets (the last one wins for a repeated ticker) and publishes.
+  void Apply(const std::vector<const analytics::MarketSnapshot *> &updates);
+  // The latest row applied for ticker, or null; writer side, like Apply.
+  const analytics::MarketSnapshot *Find(analytics::TickerId ticker) const;
+
+ private:
+  // Ticker ids of one (event_ticker, category) group.
+  struct EventMembers {
+    std::string event_ticker;
+    std::string category;
+    std::unordered_set<analytics::TickerId> tickers;
+    // As last published; null until the group first is.
+    std::shared_ptr<const analytics::EventSummary> summary;
+  };
+
+  void Publish(std::shared_ptr<MarketView> next);
+
+  // Accessed only through std::atomic_load/std::atomic_store.
+  std::shared_ptr<const MarketView> current_;
+
+  // Writer state. Rows by ticker id, and event groups keyed by event + '\x1f' + category.
+  std::vector<std::shared_ptr<const MarketRow>> rows_;
+  std::unordered_map<std::string, EventMembers> events_;
+  // rows_ index -> generation that last changed it, to take each ticker once per publish.
+  std::vector<uint64_t> changed_in_;
+};
+
+}  // namespace server
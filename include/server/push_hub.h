@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace server {
+
+struct PushOptions {
+  // Concurrent /stream clients; each holds an HTTP worker thread while connected.
+  size_t max_subscribers = 32;
+  // Events queued per client; a client that falls further behind loses the oldest.
+  size_t buffer_events = 1024;
+  // An idle stream gets a comment this often, so proxies keep it open and a client
+  // that went away is noticed.
+  int heartbeat_seconds = 15;
+};
+
+// What one /stream client asked for.
+struct PushFilter {
+  // Feature rows of these tickers, or of every ticker; none by default.
+  std::unordered_set<std::string> tickers;
+  bool every_ticker = false;
+  // Alerts of these types, or of every type (the default).
+  std::unordered_set<std::string> alert_types;
+  bool every_alert_type = true;
+
+  bool WantsFeature(const std::string &ticker) const;
+  bool WantsAlert(const std::string &type) const;
+};
+
+// What a subscriber filters on; the event itself is formatted only once some
+// subscriber wants it.
+struct PushEvent {
+  enum class Kind { kFeature, kAlert };
+  Kind kind = Kind::kFeature;
+  std::string ticker;
+  std::string alert_type;  // kAlert only
+};
+
+// Returns the complete SSE frame of events[index].
+using PushFormatter = std::function<std::string(size_t index)>;
+
+struct PushStats {
+  size_t subscribers = 0;
+  uint64_t published = 0;  // events offered to at least one subscriber
+  uint64_t delivered = 0;  // queued for a subscriber (an event to two counts twice)
+  uint64_t dropped = 0;    // lost from a full subscriber buffer
+  uint64_t rejected = 0;   // subscriptions refused at max_subscribers
+};
+
+class PushSubscriber {
+ public:
+  PushSubscriber(PushFilter filter, size_t capacity);
+
+  // Waits up to timeout for events and moves them into *frames, with the number lost
+  // to a full buffer since the last call in *dropped. Returns false once the hub closed.
+  bool Next(std::chrono::milliseconds timeout, std::vector<std::shared_ptr<const std::string>> *frames,
+            uint64_t *dropped);
+
+ private:
+  friend class PushHub;
+
+  // Never blocks the publisher: a full buffer gives up its oldest event. Returns false
+  // when one was dropped.
+  bool Offer(const std::shared_ptr<const std::string> &frame);
+  void Close();
+
+  const PushFilter filter_;
+  const size_t capacity_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<std::shared_ptr<const std::string>> frames_;
+  uint64_t dropped_ = 0;
+  bool closed_ = false;
+};
+
+// Fans events out from the ingest path to /stream clients. Publish only copies frame
+// pointers into bounded per-subscriber buffers, so a slow client costs itself events,
+// never the publisher time.
+class PushHub {
+ public:
+  explicit PushHub(PushOptions options = {});
+
+  // Null when max_subscribers are already connected or the hub is closed.
+  std::shared_ptr<PushSubscriber> Subscribe(PushFilter filter);
+  void Unsubscribe(const std::shared_ptr<PushSubscriber> &subscriber);
+
+  // Lets publishers skip formatting events nobody would receive.
+  bool has_subscribers() const { return subscriber_count_.load(std::memory_order_relaxed) > 0; }
+  // Calls format at most once per event, and not at all for events nobody wants; the
+  // frame is then shared by every subscriber it goes to.
+  void Publish(const std::vector<PushEvent> &events, const PushFormatter &format);
+
+  // Ends every subscription and refuses new ones.
+  void Close();
+
+  PushStats stats() const;
+  const PushOptions &options() const { return options_; }
+
+ private:
+  PushOptions options_;
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<PushSubscriber>> subscribers_;
+  bool closed_ = false;
+
+  std::atomic<size_t> subscriber_count_{0};
+  std::atomic<uint64_t> published_{0};
+  std::atomic<uint64_t> delivered_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> rejected_{0};
+};
+
+}  // namespace server
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace server {
+
+struct RefreshStats {
+  int pages = 0;
+  int markets = 0;   // ingested (changed or new)
+  int skipped = 0;   // seen but unchanged
+  double seconds = 0.0;
+
+  double PagesPerSecond() const { return seconds > 0.0 ? pages / seconds : 0.0; }
+  double MarketsPerSecond() const { return seconds > 0.0 ? (markets + skipped) / seconds : 0.0; }
+};
+
+struct RefreshRequest {
+  int limit = 100;
+  bool all = false;
+  int max_pages = 0;
+
+  bool operator==(const RefreshRequest &other) const {
+    return limit == other.limit && all == other.all && max_pages == other.max_pages;
+  }
+};
+
+struct RefreshJob {
+  enum class State { kQueued, kRunning, kDone, kFailed };
+
+  uint64_t id = 0;
+  RefreshRequest request;
+  State state = State::kQueued;
+  RefreshStats stats;
+  std::string error;
+  int coalesced = 0;  // duplicate submissions folded into this job
+  std::chrono::system_clock::time_point submitted_at;
+  std::chrono::system_clock::time_point finished_at;
+
+  static const char *StateName(State state);
+};
+
+// Owns refresh work on one dedicated thread. Submitting a request identical to one that
+// is already queued or running returns that job's id instead of queueing another.
+// With interval_seconds > 0 the periodic request is submitted on a timer as well.
+class RefreshScheduler {
+ public:
+  using Runner = std::function<RefreshStats(const RefreshRequest &)>;
+
+  RefreshScheduler(Runner runner, int interval_seconds = 0, RefreshRequest periodic = {});
+  ~RefreshScheduler();
+
+  RefreshScheduler(const RefreshScheduler &) = delete;
+  RefreshScheduler &operator=(const RefreshScheduler &) = delete;
+
+  void Start();
+  void Stop();
+
+  // Returns the job id; *coalesced is set when an existing job absorbed the request.
+  uint64_t Submit(const RefreshRequest &request, bool *coalesced = nullptr);
+  std::optional<RefreshJob> Job(uint64_t id) const;
+  // Blocks until the job finishes or the timeout passes.
+  std::optional<RefreshJob> Wait(uint64_t id, std::chrono::milliseconds timeout) const;
+
+ private:
+  void Run();
+  void Trim();
+
+  Runner runner_;
+  int interval_seconds_;
+  RefreshRequest periodic_;
+
+  mutable std::mutex mutex_;
+  mutable std::condition_variable cv_;
+  std::deque<uint64_t> queue_;
+  std::map<uint64_t, RefreshJob> jobs_;
+  uint64_t next_id_ = 1;
+  uint64_t running_id_ = 0;
+  bool stop_ = false;
+  std::thread worker_;
+};
+
+}  // namespace server
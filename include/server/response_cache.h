@@ -0,0 +1,72 @@
+#pragma once
+
+#include "utils/compression.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace server {
+
+// A serialised API response, ready to send as is.
+struct CachedResponse {
+  std::string body;  // compact JSON, already compressed unless encoding is kIdentity
+  utils::ContentEncoding encoding = utils::ContentEncoding::kIdentity;
+  std::string etag;  // strong, quoted; changes whenever body does
+  size_t json_bytes = 0;
+};
+
+struct ResponseCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t not_modified = 0;  // 304s sent instead of a body
+  uint64_t bytes_saved = 0;   // body bytes those 304s did not send
+  size_t entries = 0;
+  double HitRatio() const { return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+};
+
+// Response bodies keyed by route, query and encoding, each valid for the data
+// generation it was built at. Generations are counted per domain (the data a route is
+// built from), so a newer one makes every entry of its domain stale at once and leaves
+// the others alone; stale entries are replaced on their next request or evicted first
+// when the cache is full.
+class ResponseCache {
+ public:
+  explicit ResponseCache(size_t max_entries);
+
+  // Null on a miss, including when the entry was built at another generation.
+  std::shared_ptr<const CachedResponse> Find(const std::string &key, uint64_t generation);
+  void Put(const std::string &key, uint32_t domain, uint64_t generation,
+           std::shared_ptr<const CachedResponse> response);
+  void RecordNotModified(size_t body_bytes);
+
+  ResponseCacheStats stats() const;
+
+  // FNV-1a over the body, as a quoted strong validator.
+  static std::string ETag(std::string_view body);
+  // True when an If-None-Match header value lists etag (or is "*"). Weak validators
+  // match too, as RFC 9110 asks for GET.
+  static bool Matches(std::string_view if_none_match, std::string_view etag);
+
+ private:
+  struct Entry {
+    uint32_t domain = 0;
+    uint64_t generation = 0;
+    std::shared_ptr<const CachedResponse> response;
+  };
+
+  size_t max_entries_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> not_modified_{0};
+  std::atomic<uint64_t> bytes_saved_{0};
+};
+
+}  // namespace server
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "analytics/models.h"
+#include "storage/sqlite_store.h"
+#include "utils/latency_histogram.h"
+#include "utils/mpsc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace storage {
+
+// Everything one ingested market (or book update) wants persisted.
+struct WriteRecord {
+  bool has_market = false;  // book-only updates carry just a feature row
+  analytics::MarketSnapshot market;
+  analytics::FeatureRow feature;
+  std::vector<analytics::Alert> alerts;
+  // raw_json points into owner (usually the whole page body shared by its markets).
+  std::shared_ptr<const std::string> owner;
+  std::string_view raw_json;
+  std::chrono::steady_clock::time_point enqueued;
+};
+
+enum class BackpressurePolicy {
+  kBlock,       // producer waits for space
+  kDropOldest,  // evict the oldest queued record
+  kSpill,       // append to a file the writer replays once it catches up
+};
+
+BackpressurePolicy ParseBackpressurePolicy(const std::string &name);
+const char *BackpressurePolicyName(BackpressurePolicy policy);
+
+struct AsyncWriterOptions {
+  size_t capacity = 65536;
+  // Records per transaction, at most.
+  size_t max_batch = 4096;
+  BackpressurePolicy policy = BackpressurePolicy::kBlock;
+  std::string spill_path = "data/persist.spill";
+};
+
+// Persistence stage between ingest and SQLite: producers push records into a bounded
+// lock-free queue and one writer thread drains it in batched transactions.
+class AsyncWriter {
+ public:
+  struct Stats {
+    size_t depth = 0;
+    size_t capacity = 0;
+    uint64_t pushed = 0;
+    uint64_t written = 0;
+    uint64_t dropped = 0;
+    uint64_t spilled = 0;
+    uint64_t blocked = 0;  // pushes that had to wait for space
+  };
+
+  AsyncWriter(std::shared_ptr<SQLiteStore> store, AsyncWriterOptions options = {});
+  ~AsyncWriter();
+
+  AsyncWriter(const AsyncWriter &) = delete;
+  AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+  void Start();
+  // Drains everything queued or spilled, then joins the writer.
+  void Stop();
+
+  void Push(WriteRecord record);
+  // Blocks until everything pushed so far has been committed.
+  void Flush();
+
+  Stats stats() const;
+  // Enqueue-to-commit latency per record, and commit time per batch.
+  const utils::LatencyHistogram &drain_latency() const { return drain_latency_; }
+  const utils::LatencyHistogram &commit_latency() const { return commit_latency_; }
+  const AsyncWriterOptions &options() const { return options_; }
+
+ private:
+  void Run();
+  void Spill(const WriteRecord &record);
+  // Requires the spill to be active. Reads the next max_batch records into *records;
+  // once nothing is left, removes the file, ends the spill and returns false.
+  bool TakeSpilled(std::vector<WriteRecord> *records);
+  // After committing what TakeSpilled returned: advances the committed position, or
+  // rewinds so the same records are read again.
+  void SpillDone(bool committed);
+  // Puts a batch that failed to commit back at the head of the spill file.
+  void Respill(const std::vector<WriteRecord> &records);
+  std::string SpillPositionPath() const;
+  // False when the batch failed and should be kept (spill policy only); other
+  // policies drop a failed batch.
+  bool Commit(std::vector<WriteRecord> &records);
+
+  std::shared_ptr<SQLiteStore> store_;
+  AsyncWriterOptions options_;
+  utils::MpscQueue<WriteRecord> queue_;
+  std::chrono::steady_clock::time_point started_;
+
+  // While spilling_ is set every push goes to the file, so records stay in order.
+  std::mutex spill_mutex_;
+  std::atomic<bool> spilling_{false};
+  std::ofstream spill_out_;
+  // Byte offsets into the spill file: read so far, and committed to SQLite. The file
+  // is replayed in max_batch chunks and removed only once all of it is committed; the
+  // committed offset is also saved next to it (<spill_path>.pos) for restarts.
+  uint64_t spill_read_ = 0;
+  uint64_t spill_committed_ = 0;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  std::condition_variable flushed_cv_;
+
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> pushed_{0};
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> spilled_{0};
+  std::atomic<uint64_t> blocked_{0};
+  utils::LatencyHistogram drain_latency_;
+  utils::LatencyHistogram commit_latency_;
+  std::thread worker_;
+};
+
+}  // namespace storage
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "storage/sqlite_store.h"
+#include "storage/time_series_store.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace storage {
+
+// How long each tier of feature history is kept; 0 keeps it forever.
+struct RetentionOptions {
+  int raw_hours = 24;
+  int minute_days = 7;
+  int five_minute_days = 90;
+  int hour_days = 0;
+  // Seconds between compaction passes (0 = never run in the background).
+  int interval_seconds = 300;
+  // Raw rows folded into the rollups per transaction.
+  size_t batch_rows = 20000;
+};
+
+// The finest tier that answers span_seconds of history in at most limit points and
+// whose retention still covers the span. Raw rows are assumed to arrive at most once a
+// second; falls back to hourly bars.
+Resolution ChooseResolution(const RetentionOptions &options, int64_t span_seconds, int limit);
+
+struct CompactionStats {
+  uint64_t runs = 0;
+  uint64_t rolled_up = 0;  // raw rows folded into bars
+  uint64_t raw_deleted = 0;
+  uint64_t series_rows_deleted = 0;  // from the time-series store, by whole segments
+  uint64_t bars_deleted = 0;
+  uint64_t payloads_deleted = 0;  // no longer referenced after raw rows were deleted
+  double last_run_seconds = 0.0;
+};
+
+// Background job that keeps feature history bounded: folds new raw rows into the
+// 1m/5m/1h rollup tables, then applies each tier's retention. The raw retention also
+// expires the time-series store's segments when one is given.
+class Compactor {
+ public:
+  Compactor(std::shared_ptr<SQLiteStore> store, std::shared_ptr<TimeSeriesStore> series,
+            RetentionOptions options = {});
+  ~Compactor();
+
+  Compactor(const Compactor &) = delete;
+  Compactor &operator=(const Compactor &) = delete;
+
+  void Start();
+  void Stop();
+
+  // One full pass on the calling thread.
+  void RunOnce();
+
+  CompactionStats stats() const;
+  const RetentionOptions &options() const { return options_; }
+
+ private:
+  void Run();
+
+  std::shared_ptr<SQLiteStore> store_;
+  std::shared_ptr<TimeSeriesStore> series_;  // may be null
+  RetentionOptions options_;
+
+  std::atomic<uint64_t> runs_{0};
+  std::atomic<uint64_t> rolled_up_{0};
+  std::atomic<uint64_t> raw_deleted_{0};
+  std::atomic<uint64_t> series_rows_deleted_{0};
+  std::atomic<uint64_t> bars_deleted_{0};
+  std::atomic<uint64_t> payloads_deleted_{0};
+  std::atomic<uint64_t> last_run_nanos_{0};
+
+  std::mutex run_mutex_;  // one pass at a time
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread worker_;
+};
+
+}  // namespace storage
@@ -4,34 +4,231 @@
 
 #include <sqlite3.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+namespace utils {
+class DictionaryCompressor;
+}
+
 namespace storage {
 
+// Rows to commit together. raw_json views are not copied: whatever they point into
+// (usually the page body) must outlive the Write() call.
+struct WriteBatch {
+  struct Market {
+    analytics::MarketSnapshot snapshot;
+    std::string_view raw_json;
+  };
+  struct Feature {
+    analytics::FeatureRow row;
+    std::string_view raw_json;
+  };
+
+  std::vector<Market> markets;
+  std::vector<Feature> features;
+  std::vector<analytics::Alert> alerts;
+
+  size_t rows() const { return markets.size() + features.size() + alerts.size(); }
+  bool empty() const { return rows() == 0; }
+  void Clear() {
+    markets.clear();
+    features.clear();
+    alerts.clear();
+  }
+};
+
+struct WriteStats {
+  uint64_t rows = 0;
+  uint64_t features = 0;  // of rows
+  uint64_t alerts = 0;    // of rows
+  double seconds = 0.0;
+  double RowsPerSecond() const { return seconds > 0.0 ? rows / seconds : 0.0; }
+};
+
+// Tiers of feature history: raw rows and the rollup tables built by the compactor.
+enum class Resolution {
+  kAuto,  // let the caller pick a tier for the span (see ChooseResolution)
+  kRaw,
+  kMinute,
+  kFiveMinutes,
+  kHour,
+};
+
+bool ParseResolution(const std::string &name, Resolution *resolution);
+const char *ResolutionName(Resolution resolution);
+// Bucket width of a rollup tier; 0 for kRaw and kAuto.
+int ResolutionSeconds(Resolution resolution);
+
+// Raw market JSON is stored once per distinct payload, compressed, in `payloads`;
+// market and feature rows reference it by content hash.
+struct PayloadStats {
+  uint64_t stored = 0;        // payloads compressed and inserted
+  uint64_t deduplicated = 0;  // references to a payload that was already stored
+  uint64_t raw_bytes = 0;     // JSON bytes of the stored payloads
+  uint64_t stored_bytes = 0;  // after compression
+};
+
+struct SQLiteStoreOptions {
+  // Write-ahead logging lets readers run alongside the writer without blocking it.
+  bool wal = true;
+  // Read-only connections for the query methods. 0 sends reads through the writer
+  // connection (serialised with writes); ":memory:" databases always do.
+  int read_connections = 4;
+};
+
 class SQLiteStore {
  public:
-  explicit SQLiteStore(const std::string &path);
+  explicit SQLiteStore(const std::string &path, SQLiteStoreOptions options = {});
   ~SQLiteStore();
 
+  // Creates the tables, applies any schema migrations the file has not seen yet
+  // (tracked in PRAGMA user_version), then loads the persisted ticker ids into
+  // analytics::TickerRegistry. Call it before anything else interns tickers; throws
+  // when the file's ids conflict with ones already interned.
   void Init();
 
-  void UpsertMarket(const analytics::MarketSnapshot &snapshot, const std::string &raw_json);
-  void InsertFeature(const analytics::FeatureRow &feature, const std::string &raw_json);
+  void UpsertMarket(const analytics::MarketSnapshot &snapshot, std::string_view raw_json);
+  void InsertFeature(const analytics::FeatureRow &feature, std::string_view raw_json);
   void InsertAlert(const analytics::Alert &alert);
 
+  // Writes the whole batch in one transaction; on any failure it is rolled back and
+  // the returned stats have rows == 0.
+  WriteStats Write(const WriteBatch &batch);
+  // Totals across every Write() since the store was opened.
+  WriteStats write_totals() const;
+
   std::vector<analytics::Alert> RecentAlerts(int limit = 50) const;
-  std::vector<analytics::FeatureRow> LatestFeatures(const std::string &ticker, int limit = 50) const;
+  std::vector<analytics::FeatureRow> LatestFeatures(analytics::TickerId ticker, int limit = 50) const;
+  // The same for several tickers in one query: grouped by ticker in the order given,
+  // newest first within each.
+  std::vector<analytics::FeatureRow> LatestFeatures(const std::vector<analytics::TickerId> &tickers,
+                                                    int limit = 50) const;
+  // Rows with from_nanos <= ts <= to_nanos, newest first; limit <= 0 returns them all.
+  std::vector<analytics::FeatureRow> FeatureRange(analytics::TickerId ticker, int64_t from_nanos, int64_t to_nanos,
+                                                  int limit = 0) const;
   std::vector<analytics::MarketSnapshot> ListMarkets(int limit = 200, const std::string &search = "") const;
+
+  // For rebuilding engine state at startup, over ticker ids first..last inclusive and
+  // in id order: the newest feature row of each ticker, and the markets rows.
+  std::vector<analytics::FeatureRow> LatestFeaturePerTicker(analytics::TickerId first,
+                                                            analytics::TickerId last) const;
+  std::vector<analytics::MarketSnapshot> MarketsByTicker(analytics::TickerId first, analytics::TickerId last) const;
   std::vector<analytics::EventSummary> ListEvents(int limit = 200, const std::string &search = "") const;
 
+  // Decompresses the raw JSON last stored for ticker; false when there is none.
+  bool MarketPayload(analytics::TickerId ticker, std::string *json) const;
+  // Deletes those of candidates (payload hashes) no market or feature row references
+  // any more.
+  uint64_t PrunePayloads(const std::vector<int64_t> &candidates);
+  PayloadStats payload_stats() const;
+
+  // Rollup bars for one tier with from_nanos <= bucket start <= to_nanos, newest first.
+  // resolution must be a rollup tier.
+  std::vector<analytics::FeatureBar> FeatureHistory(analytics::TickerId ticker, Resolution resolution,
+                                                    int64_t from_nanos, int64_t to_nanos, int limit) const;
+
+  // Folds up to max_rows raw feature rows not yet rolled up (in id order) into every
+  // rollup tier, in one transaction. Returns the number of raw rows consumed.
+  uint64_t RollupFeatures(size_t max_rows);
+  // Deletes raw feature rows older than before_nanos that have already been rolled up,
+  // adding the payload hashes they referenced to *payloads when it is given.
+  uint64_t PruneFeatures(int64_t before_nanos, std::vector<int64_t> *payloads = nullptr);
+  // Deletes bars of a rollup tier whose bucket starts before before_nanos.
+  uint64_t PruneBars(Resolution resolution, int64_t before_nanos);
+
+  // True when ticker/event/category search goes through the FTS5 trigram index rather
+  // than a LIKE scan (it needs SQLite built with FTS5, 3.34 or newer).
+  bool has_search_index() const { return search_index_; }
+
  private:
- sqlite3 *db_ = nullptr;
+  // A connection plus its prepared statements, which live as long as it does.
+  struct Connection {
+    sqlite3 *db = nullptr;
+    std::unordered_map<std::string, sqlite3_stmt *> statements;
+
+    sqlite3_stmt *Statement(const std::string &sql);
+    void Close();
+  };
+
+  // Exclusive use of a pooled reader (or of the writer, under mutex_, without a pool)
+  // for the lifetime of the lease.
+  class ReadLease {
+   public:
+    explicit ReadLease(const SQLiteStore &store);
+    ~ReadLease();
+    Connection *operator->() const { return connection_; }
+
+   private:
+    const SQLiteStore &store_;
+    Connection *connection_ = nullptr;
+    std::unique_lock<std::mutex> writer_lock_;
+  };
+
   std::string path_;
+  SQLiteStoreOptions options_;
+  // Writer connection; mutex_ serialises its use.
+  mutable Connection writer_;
   mutable std::mutex mutex_;
 
-  void Exec(const std::string &sql) const;
+  std::vector<std::unique_ptr<Connection>> readers_;
+  mutable std::vector<Connection *> idle_readers_;
+  mutable std::mutex readers_mutex_;
+  mutable std::condition_variable readers_cv_;
+
+  // Requires mutex_.
+  bool UpsertMarketLocked(const analytics::MarketSnapshot &snapshot, std::string_view raw_json);
+  bool InsertFeatureLocked(const analytics::FeatureRow &feature, std::string_view raw_json);
+  bool InsertAlertLocked(const analytics::Alert &alert);
+  // Requires mutex_. Stores raw_json unless it is already present and returns its hash
+  // (0 for an empty payload, which is stored as NULL).
+  int64_t PutPayloadLocked(std::string_view raw_json, bool *ok);
+  // Migration step, inside its transaction: moves inline raw_json into payloads and
+  // counts the rows moved.
+  bool MigratePayloads(uint64_t *moved);
+  uint64_t DatabaseBytes() const;
+
+  // Requires mutex_. Records tickers interned since the last call in the tickers table
+  // and returns the highest id written; the caller commits it to persisted_tickers_.
+  bool PersistTickersLocked(analytics::TickerId *through);
+  void LoadTickers();
+
+  // Runs a bounded DELETE (?1, ?2 bound to first and second) until it removes nothing,
+  // one implicit transaction per pass so writers are not held off for long.
+  uint64_t DeleteInBatches(const std::string &sql, int64_t first, int64_t second);
+
+  // Used under mutex_. known_payloads_ caches hashes already in the table.
+  std::unique_ptr<utils::DictionaryCompressor> payload_codec_;
+  std::unordered_set<int64_t> known_payloads_;
+  std::atomic<uint64_t> payloads_stored_{0};
+  std::atomic<uint64_t> payloads_deduplicated_{0};
+  std::atomic<uint64_t> payload_raw_bytes_{0};
+  std::atomic<uint64_t> payload_stored_bytes_{0};
+
+  // Used under mutex_. Every id up to this one is in the tickers table.
+  analytics::TickerId persisted_tickers_ = analytics::kNoTicker;
+
+  std::atomic<uint64_t> rows_written_{0};
+  std::atomic<uint64_t> features_written_{0};
+  std::atomic<uint64_t> alerts_written_{0};
+  std::atomic<uint64_t> write_nanos_{0};
+  // Set by Init() before any reads.
+  bool search_index_ = false;
+  bool event_summaries_ = false;
+
+  bool Exec(const std::string &sql) const;
+  void AddColumnIfMissing(const std::string &table, const std::string &column, const std::string &type);
+  // First column of the first row of sql (e.g. a PRAGMA), or 0.
+  int64_t QueryInt(const std::string &sql) const;
+  void Migrate();
 };
 
 }  // namespace storage
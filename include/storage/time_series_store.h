@@ -0,0 +1,104 @@
+#pragma once
+
+#include "analytics/models.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace storage {
+
+struct TimeSeriesOptions {
+  // Largest segment file, in rows. A ticker's segments start small and double up to
+  // this; each is created at full size (sparse) and memory-mapped.
+  uint32_t segment_rows = 4096;
+};
+
+// Consecutive rows of one segment, oldest first. The pointers are into the mapping and
+// are only valid inside the Scan() callback. Book columns are NaN for rows without a book.
+struct SeriesChunk {
+  size_t size = 0;
+  const int64_t *time = nullptr;  // unix nanoseconds, non-decreasing
+  const double *mid = nullptr;
+  const double *spread = nullptr;
+  const double *prob = nullptr;
+  const double *volume = nullptr;
+  const double *bid_depth = nullptr;
+  const double *ask_depth = nullptr;
+  const double *imbalance = nullptr;
+  const double *microprice = nullptr;
+};
+
+struct TimeSeriesStats {
+  uint64_t series = 0;
+  uint64_t segments = 0;
+  uint64_t rows = 0;
+  // Allocated on disk; segments are sparse until filled.
+  uint64_t disk_bytes = 0;
+  uint64_t failed_appends = 0;   // rows Append could not store
+  uint64_t invalid_segments = 0;  // files set aside as *.invalid at load
+  uint64_t expired_segments = 0;  // deleted by DropBefore
+};
+
+// Append-only per-ticker feature history in fixed-width, memory-mapped column files:
+// <directory>/<ticker>/<n>.seg, each a header followed by one contiguous array per
+// column. One writer at a time per ticker; readers scan the mapping directly.
+class TimeSeriesStore {
+ public:
+  // Maps the segments already under directory (creating it if needed); throws when the
+  // directory cannot be used.
+  explicit TimeSeriesStore(std::string directory, TimeSeriesOptions options = {});
+  ~TimeSeriesStore();
+
+  TimeSeriesStore(const TimeSeriesStore &) = delete;
+  TimeSeriesStore &operator=(const TimeSeriesStore &) = delete;
+
+  // Rows older than the ticker's last one are stamped with the last time so every
+  // series stays sorted. Returns false when the row could not be stored.
+  bool Append(const analytics::FeatureRow &row);
+
+  // Calls visit for each run of rows with from_nanos <= time <= to_nanos, oldest first.
+  void Scan(analytics::TickerId ticker, int64_t from_nanos, int64_t to_nanos,
+            const std::function<void(const SeriesChunk &)> &visit) const;
+
+  // Newest first, matching SQLiteStore::LatestFeatures.
+  std::vector<analytics::FeatureRow> Latest(analytics::TickerId ticker, int limit) const;
+  // Newest first; limit <= 0 returns the whole range.
+  std::vector<analytics::FeatureRow> Range(analytics::TickerId ticker, int64_t from_nanos, int64_t to_nanos,
+                                           int limit) const;
+  // Time of the ticker's oldest stored row; false when it has none.
+  bool FirstTime(analytics::TickerId ticker, int64_t *first_nanos) const;
+
+  // Deletes every segment whose rows are all older than before_nanos and returns the
+  // number of rows they held. A ticker's next append still sorts after its old rows.
+  uint64_t DropBefore(int64_t before_nanos);
+
+  // Flushes dirty pages to disk (the page cache already survives a process crash).
+  void Sync();
+
+  TimeSeriesStats stats() const;
+  const std::string &directory() const { return directory_; }
+
+ private:
+  class Segment;
+  struct Series;
+
+  Series *FindSeries(analytics::TickerId ticker) const;
+  Series &GetOrCreateSeries(analytics::TickerId ticker);
+  void LoadSeries(const std::string &name);
+
+  std::string directory_;
+  TimeSeriesOptions options_;
+  mutable std::shared_mutex mutex_;  // guards series_ (not the series themselves)
+  std::unordered_map<analytics::TickerId, std::unique_ptr<Series>> series_;
+  std::atomic<uint64_t> failed_appends_{0};
+  std::atomic<uint64_t> expired_segments_{0};
+  uint64_t invalid_segments_ = 0;  // written only while loading
+};
+
+}  // namespace storage
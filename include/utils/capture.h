@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace utils {
+
+// One captured HTTP response. The on-disk format is append-only and binary-safe:
+//   KRC1 <captured_ns> <status> <url_bytes> <body_bytes>\n<url><body>\n
+struct CaptureRecord {
+  int64_t captured_ns = 0;  // unix epoch nanoseconds when the response completed
+  long status = 0;
+  std::string url;
+  std::string body;
+};
+
+class CaptureWriter {
+ public:
+  // Throws std::runtime_error when the file cannot be opened for appending.
+  explicit CaptureWriter(const std::string &path);
+
+  void Write(long status, const std::string &url, const std::string &body);
+  uint64_t records() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::ofstream out_;
+  uint64_t records_ = 0;
+};
+
+class CaptureReader {
+ public:
+  // Throws std::runtime_error when the file cannot be opened.
+  explicit CaptureReader(const std::string &path);
+
+  // False at end of file or on a truncated/corrupt record (logged).
+  bool Next(CaptureRecord *record);
+
+ private:
+  std::string path_;
+  std::ifstream in_;
+};
+
+}  // namespace utils
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace utils {
+
+enum class ContentEncoding { kIdentity, kGzip, kDeflate };
+
+// Picks the best encoding the client accepts from an Accept-Encoding header value
+// (gzip over deflate; q=0 excludes a coding).
+ContentEncoding NegotiateEncoding(std::string_view accept_encoding);
+const char *EncodingName(ContentEncoding encoding);
+
+// Compresses input as gzip or zlib-wrapped deflate. Returns false on zlib failure
+// or for kIdentity.
+bool Compress(std::string_view input, ContentEncoding encoding, std::string *out, int level = 6);
+
+// Raw deflate primed with a preset dictionary, for many small documents that share most
+// of their text (JSON keys, enum values). Reuses one zlib stream, so it is not
+// thread-safe; the same dictionary must be passed to InflateWithDictionary.
+class DictionaryCompressor {
+ public:
+  explicit DictionaryCompressor(std::string dictionary, int level = 6);
+  ~DictionaryCompressor();
+
+  DictionaryCompressor(const DictionaryCompressor &) = delete;
+  DictionaryCompressor &operator=(const DictionaryCompressor &) = delete;
+
+  bool Compress(std::string_view input, std::string *out);
+
+ private:
+  struct Stream;
+  std::string dictionary_;
+  std::unique_ptr<Stream> stream_;
+};
+
+// expected_size is the original length, used to size the output in one go.
+bool InflateWithDictionary(std::string_view input, std::string_view dictionary, size_t expected_size,
+                           std::string *out);
+
+}  // namespace utils
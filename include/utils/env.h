@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace utils {
 
@@ -8,5 +9,9 @@ std::string GetEnv(const std::string &key, const std::string &default_value = ""
 bool GetEnvBool(const std::string &key, bool default_value = false);
 int GetEnvInt(const std::string &key, int default_value = 0);
 double GetEnvDouble(const std::string &key, double default_value = 0.0);
+// Comma-separated list with surrounding whitespace trimmed and empty items dropped.
+std::vector<std::string> GetEnvList(const std::string &key);
+// The same parsing, for a value from elsewhere (e.g. a query parameter).
+std::vector<std::string> SplitList(const std::string &value);
 
 }
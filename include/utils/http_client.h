@@ -1,10 +1,19 @@
 #pragma once
 
+#include "utils/capture.h"
+
 #include <curl/curl.h>
 
+#include <atomic>
+#include <cstdint>
+#include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace utils {
 
@@ -14,22 +23,70 @@ struct HttpResponse {
   std::map<std::string, std::string> headers;
 };
 
+struct HttpClientOptions {
+  long timeout_seconds = 20;
+  // Upper bound on keep-alive connections per host in the pool.
+  long max_host_connections = 8;
+  // Negotiate HTTP/2 over TLS and multiplex requests on one connection when the server allows it.
+  bool http2 = true;
+  // Send Accept-Encoding for every coding libcurl supports and decode transparently.
+  bool compression = true;
+  // When set, every completed response is appended here for later replay.
+  std::shared_ptr<CaptureWriter> capture;
+};
+
+// Thread-safe HTTP client driven by a single curl_multi event loop. Every request is
+// queued to the loop thread, so connections, TLS sessions and DNS lookups are pooled
+// across callers. The blocking Get/Post simply wait on the async result.
 class HttpClient {
  public:
-  HttpClient();
+  explicit HttpClient(HttpClientOptions options = {});
   ~HttpClient();
 
+  HttpClient(const HttpClient &) = delete;
+  HttpClient &operator=(const HttpClient &) = delete;
+
   HttpResponse Get(const std::string &url, const std::map<std::string, std::string> &headers = {});
   HttpResponse Post(const std::string &url,
                     const std::string &body,
                     const std::map<std::string, std::string> &headers = {});
 
+  std::future<HttpResponse> GetAsync(const std::string &url,
+                                     const std::map<std::string, std::string> &headers = {});
+  std::future<HttpResponse> PostAsync(const std::string &url,
+                                      const std::string &body,
+                                      const std::map<std::string, std::string> &headers = {});
+
+  // Response body bytes as received on the wire vs after content decoding.
+  uint64_t wire_bytes() const { return wire_bytes_.load(std::memory_order_relaxed); }
+  uint64_t decoded_bytes() const { return decoded_bytes_.load(std::memory_order_relaxed); }
+
  private:
-  CURL *curl_;
-  HttpResponse Execute(const std::string &url,
-                       const std::string &method,
-                       const std::string &body,
-                       const std::map<std::string, std::string> &headers);
+  struct Transfer;
+
+  std::future<HttpResponse> Submit(const std::string &url,
+                                   const std::string &method,
+                                   const std::string &body,
+                                   const std::map<std::string, std::string> &headers);
+  void Run();
+  void Start(std::unique_ptr<Transfer> transfer);
+  void Finish(CURL *easy, CURLcode result);
+
+  HttpClientOptions options_;
+  CURLM *multi_ = nullptr;
+  CURLSH *share_ = nullptr;
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Transfer>> queued_;
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> wire_bytes_{0};
+  std::atomic<uint64_t> decoded_bytes_{0};
+
+  // Owned by the loop thread.
+  std::unordered_map<CURL *, std::unique_ptr<Transfer>> active_;
+  std::vector<CURL *> idle_handles_;
+
+  std::thread worker_;
 };
 
 }  // namespace utils
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace utils {
+
+// Lock-free log-linear histogram of nanosecond latencies: 8 linear sub-buckets per
+// power of two, so percentiles are accurate to ~12%. Record() is safe from any thread.
+class LatencyHistogram {
+ public:
+  void Record(uint64_t nanos);
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+  double MeanNanos() const;
+  // p in [0, 100]; returns the upper edge of the bucket holding that rank.
+  uint64_t PercentileNanos(double p) const;
+
+ private:
+  static constexpr int kSubBits = 3;
+  static constexpr int kSubBuckets = 1 << kSubBits;
+  static constexpr int kBuckets = 64 * kSubBuckets;
+
+  static int BucketFor(uint64_t nanos);
+  static uint64_t UpperEdge(int bucket);
+
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> total_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+}  // namespace utils
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace utils {
+
+// Token bucket shared by every outbound call to one API. Acquire() blocks until a token
+// is available; Backoff() pauses all callers, e.g. after an HTTP 429.
+class RateLimiter {
+ public:
+  // requests_per_second <= 0 disables limiting (Backoff still applies).
+  RateLimiter(double requests_per_second, double burst);
+
+  void Acquire();
+  void Backoff(std::chrono::milliseconds delay);
+
+  uint64_t waits() const;
+  uint64_t backoffs() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  double rate_;
+  double burst_;
+  double tokens_;
+  Clock::time_point last_refill_;
+  Clock::time_point paused_until_;
+  uint64_t waits_ = 0;
+  uint64_t backoffs_ = 0;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace utils
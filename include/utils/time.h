@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace utils {
+
+constexpr int64_t kNanosPerSecond = 1000000000;
+
+// ISO-8601 UTC with second precision, e.g. 2024-01-31T12:00:00Z.
+std::string FormatIso8601(int64_t unix_seconds);
+std::string NowIso8601();
+
+// Like FormatIso8601, with a fractional part only when unix_nanos has one.
+std::string FormatIso8601Nanos(int64_t unix_nanos);
+// Accepts YYYY-MM-DDTHH:MM:SS with optional fraction and Z or +HH:MM offset.
+bool ParseIso8601(std::string_view text, int64_t *unix_nanos);
+int64_t NowNanos();
+
+}  // namespace utils
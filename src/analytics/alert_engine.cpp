@@ -5,15 +5,33 @@
 
 namespace analytics {
 
-AlertEngine::AlertEngine(double jump_threshold, double spread_threshold)
-    : jump_threshold_(jump_threshold), spread_threshold_(spread_threshold) {}
+AlertEngine::AlertEngine(double jump_threshold, double spread_threshold, double liquidity_drop_threshold)
+    : jump_threshold_(jump_threshold),
+      spread_threshold_(spread_threshold),
+      liquidity_drop_threshold_(liquidity_drop_threshold) {}
+
+void AlertEngine::Restore(const FeatureRow &feature) {
+  if (feature.ticker == kNoTicker) {
+    return;
+  }
+  if (feature.ticker >= last_feature_.size()) {
+    last_feature_.resize(static_cast<size_t>(feature.ticker) + 1);
+  }
+  FeatureRow &last = last_feature_[feature.ticker];
+  if (last.ticker == kNoTicker) {
+    last = feature;
+  }
+}
 
 std::vector<Alert> AlertEngine::Evaluate(const FeatureRow &feature) {
   std::vector<Alert> alerts;
 
-  auto iter = last_feature_.find(feature.ticker);
-  if (iter != last_feature_.end()) {
-    const FeatureRow &prev = iter->second;
+  if (feature.ticker >= last_feature_.size()) {
+    last_feature_.resize(static_cast<size_t>(feature.ticker) + 1);
+  }
+  FeatureRow &last = last_feature_[feature.ticker];
+  if (last.ticker != kNoTicker) {
+    const FeatureRow &prev = last;
     const double jump = std::abs(feature.mid - prev.mid);
     if (jump >= jump_threshold_ && feature.mid > 0.0 && prev.mid > 0.0) {
       Alert alert;
@@ -36,9 +54,27 @@ std::vector<Alert> AlertEngine::Evaluate(const FeatureRow &feature) {
       alert.details = "spread exceeded 10";
       alerts.push_back(alert);
     }
+
+    const double prev_depth = prev.bid_depth + prev.ask_depth;
+    const double depth = feature.bid_depth + feature.ask_depth;
+    if (prev.has_book && feature.has_book && prev_depth > 0.0) {
+      const double drop = (prev_depth - depth) / prev_depth;
+      if (drop >= liquidity_drop_threshold_) {
+        Alert alert;
+        alert.ticker = feature.ticker;
+        alert.ts = feature.ts;
+        alert.type = "liquidity_withdrawal";
+        alert.score = drop;
+        std::ostringstream detail;
+        detail << "depth fell from " << prev_depth << " to " << depth << " (bid " << feature.bid_depth << ", ask "
+               << feature.ask_depth << ")";
+        alert.details = detail.str();
+        alerts.push_back(alert);
+      }
+    }
   }
 
-  last_feature_[feature.ticker] = feature;
+  last = feature;
   return alerts;
 }
 
@@ -0,0 +1,89 @@
+#include "analytics/change_detector.h"
+
+#include <cstring>
+
+namespace analytics {
+
+namespace {
+
+constexpr uint64_t kFnvOffset = 1469598103934665603ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+// Fingerprint slot of a ticker with no snapshot yet; Fingerprint() never returns it.
+constexpr uint64_t kUnseen = 0;
+
+void Mix(uint64_t *hash, const void *data, size_t size) {
+  const auto *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    *hash ^= bytes[i];
+    *hash *= kFnvPrime;
+  }
+}
+
+void MixString(uint64_t *hash, const std::string &value) {
+  Mix(hash, value.data(), value.size());
+  // Separator so ("ab", "c") and ("a", "bc") hash differently.
+  const unsigned char terminator = 0xFF;
+  Mix(hash, &terminator, 1);
+}
+
+void MixDouble(uint64_t *hash, double value) {
+  uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  Mix(hash, &bits, sizeof(bits));
+}
+
+}  // namespace
+
+uint64_t ChangeDetector::Fingerprint(const MarketSnapshot &snapshot) {
+  uint64_t hash = kFnvOffset;
+  MixString(&hash, snapshot.event_ticker);
+  MixString(&hash, snapshot.status);
+  MixString(&hash, snapshot.category);
+  MixDouble(&hash, snapshot.yes_bid);
+  MixDouble(&hash, snapshot.yes_ask);
+  MixDouble(&hash, snapshot.last_price);
+  MixDouble(&hash, snapshot.volume);
+  return hash == kUnseen ? 1 : hash;
+}
+
+bool ChangeDetector::Changed(const MarketSnapshot &snapshot) {
+  const uint64_t fingerprint = Fingerprint(snapshot);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (snapshot.ticker >= fingerprints_.size()) {
+      fingerprints_.resize(static_cast<size_t>(snapshot.ticker) + 1, kUnseen);
+    }
+    uint64_t &last = fingerprints_[snapshot.ticker];
+    if (last == fingerprint) {
+      skipped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    tracked_ += last == kUnseen;
+    last = fingerprint;
+  }
+  processed_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void ChangeDetector::Restore(const MarketSnapshot &snapshot) {
+  if (snapshot.ticker == kNoTicker) {
+    return;
+  }
+  const uint64_t fingerprint = Fingerprint(snapshot);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (snapshot.ticker >= fingerprints_.size()) {
+    fingerprints_.resize(static_cast<size_t>(snapshot.ticker) + 1, kUnseen);
+  }
+  uint64_t &last = fingerprints_[snapshot.ticker];
+  if (last == kUnseen) {
+    last = fingerprint;
+    ++tracked_;
+  }
+}
+
+size_t ChangeDetector::tracked() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tracked_;
+}
+
+}  // namespace analytics
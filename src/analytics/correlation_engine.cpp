@@ -0,0 +1,340 @@
+#include "analytics/correlation_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define KALSHI_CORRELATION_AVX2 1
+#endif
+
+namespace analytics {
+
+namespace {
+
+// Marks a ticker that was turned away at capacity, so it is counted once.
+constexpr uint32_t kRefused = UINT32_MAX - 1;
+// Stored sums are folded back to true values before the scale underflows precision.
+constexpr double kMinScale = 1e-20;
+
+// The kernels update one row of slots in place. Portable versions are simple enough
+// for the compiler to vectorise at the baseline ISA.
+void AddScalarsPortable(double *a, double x, double *b, double y, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] += x;
+    b[i] += y;
+  }
+}
+
+void AxpyPortable(double *row, double a, const double *v, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    row[i] += a * v[i];
+  }
+}
+
+void ScalePortable(double *row, double s, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    row[i] *= s;
+  }
+}
+
+#ifdef KALSHI_CORRELATION_AVX2
+__attribute__((target("avx2,fma"))) void AddScalarsAvx2(double *a, double x, double *b, double y, size_t n) {
+  const __m256d vx = _mm256_set1_pd(x);
+  const __m256d vy = _mm256_set1_pd(y);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(a + i, _mm256_add_pd(_mm256_loadu_pd(a + i), vx));
+    _mm256_storeu_pd(b + i, _mm256_add_pd(_mm256_loadu_pd(b + i), vy));
+  }
+  AddScalarsPortable(a + i, x, b + i, y, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void AxpyAvx2(double *row, double a, const double *v, size_t n) {
+  const __m256d va = _mm256_set1_pd(a);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_pd(row + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(v + i), _mm256_loadu_pd(row + i)));
+    _mm256_storeu_pd(row + i + 4, _mm256_fmadd_pd(va, _mm256_loadu_pd(v + i + 4), _mm256_loadu_pd(row + i + 4)));
+  }
+  AxpyPortable(row + i, a, v + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void ScaleAvx2(double *row, double s, size_t n) {
+  const __m256d vs = _mm256_set1_pd(s);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(row + i, _mm256_mul_pd(_mm256_loadu_pd(row + i), vs));
+  }
+  ScalePortable(row + i, s, n - i);
+}
+#endif
+
+bool CpuHasAvx2() {
+#ifdef KALSHI_CORRELATION_AVX2
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+  return false;
+#endif
+}
+
+void AddScalars(bool avx2, double *a, double x, double *b, double y, size_t n) {
+#ifdef KALSHI_CORRELATION_AVX2
+  if (avx2) {
+    AddScalarsAvx2(a, x, b, y, n);
+    return;
+  }
+#endif
+  (void)avx2;
+  AddScalarsPortable(a, x, b, y, n);
+}
+
+void Axpy(bool avx2, double *row, double a, const double *v, size_t n) {
+#ifdef KALSHI_CORRELATION_AVX2
+  if (avx2) {
+    AxpyAvx2(row, a, v, n);
+    return;
+  }
+#endif
+  (void)avx2;
+  AxpyPortable(row, a, v, n);
+}
+
+void Scale(bool avx2, double *row, double s, size_t n) {
+#ifdef KALSHI_CORRELATION_AVX2
+  if (avx2) {
+    ScaleAvx2(row, s, n);
+    return;
+  }
+#endif
+  (void)avx2;
+  ScalePortable(row, s, n);
+}
+
+}  // namespace
+
+CorrelationEngine::CorrelationEngine(CorrelationOptions options)
+    : options_(options),
+      decay_(options.half_life_steps > 0 ? std::pow(0.5, 1.0 / options.half_life_steps) : 1.0),
+      avx2_(options.simd && CpuHasAvx2()) {}
+
+void CorrelationEngine::Observe(TickerId ticker, double mid) {
+  if (ticker == kNoTicker || !(mid > 0.0)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ticker >= slot_of_.size()) {
+    slot_of_.resize(static_cast<size_t>(ticker) + 1, kNoSlot);
+  }
+  uint32_t slot = slot_of_[ticker];
+  if (slot == kRefused) {
+    return;
+  }
+  if (slot == kNoSlot) {
+    slot = Admit(ticker, mid);
+    slot_of_[ticker] = slot;
+    if (slot == kRefused) {
+      return;
+    }
+  }
+  slots_[slot].mid = mid;
+  slots_[slot].last_seen = steps_;
+}
+
+uint32_t CorrelationEngine::Admit(TickerId ticker, double mid) {
+  uint32_t slot;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else if (slots_.size() < options_.max_tickers) {
+    slot = static_cast<uint32_t>(slots_.size());
+    Reserve(slots_.size() + 1);
+    slots_.emplace_back();
+  } else {
+    ++not_tracked_;
+    return kRefused;
+  }
+  ClearSlot(slot);
+  Slot &entry = slots_[slot];
+  entry.ticker = ticker;
+  entry.mid = mid;
+  entry.base_mid = mid;
+  entry.joined = steps_;
+  entry.last_seen = steps_;
+  ++admitted_;
+  return slot;
+}
+
+void CorrelationEngine::Reserve(size_t slots) {
+  if (slots <= stride_) {
+    return;
+  }
+  size_t stride = std::max<size_t>(stride_ * 2, 64);
+  while (stride < slots) {
+    stride *= 2;
+  }
+  // Whole AVX2 vectors per row.
+  stride = std::min(stride, (options_.max_tickers + 3) / 4 * 4);
+  const size_t used = slots_.size();
+  for (std::vector<double> *matrix : {&sums_, &squares_, &cross_}) {
+    std::vector<double> grown(stride * stride, 0.0);
+    for (size_t row = 0; row < used; ++row) {
+      std::copy_n(matrix->begin() + row * stride_, used, grown.begin() + row * stride);
+    }
+    matrix->swap(grown);
+  }
+  stride_ = stride;
+  returns_.resize(stride_, 0.0);
+}
+
+void CorrelationEngine::ClearSlot(uint32_t slot) {
+  const size_t used = slots_.size();
+  for (std::vector<double> *matrix : {&sums_, &squares_, &cross_}) {
+    std::fill_n(matrix->begin() + slot * stride_, used, 0.0);
+    for (size_t row = 0; row < used; ++row) {
+      (*matrix)[row * stride_ + slot] = 0.0;
+    }
+  }
+}
+
+void CorrelationEngine::Step() {
+  const auto start = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const size_t used = slots_.size();
+  moved_.clear();
+  for (uint32_t slot = 0; slot < used; ++slot) {
+    Slot &entry = slots_[slot];
+    if (entry.ticker == kNoTicker) {
+      continue;
+    }
+    if (steps_ - entry.last_seen >= options_.idle_steps) {
+      slot_of_[entry.ticker] = kNoSlot;
+      entry = Slot();
+      free_slots_.push_back(slot);
+      ++evicted_;
+      // Tickers turned away earlier may take the slot.
+      std::replace(slot_of_.begin(), slot_of_.end(), kRefused, kNoSlot);
+      continue;
+    }
+    const double change = entry.mid - entry.base_mid;
+    entry.base_mid = entry.mid;
+    if (change != 0.0) {
+      returns_[slot] = change;
+      moved_.push_back(slot);
+    }
+  }
+
+  // Everything stored so far decays by one step; this step's returns go in at full
+  // weight, which in stored units is 1 / scale_.
+  scale_ *= decay_;
+  if (scale_ < kMinScale) {
+    Renormalise();
+  }
+  const double weight = 1.0 / scale_;
+  for (const uint32_t slot : moved_) {
+    const double change = returns_[slot];
+    double *sums = &sums_[slot * stride_];
+    double *squares = &squares_[slot * stride_];
+    AddScalars(avx2_, sums, change * weight, squares, change * change * weight, used);
+    // Only partners that moved too have a non-zero return here.
+    Axpy(avx2_, &cross_[slot * stride_ + slot + 1], change * weight, &returns_[slot + 1], used - slot - 1);
+  }
+  for (const uint32_t slot : moved_) {
+    returns_[slot] = 0.0;
+  }
+
+  ++steps_;
+  last_step_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CorrelationEngine::Renormalise() {
+  const size_t used = slots_.size();
+  for (std::vector<double> *matrix : {&sums_, &squares_, &cross_}) {
+    for (size_t row = 0; row < used; ++row) {
+      Scale(avx2_, &(*matrix)[row * stride_], scale_, used);
+    }
+  }
+  scale_ = 1.0;
+}
+
+double CorrelationEngine::SharedWeight(uint32_t slot) const {
+  const uint64_t joined = slots_[slot].joined;
+  const double shared = static_cast<double>(steps_ > joined ? steps_ - joined : 0);
+  return decay_ < 1.0 ? (1.0 - std::pow(decay_, shared)) / (1.0 - decay_) : shared;
+}
+
+double CorrelationEngine::Correlation(uint32_t a, uint32_t b, double n) const {
+  const uint32_t low = std::min(a, b);
+  const uint32_t high = std::max(a, b);
+  const double sx = sums_[a * stride_ + b] * scale_;
+  const double sy = sums_[b * stride_ + a] * scale_;
+  const double sxx = squares_[a * stride_ + b] * scale_;
+  const double syy = squares_[b * stride_ + a] * scale_;
+  const double sxy = cross_[low * stride_ + high] * scale_;
+  if (n < options_.min_samples) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  const double var_x = sxx - sx * sx / n;
+  const double var_y = syy - sy * sy / n;
+  // A side that never moved (or moved by a constant) has no correlation.
+  if (var_x <= 1e-18 || var_y <= 1e-18) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  const double r = (sxy - sx * sy / n) / std::sqrt(var_x * var_y);
+  return std::max(-1.0, std::min(1.0, r));
+}
+
+CorrelationMatrix CorrelationEngine::Correlations(const std::vector<TickerId> &tickers) const {
+  CorrelationMatrix result;
+  std::vector<uint32_t> slots;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const TickerId ticker : tickers) {
+    const uint32_t slot = ticker < slot_of_.size() ? slot_of_[ticker] : kNoSlot;
+    if (slot == kNoSlot || slot == kRefused) {
+      result.untracked.push_back(ticker);
+      continue;
+    }
+    result.tickers.push_back(ticker);
+    slots.push_back(slot);
+  }
+
+  const size_t count = slots.size();
+  // A pair shares the steps since the later of its two admissions.
+  std::vector<double> weights;
+  for (const uint32_t slot : slots) {
+    weights.push_back(SharedWeight(slot));
+  }
+  result.values.assign(count * count, 1.0);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = i + 1; j < count; ++j) {
+      const double r = Correlation(slots[i], slots[j], std::min(weights[i], weights[j]));
+      result.values[i * count + j] = r;
+      result.values[j * count + i] = r;
+    }
+  }
+  result.steps = steps_;
+  return result;
+}
+
+uint64_t CorrelationEngine::steps() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return steps_;
+}
+
+CorrelationStats CorrelationEngine::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CorrelationStats stats;
+  stats.tracked = slots_.size() - free_slots_.size();
+  stats.steps = steps_;
+  stats.admitted = admitted_;
+  stats.evicted = evicted_;
+  stats.not_tracked = not_tracked_;
+  stats.last_step_seconds = last_step_seconds_;
+  stats.kernels = avx2_ ? "avx2" : "scalar";
+  return stats;
+}
+
+}  // namespace analytics
@@ -1,7 +1,7 @@
 #include "analytics/feature_engine.h"
 
-#include <chrono>
-#include <ctime>
+#include "analytics/ticker_registry.h"
+#include "utils/time.h"
 
 namespace analytics {
 
@@ -20,26 +20,13 @@ double GetDouble(const nlohmann::json &obj, const char *key) {
   return 0.0;
 }
 
-std::string NowIso() {
-  using namespace std::chrono;
-  auto now = system_clock::now();
-  auto now_time = system_clock::to_time_t(now);
-  std::tm tm{};
-#if defined(_WIN32)
-  gmtime_s(&tm, &now_time);
-#else
-  gmtime_r(&now_time, &tm);
-#endif
-  char buffer[32];
-  std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm);
-  return std::string(buffer);
-}
-
 }  // namespace
 
+FeatureEngine::FeatureEngine(int depth_levels) : depth_levels_(depth_levels > 0 ? depth_levels : 1) {}
+
 MarketSnapshot FeatureEngine::ParseMarketSnapshot(const nlohmann::json &market) const {
   MarketSnapshot snapshot;
-  snapshot.ticker = GetString(market, "ticker");
+  snapshot.ticker = InternTicker(GetString(market, "ticker"));
   snapshot.event_ticker = GetString(market, "event_ticker");
   snapshot.status = GetString(market, "status");
   snapshot.category = GetString(market, "category");
@@ -47,26 +34,45 @@ MarketSnapshot FeatureEngine::ParseMarketSnapshot(const nlohmann::json &market)
   snapshot.yes_ask = GetDouble(market, "yes_ask");
   snapshot.last_price = GetDouble(market, "last_price");
   snapshot.volume = GetDouble(market, "volume");
-  snapshot.updated_at = GetString(market, "updated_at");
-
-  if (snapshot.updated_at.empty()) {
-    snapshot.updated_at = NowIso();
+  if (!utils::ParseIso8601(GetString(market, "updated_at"), &snapshot.updated_at)) {
+    snapshot.updated_at = utils::NowNanos();
   }
 
   return snapshot;
 }
 
-FeatureRow FeatureEngine::ComputeFeatures(const MarketSnapshot &snapshot) const {
+bool FeatureEngine::ParseMarketBatch(std::string_view body, MarketBatch *batch) const {
+  if (!analytics::ParseMarketBatch(body, batch)) {
+    return false;
+  }
+
+  int64_t now = 0;
+  for (auto &snapshot : batch->snapshots) {
+    if (snapshot.updated_at == 0) {
+      if (now == 0) {
+        now = utils::NowNanos();
+      }
+      snapshot.updated_at = now;
+    }
+  }
+  return true;
+}
+
+double MidPrice(const MarketSnapshot &snapshot) {
+  if (snapshot.yes_bid > 0.0 && snapshot.yes_ask > 0.0) {
+    return (snapshot.yes_bid + snapshot.yes_ask) / 2.0;
+  }
+  return snapshot.last_price;
+}
+
+FeatureRow FeatureEngine::ComputeFeatures(const MarketSnapshot &snapshot, const OrderBook *book) const {
   FeatureRow row;
   row.ticker = snapshot.ticker;
   row.ts = snapshot.updated_at;
 
+  row.mid = MidPrice(snapshot);
   if (snapshot.yes_bid > 0.0 && snapshot.yes_ask > 0.0) {
-    row.mid = (snapshot.yes_bid + snapshot.yes_ask) / 2.0;
     row.spread = snapshot.yes_ask - snapshot.yes_bid;
-  } else {
-    row.mid = snapshot.last_price;
-    row.spread = 0.0;
   }
 
   if (snapshot.last_price > 0.0) {
@@ -76,6 +82,14 @@ FeatureRow FeatureEngine::ComputeFeatures(const MarketSnapshot &snapshot) const
   }
 
   row.volume = snapshot.volume;
+
+  if (book && !book->empty()) {
+    row.has_book = true;
+    row.bid_depth = static_cast<double>(book->BidDepth(depth_levels_));
+    row.ask_depth = static_cast<double>(book->AskDepth(depth_levels_));
+    row.imbalance = book->Imbalance(depth_levels_);
+    row.microprice = book->Microprice();
+  }
   return row;
 }
 
@@ -0,0 +1,439 @@
+#include "analytics/market_parser.h"
+
+#include "analytics/ticker_registry.h"
+#include "utils/time.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace analytics {
+
+namespace {
+
+class Scanner {
+ public:
+  explicit Scanner(std::string_view input) : input_(input) {}
+
+  size_t pos() const { return pos_; }
+
+  void SkipWhitespace() {
+    while (pos_ < input_.size()) {
+      const char c = input_[pos_];
+      if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+        break;
+      }
+      ++pos_;
+    }
+  }
+
+  char Peek() {
+    SkipWhitespace();
+    return pos_ < input_.size() ? input_[pos_] : '\0';
+  }
+
+  bool Consume(char expected) {
+    if (Peek() != expected) {
+      return false;
+    }
+    ++pos_;
+    return true;
+  }
+
+  // Decodes a JSON string. Strings without escapes are returned as a view of the input;
+  // escaped ones are decoded into *scratch.
+  bool ReadString(std::string_view *out, std::string *scratch) {
+    if (!Consume('"')) {
+      return false;
+    }
+    const size_t start = pos_;
+    while (pos_ < input_.size()) {
+      const char c = input_[pos_];
+      if (c == '"') {
+        *out = input_.substr(start, pos_ - start);
+        ++pos_;
+        return true;
+      }
+      if (c == '\\') {
+        pos_ = start;
+        return ReadEscapedString(out, scratch);
+      }
+      ++pos_;
+    }
+    return false;
+  }
+
+  // A token strtod cannot read whole leaves *out alone, as for any other bad field,
+  // rather than failing the page.
+  bool ReadNumber(double *out) {
+    SkipWhitespace();
+    const size_t start = pos_;
+    while (pos_ < input_.size()) {
+      const char c = input_[pos_];
+      if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+        ++pos_;
+      } else {
+        break;
+      }
+    }
+    const size_t length = pos_ - start;
+    if (length == 0) {
+      return false;
+    }
+    // strtod needs a terminated copy; the usual short token stays on the stack.
+    char stack_buffer[64];
+    std::string heap_buffer;
+    char *buffer = stack_buffer;
+    if (length < sizeof(stack_buffer)) {
+      std::memcpy(buffer, input_.data() + start, length);
+      buffer[length] = '\0';
+    } else {
+      heap_buffer.assign(input_.data() + start, length);
+      buffer = &heap_buffer[0];
+    }
+    char *end = nullptr;
+    const double value = std::strtod(buffer, &end);
+    if (end == buffer + length) {
+      *out = value;
+    }
+    return true;
+  }
+
+  bool SkipValue() {
+    const char c = Peek();
+    if (c == '"') {
+      return SkipString();
+    }
+    if (c == '{' || c == '[') {
+      return SkipContainer();
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+      double ignored = 0.0;
+      return ReadNumber(&ignored);
+    }
+    return SkipLiteral("true") || SkipLiteral("false") || SkipLiteral("null");
+  }
+
+ private:
+  bool SkipString() {
+    ++pos_;
+    while (pos_ < input_.size()) {
+      const char c = input_[pos_++];
+      if (c != '\\') {
+        if (c == '"') {
+          return true;
+        }
+        continue;
+      }
+      // \u escapes are checked, so a skipped field rejects what nlohmann rejects.
+      if (pos_ < input_.size() && input_[pos_] == 'u') {
+        ++pos_;
+        unsigned ignored = 0;
+        if (!ReadCodePoint(&ignored)) {
+          return false;
+        }
+      } else {
+        ++pos_;
+      }
+    }
+    return false;
+  }
+
+  bool SkipContainer() {
+    int depth = 0;
+    while (pos_ < input_.size()) {
+      const char c = input_[pos_];
+      if (c == '"') {
+        if (!SkipString()) {
+          return false;
+        }
+        continue;
+      }
+      ++pos_;
+      if (c == '{' || c == '[') {
+        ++depth;
+      } else if (c == '}' || c == ']') {
+        if (--depth == 0) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  bool SkipLiteral(const char *literal) {
+    const size_t length = std::strlen(literal);
+    if (input_.compare(pos_, length, literal) != 0) {
+      return false;
+    }
+    pos_ += length;
+    return true;
+  }
+
+  static void AppendUtf8(unsigned code_point, std::string *out) {
+    if (code_point < 0x80) {
+      out->push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+      out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+      out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+      out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+      out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+      out->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+      out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+  }
+
+  bool ReadHex4(unsigned *out) {
+    if (pos_ + 4 > input_.size()) {
+      return false;
+    }
+    unsigned value = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = input_[pos_++];
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= static_cast<unsigned>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        value |= static_cast<unsigned>(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        value |= static_cast<unsigned>(c - 'A' + 10);
+      } else {
+        return false;
+      }
+    }
+    *out = value;
+    return true;
+  }
+
+  // Reads the hex digits after "\u", joining a surrogate pair into one code point. As in
+  // nlohmann::json, a high surrogate must be followed by a low one and a low surrogate
+  // may not appear alone.
+  bool ReadCodePoint(unsigned *out) {
+    unsigned code_point = 0;
+    if (!ReadHex4(&code_point)) {
+      return false;
+    }
+    if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+      return false;
+    }
+    if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+      unsigned low = 0;
+      if (input_.compare(pos_, 2, "\\u") != 0) {
+        return false;
+      }
+      pos_ += 2;
+      if (!ReadHex4(&low) || low < 0xDC00 || low > 0xDFFF) {
+        return false;
+      }
+      code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+    }
+    *out = code_point;
+    return true;
+  }
+
+  bool ReadEscapedString(std::string_view *out, std::string *scratch) {
+    scratch->clear();
+    while (pos_ < input_.size()) {
+      const char c = input_[pos_++];
+      if (c == '"') {
+        *out = *scratch;
+        return true;
+      }
+      if (c != '\\') {
+        scratch->push_back(c);
+        continue;
+      }
+      if (pos_ >= input_.size()) {
+        return false;
+      }
+      const char escape = input_[pos_++];
+      switch (escape) {
+        case '"': scratch->push_back('"'); break;
+        case '\\': scratch->push_back('\\'); break;
+        case '/': scratch->push_back('/'); break;
+        case 'b': scratch->push_back('\b'); break;
+        case 'f': scratch->push_back('\f'); break;
+        case 'n': scratch->push_back('\n'); break;
+        case 'r': scratch->push_back('\r'); break;
+        case 't': scratch->push_back('\t'); break;
+        case 'u': {
+          unsigned code_point = 0;
+          if (!ReadCodePoint(&code_point)) {
+            return false;
+          }
+          AppendUtf8(code_point, scratch);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  std::string_view input_;
+  size_t pos_ = 0;
+};
+
+bool ParseString(Scanner &scanner, std::string *out, std::string *scratch) {
+  if (scanner.Peek() != '"') {
+    return scanner.SkipValue();
+  }
+  std::string_view value;
+  if (!scanner.ReadString(&value, scratch)) {
+    return false;
+  }
+  out->assign(value.data(), value.size());
+  return true;
+}
+
+bool ParseTicker(Scanner &scanner, TickerId *out, std::string *scratch) {
+  if (scanner.Peek() != '"') {
+    return scanner.SkipValue();
+  }
+  std::string_view value;
+  if (!scanner.ReadString(&value, scratch)) {
+    return false;
+  }
+  *out = InternTicker(value);
+  return true;
+}
+
+// Leaves *out alone for a timestamp it cannot read, as for any other bad field.
+bool ParseTimestamp(Scanner &scanner, int64_t *out, std::string *scratch) {
+  if (scanner.Peek() != '"') {
+    return scanner.SkipValue();
+  }
+  std::string_view value;
+  if (!scanner.ReadString(&value, scratch)) {
+    return false;
+  }
+  utils::ParseIso8601(value, out);
+  return true;
+}
+
+bool ParseDouble(Scanner &scanner, double *out) {
+  const char c = scanner.Peek();
+  if (c == '-' || (c >= '0' && c <= '9')) {
+    return scanner.ReadNumber(out);
+  }
+  return scanner.SkipValue();
+}
+
+bool ParseMarket(Scanner &scanner, MarketSnapshot *snapshot, std::string *scratch) {
+  if (!scanner.Consume('{')) {
+    return false;
+  }
+  if (scanner.Consume('}')) {
+    return true;
+  }
+
+  std::string key_scratch;
+  do {
+    std::string_view key;
+    if (!scanner.ReadString(&key, &key_scratch) || !scanner.Consume(':')) {
+      return false;
+    }
+
+    bool ok = true;
+    if (key == "ticker") {
+      ok = ParseTicker(scanner, &snapshot->ticker, scratch);
+    } else if (key == "event_ticker") {
+      ok = ParseString(scanner, &snapshot->event_ticker, scratch);
+    } else if (key == "status") {
+      ok = ParseString(scanner, &snapshot->status, scratch);
+    } else if (key == "category") {
+      ok = ParseString(scanner, &snapshot->category, scratch);
+    } else if (key == "updated_at") {
+      ok = ParseTimestamp(scanner, &snapshot->updated_at, scratch);
+    } else if (key == "yes_bid") {
+      ok = ParseDouble(scanner, &snapshot->yes_bid);
+    } else if (key == "yes_ask") {
+      ok = ParseDouble(scanner, &snapshot->yes_ask);
+    } else if (key == "last_price") {
+      ok = ParseDouble(scanner, &snapshot->last_price);
+    } else if (key == "volume") {
+      ok = ParseDouble(scanner, &snapshot->volume);
+    } else {
+      ok = scanner.SkipValue();
+    }
+    if (!ok) {
+      return false;
+    }
+  } while (scanner.Consume(','));
+
+  return scanner.Consume('}');
+}
+
+bool ParseMarketArray(Scanner &scanner, std::string_view body, MarketBatch *batch) {
+  if (!scanner.Consume('[')) {
+    return false;
+  }
+  if (scanner.Consume(']')) {
+    return true;
+  }
+
+  std::string scratch;
+  do {
+    if (scanner.Peek() != '{') {
+      if (!scanner.SkipValue()) {
+        return false;
+      }
+      continue;
+    }
+    const size_t start = scanner.pos();
+    MarketSnapshot snapshot;
+    if (!ParseMarket(scanner, &snapshot, &scratch)) {
+      return false;
+    }
+    batch->snapshots.push_back(std::move(snapshot));
+    batch->raw_json.push_back(body.substr(start, scanner.pos() - start));
+  } while (scanner.Consume(','));
+
+  return scanner.Consume(']');
+}
+
+}  // namespace
+
+bool ParseMarketBatch(std::string_view body, MarketBatch *batch) {
+  batch->Clear();
+  Scanner scanner(body);
+
+  if (scanner.Peek() == '[') {
+    return ParseMarketArray(scanner, body, batch);
+  }
+  if (!scanner.Consume('{')) {
+    return false;
+  }
+  if (scanner.Consume('}')) {
+    return true;
+  }
+
+  std::string scratch;
+  do {
+    std::string_view key;
+    if (!scanner.ReadString(&key, &scratch) || !scanner.Consume(':')) {
+      return false;
+    }
+
+    bool ok = true;
+    if (key == "markets") {
+      ok = scanner.Peek() == '[' ? ParseMarketArray(scanner, body, batch) : scanner.SkipValue();
+    } else if (key == "cursor") {
+      ok = ParseString(scanner, &batch->cursor, &scratch);
+    } else {
+      ok = scanner.SkipValue();
+    }
+    if (!ok) {
+      return false;
+    }
+  } while (scanner.Consume(','));
+
+  return scanner.Consume('}');
+}
+
+}  // namespace analytics
@@ -0,0 +1,80 @@
+#include "analytics/order_book.h"
+
+namespace analytics {
+
+void OrderBook::Clear() {
+  yes_.fill(0);
+  no_.fill(0);
+  best_yes_ = 0;
+  best_no_ = 0;
+}
+
+void OrderBook::SetLevel(bool yes_side, int price, long quantity) {
+  if (price < kMinPrice || price > kMaxPrice) {
+    return;
+  }
+  Levels &levels = yes_side ? yes_ : no_;
+  int &best = yes_side ? best_yes_ : best_no_;
+
+  levels[price] = quantity > 0 ? quantity : 0;
+  if (levels[price] > 0) {
+    if (price > best) {
+      best = price;
+    }
+  } else if (price == best) {
+    best = ScanDown(levels, price - 1);
+  }
+}
+
+void OrderBook::ApplyDelta(bool yes_side, int price, long delta) {
+  if (price < kMinPrice || price > kMaxPrice) {
+    return;
+  }
+  SetLevel(yes_side, price, (yes_side ? yes_ : no_)[price] + delta);
+}
+
+long OrderBook::QuantityAt(bool yes_side, int price) const {
+  if (price < kMinPrice || price > kMaxPrice) {
+    return 0;
+  }
+  return (yes_side ? yes_ : no_)[price];
+}
+
+double OrderBook::Imbalance(int levels) const {
+  const double bid = static_cast<double>(BidDepth(levels));
+  const double ask = static_cast<double>(AskDepth(levels));
+  return bid + ask > 0.0 ? (bid - ask) / (bid + ask) : 0.0;
+}
+
+double OrderBook::Microprice() const {
+  const int bid = BestYesBid();
+  const int ask = BestYesAsk();
+  if (bid == 0 || ask == 0) {
+    return bid != 0 ? bid : ask;
+  }
+  const double bid_size = static_cast<double>(yes_[best_yes_]);
+  const double ask_size = static_cast<double>(no_[best_no_]);
+  return (bid * ask_size + ask * bid_size) / (bid_size + ask_size);
+}
+
+long OrderBook::Depth(const Levels &levels, int best, int count) {
+  long total = 0;
+  for (int price = best; price >= kMinPrice && count > 0; --price) {
+    if (levels[price] > 0) {
+      total += levels[price];
+      --count;
+    }
+  }
+  return total;
+}
+
+int OrderBook::ScanDown(const Levels &levels, int from) {
+  for (int price = from; price >= kMinPrice; --price) {
+    if (levels[price] > 0) {
+      return price;
+    }
+  }
+  return 0;
+}
+
+}  // namespace analytics
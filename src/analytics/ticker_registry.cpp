@@ -0,0 +1,84 @@
+#include "analytics/ticker_registry.h"
+
+#include <mutex>
+
+namespace analytics {
+
+namespace {
+
+const std::string kEmpty;
+
+}  // namespace
+
+TickerRegistry &TickerRegistry::Global() {
+  static TickerRegistry registry;
+  return registry;
+}
+
+TickerId TickerRegistry::Intern(std::string_view ticker) {
+  if (ticker.empty()) {
+    return kNoTicker;
+  }
+  {
+    // Almost every call is for a ticker seen before.
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const auto iter = ids_.find(ticker);
+    if (iter != ids_.end()) {
+      return iter->second;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  const auto iter = ids_.find(ticker);
+  if (iter != ids_.end()) {
+    return iter->second;
+  }
+  if (names_.empty()) {
+    names_.emplace_back();
+  }
+  const auto id = static_cast<TickerId>(names_.size());
+  names_.push_back(std::make_unique<const std::string>(ticker));
+  ids_.emplace(*names_.back(), id);
+  return id;
+}
+
+TickerId TickerRegistry::Find(std::string_view ticker) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  const auto iter = ids_.find(ticker);
+  return iter != ids_.end() ? iter->second : kNoTicker;
+}
+
+const std::string &TickerRegistry::Name(TickerId id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  if (id >= names_.size() || !names_[id]) {
+    return kEmpty;
+  }
+  return *names_[id];
+}
+
+bool TickerRegistry::Adopt(TickerId id, std::string_view ticker) {
+  if (id == kNoTicker || ticker.empty()) {
+    return false;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  const auto iter = ids_.find(ticker);
+  if (iter != ids_.end()) {
+    return iter->second == id;
+  }
+  if (id < names_.size() && names_[id]) {
+    return false;
+  }
+  if (id >= names_.size()) {
+    names_.resize(static_cast<size_t>(id) + 1);
+  }
+  names_[id] = std::make_unique<const std::string>(ticker);
+  ids_.emplace(*names_[id], id);
+  return true;
+}
+
+TickerId TickerRegistry::max_id() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return names_.empty() ? kNoTicker : static_cast<TickerId>(names_.size() - 1);
+}
+
+}  // namespace analytics
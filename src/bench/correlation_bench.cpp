@@ -0,0 +1,176 @@
+#include "bench/benchmarks.h"
+
+#include "analytics/correlation_engine.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+// Factors the synthetic markets load on; markets on the same factor co-move.
+constexpr int kFactors = 8;
+// Window the from-scratch recompute covers: two default half-lives.
+constexpr int kNaiveWindow = 240;
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// mids[step][market] for steps + 1 observations. Each step a market moves with
+// probability move_share, by its factor's shock plus its own noise.
+std::vector<std::vector<double>> MakeMids(int markets, int steps, double move_share, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> shock(0.0, 0.1);
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  std::vector<std::vector<double>> mids(steps + 1, std::vector<double>(markets, 50.0));
+  std::vector<double> factor(kFactors);
+  for (int step = 1; step <= steps; ++step) {
+    for (double &value : factor) {
+      value = shock(rng);
+    }
+    for (int m = 0; m < markets; ++m) {
+      double mid = mids[step - 1][m];
+      if (coin(rng) < move_share) {
+        mid += factor[m % kFactors] + 0.5 * shock(rng);
+      }
+      mids[step][m] = std::max(1.0, std::min(99.0, mid));
+    }
+  }
+  return mids;
+}
+
+struct EngineRun {
+  double step_seconds = 0.0;  // summed over every Step()
+  double query_seconds = 0.0;  // one full-matrix Correlations()
+  analytics::CorrelationMatrix matrix;
+  const char *kernels = "";
+};
+
+EngineRun RunEngine(const std::vector<std::vector<double>> &mids, analytics::CorrelationOptions options) {
+  const int markets = static_cast<int>(mids[0].size());
+  options.max_tickers = markets;
+  options.idle_steps = mids.size() + 1;
+  analytics::CorrelationEngine engine(options);
+  std::vector<analytics::TickerId> tickers;
+  for (int m = 0; m < markets; ++m) {
+    tickers.push_back(static_cast<analytics::TickerId>(m + 1));
+    engine.Observe(tickers[m], mids[0][m]);
+  }
+
+  EngineRun run;
+  for (size_t step = 1; step < mids.size(); ++step) {
+    for (int m = 0; m < markets; ++m) {
+      engine.Observe(tickers[m], mids[step][m]);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    engine.Step();
+    run.step_seconds += SecondsSince(start);
+  }
+  const auto start = std::chrono::steady_clock::now();
+  run.matrix = engine.Correlations(tickers);
+  run.query_seconds = SecondsSince(start);
+  run.kernels = engine.stats().kernels;
+  return run;
+}
+
+// Equal-weight Pearson over returns [first, last) of every pair, straight from the mids.
+std::vector<double> DirectCorrelations(const std::vector<std::vector<double>> &mids, size_t first, size_t last) {
+  const size_t markets = mids[0].size();
+  const double n = static_cast<double>(last - first);
+  std::vector<std::vector<double>> returns(markets, std::vector<double>(last - first));
+  for (size_t m = 0; m < markets; ++m) {
+    for (size_t step = first; step < last; ++step) {
+      returns[m][step - first] = mids[step + 1][m] - mids[step][m];
+    }
+  }
+  std::vector<double> values(markets * markets, 1.0);
+  for (size_t a = 0; a < markets; ++a) {
+    for (size_t b = a + 1; b < markets; ++b) {
+      double sx = 0.0, sy = 0.0, sxx = 0.0, syy = 0.0, sxy = 0.0;
+      for (size_t i = 0; i < returns[a].size(); ++i) {
+        const double x = returns[a][i];
+        const double y = returns[b][i];
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        syy += y * y;
+        sxy += x * y;
+      }
+      const double var_x = sxx - sx * sx / n;
+      const double var_y = syy - sy * sy / n;
+      const double r = var_x > 0.0 && var_y > 0.0 ? (sxy - sx * sy / n) / std::sqrt(var_x * var_y)
+                                                  : std::numeric_limits<double>::quiet_NaN();
+      values[a * markets + b] = r;
+      values[b * markets + a] = r;
+    }
+  }
+  return values;
+}
+
+}  // namespace
+
+int RunCorrelationBenchmark(int steps) {
+  if (steps < kNaiveWindow) {
+    spdlog::error("Correlation benchmark needs at least {} steps", kNaiveWindow);
+    return 1;
+  }
+  spdlog::info("Correlation benchmark: {} steps, {} factors, half-life 120 steps", steps, kFactors);
+  spdlog::info("{:>6} {:>8} {:>8} {:>14} {:>14} {:>12} {:>14} {:>10}", "tickers", "moving", "kernels",
+               "step ms", "steps/s", "query ms", "recompute ms", "max error");
+
+  int code = 0;
+  for (const int markets : {100, 500, 1000}) {
+    // What the engine replaces: every pair from scratch over a trailing window, per step.
+    const auto all_moving = MakeMids(markets, steps, 1.0, 42);
+    auto start = std::chrono::steady_clock::now();
+    DirectCorrelations(all_moving, steps - kNaiveWindow, steps);
+    const double recompute = SecondsSince(start);
+
+    // Undecayed, the engine must agree with the direct computation over every step.
+    analytics::CorrelationOptions exact;
+    exact.half_life_steps = 0;
+    exact.min_samples = 2;
+    const EngineRun check = RunEngine(all_moving, exact);
+    const std::vector<double> direct = DirectCorrelations(all_moving, 0, steps);
+    double max_error = 0.0;
+    for (size_t i = 0; i < direct.size(); ++i) {
+      const double got = check.matrix.values[i];
+      if (std::isnan(got) != std::isnan(direct[i])) {
+        max_error = std::numeric_limits<double>::infinity();
+      } else if (!std::isnan(got)) {
+        max_error = std::max(max_error, std::abs(got - direct[i]));
+      }
+    }
+    if (!(max_error < 1e-9)) {
+      spdlog::error("{} tickers: engine differs from direct Pearson by {}", markets, max_error);
+      code = 1;
+    }
+
+    const auto tenth_moving = MakeMids(markets, steps, 0.1, 7);
+    for (const bool simd : {true, false}) {
+      analytics::CorrelationOptions options;
+      options.simd = simd;
+      for (const auto *mids : {&all_moving, &tenth_moving}) {
+        const EngineRun run = RunEngine(*mids, options);
+        if (simd && std::string(run.kernels) == "scalar") {
+          break;  // no AVX2 here; the scalar rows below cover it
+        }
+        spdlog::info("{:>6} {:>7}% {:>8} {:>14.4f} {:>14.0f} {:>12.2f} {:>14.1f} {:>10.1e}", markets,
+                     mids == &all_moving ? 100 : 10, run.kernels, run.step_seconds / steps * 1e3,
+                     steps / run.step_seconds, run.query_seconds * 1e3, recompute * 1e3, max_error);
+      }
+    }
+  }
+  return code;
+}
+
+}  // namespace bench
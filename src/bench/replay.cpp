@@ -0,0 +1,105 @@
+#include "bench/benchmarks.h"
+
+#include "server/http_server.h"
+#include "utils/capture.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace bench {
+
+namespace {
+
+bool IsMarketsPage(const utils::CaptureRecord &record) {
+  return record.status == 200 && record.url.find("/markets?") != std::string::npos;
+}
+
+void LogStage(const char *name, const utils::LatencyHistogram &histogram) {
+  spdlog::info("  {:<8} n={:<8} mean={:>9.1f}us p50={:>9.1f}us p99={:>9.1f}us max={:>9.1f}us", name,
+               histogram.count(), histogram.MeanNanos() / 1000.0, histogram.PercentileNanos(50) / 1000.0,
+               histogram.PercentileNanos(99) / 1000.0, histogram.max() / 1000.0);
+}
+
+}  // namespace
+
+int RunReplay(server::HttpServer &server, const std::string &capture_path, double speed) {
+  std::unique_ptr<utils::CaptureReader> reader;
+  try {
+    reader = std::make_unique<utils::CaptureReader>(capture_path);
+  } catch (const std::exception &ex) {
+    spdlog::error("{}", ex.what());
+    return 1;
+  }
+
+  spdlog::info("Replaying {} at {}", capture_path, speed > 0 ? fmt::format("{}x", speed) : std::string("max speed"));
+
+  server::RefreshStats totals;
+  size_t records = 0;
+  size_t bytes = 0;
+  double max_lag_ms = 0.0;
+  int64_t first_ns = 0;
+  const auto start = std::chrono::steady_clock::now();
+
+  utils::CaptureRecord record;
+  while (reader->Next(&record)) {
+    ++records;
+    if (!IsMarketsPage(record)) {
+      continue;
+    }
+
+    if (speed > 0) {
+      if (first_ns == 0) {
+        first_ns = record.captured_ns;
+      }
+      const auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                   std::chrono::duration<double, std::nano>((record.captured_ns - first_ns) / speed));
+      const auto now = std::chrono::steady_clock::now();
+      if (due > now) {
+        std::this_thread::sleep_until(due);
+      } else {
+        max_lag_ms = std::max(max_lag_ms, std::chrono::duration<double, std::milli>(now - due).count());
+      }
+    }
+
+    utils::HttpResponse response;
+    response.status = record.status;
+    response.body = std::move(record.body);
+    bytes += response.body.size();
+
+    const server::RefreshStats page = server.IngestPage(response);
+    totals.pages += page.pages;
+    totals.markets += page.markets;
+    totals.skipped += page.skipped;
+  }
+
+  // Throughput includes the time for the persist stage to catch up.
+  server.FlushWrites();
+  totals.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  spdlog::info("Replayed {} pages ({} records) in {:.3f}s: {} markets ingested, {} unchanged", totals.pages,
+               records, totals.seconds, totals.markets, totals.skipped);
+  spdlog::info("Throughput: {:.1f} pages/s, {:.1f} markets/s, {:.2f} MB/s", totals.PagesPerSecond(),
+               totals.MarketsPerSecond(), totals.seconds > 0 ? bytes / 1e6 / totals.seconds : 0.0);
+  spdlog::info("Store: {} rows committed at {:.0f} rows/s", server.store_totals().rows,
+               server.store_totals().RowsPerSecond());
+  if (speed > 0) {
+    spdlog::info("Max lag behind capture schedule: {:.1f}ms", max_lag_ms);
+  }
+
+  const server::PipelineMetrics &pipeline = server.pipeline();
+  spdlog::info("Stage latency:");
+  LogStage("parse", pipeline.parse);
+  LogStage("detect", pipeline.detect);
+  LogStage("features", pipeline.features);
+  LogStage("alerts", pipeline.alerts);
+  LogStage("store", pipeline.store);
+  LogStage("publish", pipeline.publish);
+  LogStage("ingest", pipeline.ingest);
+  return 0;
+}
+
+}  // namespace bench
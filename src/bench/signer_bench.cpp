@@ -0,0 +1,147 @@
+#include "bench/benchmarks.h"
+
+#include "kalshi/kalshi_signer.h"
+
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <spdlog/spdlog.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+EVP_PKEY *GenerateKey() {
+  EVP_PKEY *pkey = nullptr;
+  EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+  if (ctx && EVP_PKEY_keygen_init(ctx) > 0 && EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) > 0) {
+    EVP_PKEY_keygen(ctx, &pkey);
+  }
+  EVP_PKEY_CTX_free(ctx);
+  return pkey;
+}
+
+// A generated key file in the temp directory, removed on every exit path.
+class TempKeyFile {
+ public:
+  TempKeyFile() = default;
+  ~TempKeyFile() {
+    if (!path_.empty()) {
+      std::remove(path_.c_str());
+    }
+  }
+
+  TempKeyFile(const TempKeyFile &) = delete;
+  TempKeyFile &operator=(const TempKeyFile &) = delete;
+
+  // Creates the file (readable by the owner only) and writes pkey to it.
+  bool Write(EVP_PKEY *pkey) {
+    std::error_code error;
+    std::string path = (std::filesystem::temp_directory_path(error) / "signer_bench_key.XXXXXX").string();
+    if (error) {
+      return false;
+    }
+    const int fd = mkstemp(path.data());
+    if (fd < 0) {
+      return false;
+    }
+    path_ = path;
+    FILE *fp = fdopen(fd, "wb");
+    if (!fp) {
+      close(fd);
+      return false;
+    }
+    const bool ok = PEM_write_PrivateKey(fp, pkey, nullptr, nullptr, 0, nullptr, nullptr) > 0;
+    return fclose(fp) == 0 && ok;
+  }
+
+  const std::string &path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+template <typename SignFn>
+double Measure(int threads, double seconds, SignFn sign) {
+  std::atomic<bool> stop{false};
+  std::atomic<long> count{0};
+  std::vector<std::thread> workers;
+  const std::string payload = "1700000000000GET/trade-api/v2/portfolio";
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([&]() {
+      long local = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        sign(payload);
+        ++local;
+      }
+      count += local;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return count.load() / elapsed;
+}
+
+}  // namespace
+
+int RunSignerBenchmark(const std::string &private_key_path, int threads, double seconds) {
+  std::string key_path = private_key_path;
+  TempKeyFile temp_key;
+  if (key_path.empty()) {
+    EVP_PKEY *pkey = GenerateKey();
+    const bool written = pkey && temp_key.Write(pkey);
+    EVP_PKEY_free(pkey);
+    if (!written) {
+      spdlog::error("Failed to generate benchmark key");
+      return 1;
+    }
+    key_path = temp_key.path();
+  }
+
+  std::shared_ptr<kalshi::KalshiSigner> cached;
+  try {
+    cached = std::make_shared<kalshi::KalshiSigner>(key_path);
+  } catch (const std::exception &ex) {
+    spdlog::error("Failed to load signing key: {}", ex.what());
+    return 1;
+  }
+
+  const double uncached = Measure(1, seconds, [&key_path](const std::string &payload) {
+    kalshi::KalshiSigner signer(key_path);
+    signer.SignPssSha256(payload);
+  });
+  spdlog::info("signer bench: per-request signer (PEM reload), 1 thread: {:.0f} sig/s", uncached);
+
+  std::vector<int> thread_counts;
+  for (int n = 1; n < threads; n *= 2) {
+    thread_counts.push_back(n);
+  }
+  thread_counts.push_back(std::max(threads, 1));
+
+  for (const int n : thread_counts) {
+    const double rate = Measure(n, seconds, [&cached](const std::string &payload) {
+      cached->SignPssSha256(payload);
+    });
+    spdlog::info("signer bench: cached signer, {} thread(s): {:.0f} sig/s", n, rate);
+  }
+  return 0;
+}
+
+}  // namespace bench
@@ -0,0 +1,198 @@
+#include "bench/benchmarks.h"
+
+#include "analytics/ticker_registry.h"
+#include "server/market_table.h"
+#include "storage/sqlite_store.h"
+#include "utils/latency_histogram.h"
+#include "utils/time.h"
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+struct StoreRun {
+  const char *label;
+  storage::SQLiteStoreOptions options;
+  // Serve the /markets and /events reads from a server::MarketTable patched by the
+  // writer, as HttpServer does.
+  bool market_table = false;
+};
+
+std::vector<analytics::MarketSnapshot> MakeMarkets(int count) {
+  std::vector<analytics::MarketSnapshot> markets(count);
+  for (int i = 0; i < count; ++i) {
+    auto &market = markets[i];
+    market.ticker = analytics::InternTicker("BENCH-" + std::to_string(i));
+    market.event_ticker = "BENCH-EVENT-" + std::to_string(i / 10);
+    market.status = "open";
+    market.category = i % 2 ? "Economics" : "Politics";
+    market.volume = i;
+  }
+  return markets;
+}
+
+// One full refresh: every market re-priced and written in pages of page_size, each
+// page in one transaction like HttpServer::IngestBatch, then applied to table if set.
+uint64_t WriteRefresh(storage::SQLiteStore &store, server::MarketTable *table,
+                      std::vector<analytics::MarketSnapshot> &markets, const std::string &raw_json, int round,
+                      size_t page_size) {
+  uint64_t rows = 0;
+  storage::WriteBatch batch;
+  std::vector<const analytics::MarketSnapshot *> published;
+  const int64_t now = int64_t{round} * utils::kNanosPerSecond;
+  for (size_t start = 0; start < markets.size(); start += page_size) {
+    batch.Clear();
+    for (size_t i = start; i < markets.size() && i < start + page_size; ++i) {
+      auto &market = markets[i];
+      market.yes_bid = 1 + (round + i) % 49;
+      market.yes_ask = market.yes_bid + 2;
+      market.last_price = market.yes_bid + 1;
+      market.updated_at = now;
+      analytics::FeatureRow feature;
+      feature.ticker = market.ticker;
+      feature.ts = now;
+      feature.mid = market.last_price;
+      feature.spread = 2;
+      batch.markets.push_back({market, raw_json});
+      batch.features.push_back({feature, raw_json});
+    }
+    rows += store.Write(batch).rows;
+    if (table) {
+      published.clear();
+      for (const auto &market : batch.markets) {
+        published.push_back(&market.snapshot);
+      }
+      table->Apply(published);
+    }
+  }
+  return rows;
+}
+
+void RunOnce(const StoreRun &run, int readers, int market_count, double seconds) {
+  const std::string path =
+      "/tmp/kalshi_store_bench_" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + ".db";
+  for (const char *suffix : {"", "-wal", "-shm"}) {
+    std::remove((path + suffix).c_str());
+  }
+
+  {
+    storage::SQLiteStore store(path, run.options);
+    store.Init();
+    auto markets = MakeMarkets(market_count);
+    const std::string raw_json(600, 'x');
+    server::MarketTable table;
+    server::MarketTable *published = run.market_table ? &table : nullptr;
+    WriteRefresh(store, published, markets, raw_json, 0, 1000);
+    if (!published && !store.has_search_index()) {
+      spdlog::warn("{}: no FTS5 search index; searched lists scan with LIKE", run.label);
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> rows{0};
+    utils::LatencyHistogram latency;
+    // The /markets and /events reads on their own.
+    utils::LatencyHistogram list_latency;
+
+    std::thread writer([&]() {
+      for (int round = 1; !stop.load(std::memory_order_relaxed); ++round) {
+        rows += WriteRefresh(store, published, markets, raw_json, round, 1000);
+      }
+    });
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < readers; ++t) {
+      workers.emplace_back([&, t]() {
+        std::mt19937 rng(t);
+        for (uint64_t n = 0; !stop.load(std::memory_order_relaxed); ++n) {
+          // Every other list read searches by event ticker, through the trigram index
+          // when the store has it.
+          const std::string search =
+              n % 8 < 4 ? "" : "EVENT-" + std::to_string(rng() % ((markets.size() + 9) / 10));
+          const auto start = std::chrono::steady_clock::now();
+          switch (n % 4) {
+            case 0:
+              if (published) {
+                table.Current()->Markets(200, search);
+              } else {
+                store.ListMarkets(200, search);
+              }
+              break;
+            case 1:
+              if (published) {
+                table.Current()->Events(200, search);
+              } else {
+                store.ListEvents(200, search);
+              }
+              break;
+            case 2:
+              store.RecentAlerts(50);
+              break;
+            default:
+              store.LatestFeatures(markets[rng() % markets.size()].ticker, 50);
+              break;
+          }
+          const auto nanos = static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                  .count());
+          latency.Record(nanos);
+          if (n % 4 < 2) {
+            list_latency.Record(nanos);
+          }
+        }
+      });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    writer.join();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+
+    spdlog::info("{:<22} reads {:>8.0f}/s  p50 {:>8.2f}ms  p99 {:>8.2f}ms  max {:>8.2f}ms  | lists p50 {:>8.3f}ms  "
+                 "p99 {:>8.3f}ms  | writes {:>8.0f} rows/s",
+                 run.label, latency.count() / seconds, latency.PercentileNanos(50) / 1e6,
+                 latency.PercentileNanos(99) / 1e6, latency.max() / 1e6, list_latency.PercentileNanos(50) / 1e6,
+                 list_latency.PercentileNanos(99) / 1e6, rows.load() / seconds);
+  }
+
+  for (const char *suffix : {"", "-wal", "-shm"}) {
+    std::remove((path + suffix).c_str());
+  }
+}
+
+}  // namespace
+
+int RunStoreBenchmark(int readers, int markets, double seconds) {
+  if (readers < 1 || markets < 1) {
+    spdlog::error("Store benchmark needs at least one reader and one market");
+    return 1;
+  }
+  spdlog::info("Store benchmark: {} reader threads, {} markets, continuous full refreshes, {}s per run", readers,
+               markets, seconds);
+
+  storage::SQLiteStoreOptions single;
+  single.wal = false;
+  single.read_connections = 0;
+  storage::SQLiteStoreOptions pooled;
+  pooled.read_connections = readers;
+
+  for (const StoreRun &run : {StoreRun{"single connection", single}, StoreRun{"wal + reader pool", pooled},
+                              StoreRun{"wal + market table", pooled, true}}) {
+    RunOnce(run, readers, markets, seconds);
+  }
+  return 0;
+}
+
+}  // namespace bench
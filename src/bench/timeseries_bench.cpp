@@ -0,0 +1,166 @@
+#include "bench/benchmarks.h"
+
+#include "analytics/ticker_registry.h"
+#include "storage/sqlite_store.h"
+#include "storage/time_series_store.h"
+#include "utils/time.h"
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint64_t FileBytes(const std::string &path) {
+  std::error_code error;
+  const auto size = std::filesystem::file_size(path, error);
+  return error ? 0 : static_cast<uint64_t>(size);
+}
+
+analytics::FeatureRow MakeFeature(analytics::TickerId ticker, int64_t time_nanos, int round, int market) {
+  analytics::FeatureRow row;
+  row.ticker = ticker;
+  row.ts = time_nanos;
+  row.mid = 1 + (round * 7 + market) % 98;
+  row.spread = 1 + round % 5;
+  row.prob = row.mid / 100.0;
+  row.volume = round * 10.0 + market;
+  return row;
+}
+
+}  // namespace
+
+int RunTimeSeriesBenchmark(int markets, int rows) {
+  if (markets < 1 || rows < 1) {
+    spdlog::error("Time series benchmark needs at least one market and one row");
+    return 1;
+  }
+
+  const std::string stamp = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+  const std::string db_path = "/tmp/kalshi_ts_bench_" + stamp + ".db";
+  const std::string series_dir = "/tmp/kalshi_ts_bench_" + stamp;
+  std::vector<analytics::TickerId> tickers;
+  for (int i = 0; i < markets; ++i) {
+    tickers.push_back(analytics::InternTicker("BENCH-" + std::to_string(i)));
+  }
+  // Same shape as a /markets entry, which is what every features row carries today.
+  const std::string raw_json(600, 'x');
+  const int64_t base_time = utils::NowNanos() - static_cast<int64_t>(rows) * utils::kNanosPerSecond;
+  const uint64_t total_rows = static_cast<uint64_t>(markets) * rows;
+  spdlog::info("Time series benchmark: {} markets x {} rows = {} feature rows", markets, rows, total_rows);
+
+  int code = 0;
+  {
+    storage::SQLiteStore store(db_path);
+    store.Init();
+    storage::TimeSeriesStore series(series_dir);
+
+    // One transaction per refresh round, as the ingest path writes them.
+    auto start = std::chrono::steady_clock::now();
+    storage::WriteBatch batch;
+    for (int round = 0; round < rows; ++round) {
+      batch.Clear();
+      const int64_t time = base_time + static_cast<int64_t>(round) * 1000000000;
+      for (int m = 0; m < markets; ++m) {
+        batch.features.push_back({MakeFeature(tickers[m], time, round, m), raw_json});
+      }
+      store.Write(batch);
+    }
+    const double sqlite_write = SecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rows; ++round) {
+      const int64_t time = base_time + static_cast<int64_t>(round) * 1000000000;
+      for (int m = 0; m < markets; ++m) {
+        series.Append(MakeFeature(tickers[m], time, round, m));
+      }
+    }
+    const double series_write = SecondsSince(start);
+
+    // Full history of every ticker, materialised as FeatureRows by both backends.
+    start = std::chrono::steady_clock::now();
+    uint64_t sqlite_scanned = 0;
+    for (const auto &ticker : tickers) {
+      sqlite_scanned +=
+          store.FeatureRange(ticker, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()).size();
+    }
+    const double sqlite_scan = SecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    uint64_t series_scanned = 0;
+    for (const auto &ticker : tickers) {
+      series_scanned +=
+          series.Range(ticker, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), 0).size();
+    }
+    const double series_scan = SecondsSince(start);
+
+    // What a chart or correlation actually needs: one column over time, read in place.
+    start = std::chrono::steady_clock::now();
+    double checksum = 0.0;
+    uint64_t column_scanned = 0;
+    for (const auto &ticker : tickers) {
+      series.Scan(ticker, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(),
+                  [&](const storage::SeriesChunk &chunk) {
+                    for (size_t i = 0; i < chunk.size; ++i) {
+                      checksum += chunk.mid[i];
+                    }
+                    column_scanned += chunk.size;
+                  });
+    }
+    const double column_scan = SecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (const auto &ticker : tickers) {
+      store.LatestFeatures(ticker, 50);
+    }
+    const double sqlite_latest = SecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (const auto &ticker : tickers) {
+      series.Latest(ticker, 50);
+    }
+    const double series_latest = SecondsSince(start);
+
+    const uint64_t sqlite_bytes = FileBytes(db_path) + FileBytes(db_path + "-wal");
+    const uint64_t series_bytes = series.stats().disk_bytes;
+    if (sqlite_scanned != total_rows || series_scanned != total_rows || column_scanned != total_rows) {
+      spdlog::error("Row count mismatch: sqlite {} series {} column {} expected {}", sqlite_scanned, series_scanned,
+                    column_scanned, total_rows);
+      code = 1;
+    }
+
+    spdlog::info("{:<24} {:>14} {:>14}", "", "sqlite", "timeseries");
+    spdlog::info("{:<24} {:>11.1f} MB {:>11.1f} MB", "disk", sqlite_bytes / 1e6, series_bytes / 1e6);
+    spdlog::info("{:<24} {:>14.1f} {:>14.1f}", "bytes/row", static_cast<double>(sqlite_bytes) / total_rows,
+                 static_cast<double>(series_bytes) / total_rows);
+    spdlog::info("{:<24} {:>12.0f}/s {:>12.0f}/s", "append rows", total_rows / sqlite_write,
+                 total_rows / series_write);
+    spdlog::info("{:<24} {:>12.0f}/s {:>12.0f}/s", "full-history scan rows", total_rows / sqlite_scan,
+                 total_rows / series_scan);
+    spdlog::info("{:<24} {:>14} {:>12.0f}/s", "zero-copy mid scan rows", "-", total_rows / column_scan);
+    spdlog::info("{:<24} {:>11.1f} us {:>11.1f} us", "latest 50 per ticker", sqlite_latest / markets * 1e6,
+                 series_latest / markets * 1e6);
+    spdlog::debug("checksum {}", checksum);
+  }
+
+  for (const char *suffix : {"", "-wal", "-shm"}) {
+    std::remove((db_path + suffix).c_str());
+  }
+  std::error_code error;
+  std::filesystem::remove_all(series_dir, error);
+  return code;
+}
+
+}  // namespace bench
@@ -3,7 +3,10 @@
 #include "kalshi/kalshi_signer.h"
 #include "utils/base64.h"
 
+#include <algorithm>
+#include <cctype>
 #include <chrono>
+#include <cstdlib>
 #include <sstream>
 
 #include <spdlog/spdlog.h>
@@ -17,6 +20,22 @@ std::string NowMs() {
   return std::to_string(now.time_since_epoch().count());
 }
 
+std::string UrlEncode(const std::string &value) {
+  static const char kHex[] = "0123456789ABCDEF";
+  std::string out;
+  out.reserve(value.size());
+  for (const unsigned char c : value) {
+    if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      out.push_back(static_cast<char>(c));
+    } else {
+      out.push_back('%');
+      out.push_back(kHex[c >> 4]);
+      out.push_back(kHex[c & 0x0F]);
+    }
+  }
+  return out;
+}
+
 nlohmann::json ParseJsonResponse(const utils::HttpResponse &response) {
   if (response.body.empty()) {
     return nlohmann::json::object();
@@ -30,56 +49,122 @@ nlohmann::json ParseJsonResponse(const utils::HttpResponse &response) {
   }
 }
 
+// Retry-After (seconds) when the server sent one, otherwise exponential from 500ms.
+std::chrono::milliseconds RetryDelay(const utils::HttpResponse &response, int attempt) {
+  for (const auto &kv : response.headers) {
+    std::string key = kv.first;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (key == "retry-after") {
+      const int seconds = std::atoi(kv.second.c_str());
+      if (seconds > 0) {
+        return std::chrono::seconds(seconds);
+      }
+    }
+  }
+  return std::chrono::milliseconds(500) * (1 << std::min(attempt - 1, 6));
+}
+
+std::future<nlohmann::json> ParseJsonAsync(std::future<utils::HttpResponse> pending) {
+  return std::async(std::launch::deferred, [pending = std::move(pending)]() mutable {
+    return ParseJsonResponse(pending.get());
+  });
+}
+
 }  // namespace
 
 KalshiClient::KalshiClient(KalshiClientConfig config, std::shared_ptr<utils::HttpClient> http)
-    : config_(std::move(config)), http_(std::move(http)) {}
-
-nlohmann::json KalshiClient::GetMarkets(int limit, const std::string &cursor) {
-  std::ostringstream path;
-  path << "/markets?limit=" << limit;
-  if (!cursor.empty()) {
-    path << "&cursor=" << cursor;
+    : config_(std::move(config)),
+      http_(std::move(http)),
+      limiter_(std::make_shared<utils::RateLimiter>(config_.requests_per_second, config_.burst)) {
+  if (config_.private_key_path.empty()) {
+    return;
+  }
+  try {
+    signer_ = std::make_shared<KalshiSigner>(config_.private_key_path);
+  } catch (const std::exception &ex) {
+    spdlog::error("Failed to load signing key: {}", ex.what());
   }
+}
 
-  auto response = http_->Get(BuildUrl(path.str()));
-  return ParseJsonResponse(response);
+nlohmann::json KalshiClient::GetMarkets(int limit, const std::string &cursor) {
+  return GetMarketsAsync(limit, cursor).get();
 }
 
 nlohmann::json KalshiClient::GetMarket(const std::string &ticker) {
-  std::string path = "/markets/" + ticker;
-  auto response = http_->Get(BuildUrl(path));
-  return ParseJsonResponse(response);
+  return GetMarketAsync(ticker).get();
 }
 
 nlohmann::json KalshiClient::GetEvents(int limit, const std::string &cursor) {
-  std::ostringstream path;
-  path << "/events?limit=" << limit;
-  if (!cursor.empty()) {
-    path << "&cursor=" << cursor;
-  }
+  return GetEventsAsync(limit, cursor).get();
+}
+
+std::future<nlohmann::json> KalshiClient::GetMarketsAsync(int limit, const std::string &cursor) {
+  return ParseJsonAsync(Send(ListPath("/markets", limit, cursor), false));
+}
+
+std::future<utils::HttpResponse> KalshiClient::GetMarketsRawAsync(int limit, const std::string &cursor) {
+  return Send(ListPath("/markets", limit, cursor), false);
+}
+
+std::future<nlohmann::json> KalshiClient::GetMarketAsync(const std::string &ticker) {
+  return ParseJsonAsync(Send("/markets/" + ticker, false));
+}
 
-  auto response = http_->Get(BuildUrl(path.str()));
-  return ParseJsonResponse(response);
+std::future<nlohmann::json> KalshiClient::GetEventsAsync(int limit, const std::string &cursor) {
+  return ParseJsonAsync(Send(ListPath("/events", limit, cursor), false));
 }
 
 nlohmann::json KalshiClient::GetPortfolio() {
-  const std::string path = "/portfolio";
-  const std::string body = "";
-  auto headers = BuildAuthHeaders("GET", path, body);
-  auto response = http_->Get(BuildUrl(path), headers);
-  return ParseJsonResponse(response);
+  return ParseJsonResponse(Send("/portfolio", true).get());
+}
+
+std::future<utils::HttpResponse> KalshiClient::Send(const std::string &path, bool sign) {
+  limiter_->Acquire();
+  const std::string url = BuildUrl(path);
+  auto first = http_->GetAsync(url, sign ? BuildAuthHeaders("GET", path, "") : std::map<std::string, std::string>{});
+
+  return std::async(std::launch::deferred, [this, path, url, sign, first = std::move(first)]() mutable {
+    utils::HttpResponse response = first.get();
+    for (int attempt = 1; response.status == 429 && attempt <= config_.max_retries; ++attempt) {
+      const auto delay = RetryDelay(response, attempt);
+      spdlog::warn("Kalshi rate limited on {}; retry {}/{} in {}ms", path, attempt, config_.max_retries,
+                   delay.count());
+      limiter_->Backoff(delay);
+      limiter_->Acquire();
+      // Signatures are timestamped, so sign each attempt afresh.
+      response = http_->Get(url, sign ? BuildAuthHeaders("GET", path, "") : std::map<std::string, std::string>{});
+    }
+    return response;
+  });
+}
+
+bool KalshiClient::HasAuth() const {
+  return !config_.api_key.empty() && signer_ != nullptr;
+}
+
+std::map<std::string, std::string> KalshiClient::SignedHeaders(const std::string &method,
+                                                                const std::string &path) const {
+  return BuildAuthHeaders(method, path, "");
 }
 
 std::string KalshiClient::BuildUrl(const std::string &path) const {
   return config_.base_url + path;
 }
 
+std::string KalshiClient::ListPath(const std::string &resource, int limit, const std::string &cursor) const {
+  std::ostringstream path;
+  path << resource << "?limit=" << limit;
+  if (!cursor.empty()) {
+    path << "&cursor=" << UrlEncode(cursor);
+  }
+  return path.str();
+}
+
 std::map<std::string, std::string> KalshiClient::BuildAuthHeaders(const std::string &method,
                                                                    const std::string &path,
                                                                    const std::string &body) const {
   std::map<std::string, std::string> headers;
-  if (config_.api_key.empty() || config_.private_key_path.empty()) {
+  if (config_.api_key.empty() || !signer_) {
     spdlog::warn("Kalshi auth missing; returning empty headers");
     return headers;
   }
@@ -89,8 +174,7 @@ std::map<std::string, std::string> KalshiClient::BuildAuthHeaders(const std::str
 
   std::string signature_b64;
   try {
-    KalshiSigner signer(config_.private_key_path);
-    const std::string raw_signature = signer.SignPssSha256(payload);
+    const std::string raw_signature = signer_->SignPssSha256(payload);
     signature_b64 = utils::Base64Encode(raw_signature);
   } catch (const std::exception &ex) {
     spdlog::error("Failed to sign request: {}", ex.what());
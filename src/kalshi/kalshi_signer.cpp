@@ -20,41 +20,83 @@ KalshiSigner::KalshiSigner(const std::string &private_key_pem_path) {
   if (!pkey_) {
     throw std::runtime_error("Failed to load private key");
   }
+
+  PrepareTemplate();
 }
 
 KalshiSigner::~KalshiSigner() {
+  for (EVP_MD_CTX *ctx : pool_) {
+    EVP_MD_CTX_free(ctx);
+  }
+  if (template_) {
+    EVP_MD_CTX_free(template_);
+  }
   if (pkey_) {
     EVP_PKEY_free(pkey_);
   }
 }
 
-std::string KalshiSigner::SignPssSha256(const std::string &payload) const {
-  if (!pkey_) {
-    throw std::runtime_error("Signer key not loaded");
+void KalshiSigner::PrepareTemplate() {
+  // Constructors that throw never reach the destructor, so release what we own here.
+  auto fail = [this](const char *message) {
+    EVP_MD_CTX_free(template_);
+    template_ = nullptr;
+    EVP_PKEY_free(pkey_);
+    pkey_ = nullptr;
+    throw std::runtime_error(message);
+  };
+
+  template_ = EVP_MD_CTX_new();
+  if (!template_) {
+    fail("Failed to create digest context");
+  }
+
+  if (EVP_DigestSignInit(template_, nullptr, EVP_sha256(), nullptr, pkey_) <= 0) {
+    fail("DigestSignInit failed");
+  }
+
+  EVP_PKEY_CTX *pkey_ctx = EVP_MD_CTX_pkey_ctx(template_);
+  if (!pkey_ctx || EVP_PKEY_CTX_set_rsa_padding(pkey_ctx, RSA_PKCS1_PSS_PADDING) <= 0) {
+    fail("Failed to set RSA-PSS padding");
+  }
+
+  if (EVP_PKEY_CTX_set_rsa_pss_saltlen(pkey_ctx, -1) <= 0) {
+    fail("Failed to set RSA-PSS salt length");
   }
 
+  max_signature_size_ = static_cast<size_t>(EVP_PKEY_size(pkey_));
+}
+
+EVP_MD_CTX *KalshiSigner::AcquireContext() const {
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (!pool_.empty()) {
+      EVP_MD_CTX *ctx = pool_.back();
+      pool_.pop_back();
+      return ctx;
+    }
+  }
   EVP_MD_CTX *ctx = EVP_MD_CTX_new();
   if (!ctx) {
     throw std::runtime_error("Failed to create digest context");
   }
+  return ctx;
+}
 
-  size_t sig_len = 0;
-  std::string signature;
-
-  if (EVP_DigestSignInit(ctx, nullptr, EVP_sha256(), nullptr, pkey_) <= 0) {
-    EVP_MD_CTX_free(ctx);
-    throw std::runtime_error("DigestSignInit failed");
-  }
+void KalshiSigner::ReleaseContext(EVP_MD_CTX *ctx) const {
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  pool_.push_back(ctx);
+}
 
-  EVP_PKEY_CTX *pkey_ctx = EVP_MD_CTX_pkey_ctx(ctx);
-  if (!pkey_ctx || EVP_PKEY_CTX_set_rsa_padding(pkey_ctx, RSA_PKCS1_PSS_PADDING) <= 0) {
-    EVP_MD_CTX_free(ctx);
-    throw std::runtime_error("Failed to set RSA-PSS padding");
+std::string KalshiSigner::SignPssSha256(const std::string &payload) const {
+  if (!pkey_ || !template_) {
+    throw std::runtime_error("Signer key not loaded");
   }
 
-  if (EVP_PKEY_CTX_set_rsa_pss_saltlen(pkey_ctx, -1) <= 0) {
+  EVP_MD_CTX *ctx = AcquireContext();
+  if (EVP_MD_CTX_copy_ex(ctx, template_) <= 0) {
     EVP_MD_CTX_free(ctx);
-    throw std::runtime_error("Failed to set RSA-PSS salt length");
+    throw std::runtime_error("Failed to clone signing context");
   }
 
   if (EVP_DigestSignUpdate(ctx, payload.data(), payload.size()) <= 0) {
@@ -62,12 +104,8 @@ std::string KalshiSigner::SignPssSha256(const std::string &payload) const {
     throw std::runtime_error("DigestSignUpdate failed");
   }
 
-  if (EVP_DigestSignFinal(ctx, nullptr, &sig_len) <= 0) {
-    EVP_MD_CTX_free(ctx);
-    throw std::runtime_error("DigestSignFinal size failed");
-  }
-
-  signature.resize(sig_len);
+  size_t sig_len = max_signature_size_;
+  std::string signature(sig_len, '\0');
 
   if (EVP_DigestSignFinal(ctx, reinterpret_cast<unsigned char *>(&signature[0]), &sig_len) <= 0) {
     EVP_MD_CTX_free(ctx);
@@ -75,7 +113,7 @@ std::string KalshiSigner::SignPssSha256(const std::string &payload) const {
   }
 
   signature.resize(sig_len);
-  EVP_MD_CTX_free(ctx);
+  ReleaseContext(ctx);
 
   return signature;
 }
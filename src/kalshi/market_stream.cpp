@@ -0,0 +1,367 @@
+#include "kalshi/market_stream.h"
+
+#include "kalshi/kalshi_client.h"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#else
+#include <poll.h>
+#endif
+
+namespace kalshi {
+
+namespace {
+
+constexpr size_t kReadChunk = 64 * 1024;
+
+std::string UrlPath(const std::string &url) {
+  const auto scheme = url.find("://");
+  const auto path = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+  return path == std::string::npos ? "/" : url.substr(path);
+}
+
+double GetDouble(const nlohmann::json &obj, const char *key) {
+  auto iter = obj.find(key);
+  if (iter != obj.end() && iter->is_number()) {
+    return iter->get<double>();
+  }
+  return 0.0;
+}
+
+int64_t GetInt(const nlohmann::json &obj, const char *key) {
+  auto iter = obj.find(key);
+  if (iter != obj.end() && iter->is_number_integer()) {
+    return iter->get<int64_t>();
+  }
+  return 0;
+}
+
+std::string GetString(const nlohmann::json &obj, const char *key, const char *fallback = "") {
+  auto iter = obj.find(key);
+  if (iter != obj.end() && iter->is_string()) {
+    return iter->get<std::string>();
+  }
+  return fallback;
+}
+
+std::vector<OrderbookLevel> ParseLevels(const nlohmann::json &msg, const char *side) {
+  std::vector<OrderbookLevel> levels;
+  auto iter = msg.find(side);
+  if (iter == msg.end() || !iter->is_array()) {
+    return levels;
+  }
+  for (const auto &level : *iter) {
+    if (level.is_array() && level.size() >= 2 && level[0].is_number() && level[1].is_number()) {
+      levels.push_back({level[0].get<int>(), level[1].get<long>()});
+    }
+  }
+  return levels;
+}
+
+bool WaitReadable(curl_socket_t sock, int timeout_ms) {
+#if defined(_WIN32)
+  WSAPOLLFD pfd{sock, POLLIN, 0};
+  return WSAPoll(&pfd, 1, timeout_ms) > 0;
+#else
+  pollfd pfd{sock, POLLIN, 0};
+  return poll(&pfd, 1, timeout_ms) > 0;
+#endif
+}
+
+}  // namespace
+
+MarketStream::MarketStream(MarketStreamConfig config, std::shared_ptr<KalshiClient> client)
+    : config_(std::move(config)), client_(std::move(client)) {}
+
+MarketStream::~MarketStream() {
+  Stop();
+}
+
+void MarketStream::SetHandlers(Handlers handlers) {
+  handlers_ = std::move(handlers);
+}
+
+void MarketStream::Start() {
+  if (worker_.joinable()) {
+    return;
+  }
+  stop_ = false;
+  worker_ = std::thread([this]() { Run(); });
+}
+
+void MarketStream::Stop() {
+  stop_ = true;
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+MarketStream::Stats MarketStream::stats() const {
+  Stats stats;
+  stats.messages = messages_.load();
+  stats.connects = connects_.load();
+  stats.sequence_gaps = sequence_gaps_.load();
+  stats.connected = connected_.load();
+  return stats;
+}
+
+void MarketStream::Run() {
+  int backoff_seconds = 1;
+  while (!stop_) {
+    if (!Connect() || !Subscribe()) {
+      Disconnect();
+      spdlog::warn("Market stream unavailable; retrying in {}s", backoff_seconds);
+      const auto resume = std::chrono::steady_clock::now() + std::chrono::seconds(backoff_seconds);
+      while (!stop_ && std::chrono::steady_clock::now() < resume) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+      backoff_seconds = std::min(backoff_seconds * 2, config_.max_backoff_seconds);
+      continue;
+    }
+
+    backoff_seconds = 1;
+    connected_ = true;
+    ++connects_;
+    spdlog::info("Market stream connected to {}", config_.url);
+
+    // Updates sent while we were away are gone; let the owner reseed over REST.
+    if (handlers_.on_resync) {
+      handlers_.on_resync();
+    }
+
+    while (!stop_ && ReadMessages()) {
+    }
+
+    connected_ = false;
+    Disconnect();
+  }
+}
+
+bool MarketStream::Connect() {
+  curl_ = curl_easy_init();
+  if (!curl_) {
+    return false;
+  }
+
+  if (client_ && client_->HasAuth()) {
+    for (const auto &kv : client_->SignedHeaders("GET", UrlPath(config_.url))) {
+      std::string entry = kv.first + ": " + kv.second;
+      header_list_ = curl_slist_append(header_list_, entry.c_str());
+    }
+  }
+
+  curl_easy_setopt(curl_, CURLOPT_URL, config_.url.c_str());
+  curl_easy_setopt(curl_, CURLOPT_CONNECT_ONLY, 2L);
+  curl_easy_setopt(curl_, CURLOPT_CONNECTTIMEOUT, 10L);
+  curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+  if (header_list_) {
+    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, header_list_);
+  }
+
+  const CURLcode code = curl_easy_perform(curl_);
+  if (code != CURLE_OK) {
+    spdlog::warn("Market stream connect to {} failed: {}", config_.url, curl_easy_strerror(code));
+    return false;
+  }
+
+  frame_buffer_.clear();
+  last_seq_.clear();
+  last_activity_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+void MarketStream::Disconnect() {
+  if (curl_) {
+    curl_easy_cleanup(curl_);
+    curl_ = nullptr;
+  }
+  if (header_list_) {
+    curl_slist_free_all(header_list_);
+    header_list_ = nullptr;
+  }
+}
+
+bool MarketStream::Subscribe() {
+  nlohmann::json ticker_params = {{"channels", {"ticker"}}};
+  if (!config_.tickers.empty()) {
+    ticker_params["market_tickers"] = config_.tickers;
+  }
+  nlohmann::json ticker_cmd = {{"id", next_command_id_++}, {"cmd", "subscribe"}, {"params", ticker_params}};
+  if (!SendText(ticker_cmd.dump())) {
+    return false;
+  }
+
+  if (config_.orderbook && !config_.tickers.empty()) {
+    nlohmann::json book_cmd = {
+        {"id", next_command_id_++},
+        {"cmd", "subscribe"},
+        {"params", {{"channels", {"orderbook_delta"}}, {"market_tickers", config_.tickers}}},
+    };
+    if (!SendText(book_cmd.dump())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MarketStream::SendText(const std::string &text) {
+  size_t offset = 0;
+  while (offset < text.size()) {
+    size_t sent = 0;
+    const CURLcode code =
+        curl_ws_send(curl_, text.data() + offset, text.size() - offset, &sent, 0, CURLWS_TEXT);
+    if (code == CURLE_AGAIN) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    if (code != CURLE_OK) {
+      spdlog::warn("Market stream send failed: {}", curl_easy_strerror(code));
+      return false;
+    }
+    offset += sent;
+  }
+  return true;
+}
+
+bool MarketStream::ReadMessages() {
+  curl_socket_t sock = CURL_SOCKET_BAD;
+  curl_easy_getinfo(curl_, CURLINFO_ACTIVESOCKET, &sock);
+  if (sock == CURL_SOCKET_BAD) {
+    return false;
+  }
+
+  WaitReadable(sock, 1000);
+
+  char buffer[kReadChunk];
+  while (!stop_) {
+    size_t received = 0;
+    const struct curl_ws_frame *meta = nullptr;
+    const CURLcode code = curl_ws_recv(curl_, buffer, sizeof(buffer), &received, &meta);
+    if (code == CURLE_AGAIN) {
+      break;
+    }
+    if (code != CURLE_OK) {
+      spdlog::warn("Market stream read failed: {}", curl_easy_strerror(code));
+      return false;
+    }
+
+    last_activity_ = std::chrono::steady_clock::now();
+    if (meta->flags & CURLWS_CLOSE) {
+      spdlog::warn("Market stream closed by server");
+      return false;
+    }
+    if (meta->flags & (CURLWS_PING | CURLWS_PONG)) {
+      continue;
+    }
+
+    frame_buffer_.append(buffer, received);
+    if (meta->bytesleft == 0 && !(meta->flags & CURLWS_CONT)) {
+      bool ok = true;
+      // A frame that trips up parsing or a handler is dropped; it must not take the
+      // stream thread (and with it the process) down.
+      try {
+        ok = Dispatch(frame_buffer_);
+      } catch (const std::exception &ex) {
+        spdlog::error("Dropped market stream frame ({}): {:.512}", ex.what(), frame_buffer_);
+      }
+      frame_buffer_.clear();
+      if (!ok) {
+        return false;
+      }
+    }
+  }
+
+  if (std::chrono::steady_clock::now() - last_activity_ > std::chrono::seconds(config_.idle_timeout_seconds)) {
+    spdlog::warn("Market stream idle for {}s; reconnecting", config_.idle_timeout_seconds);
+    return false;
+  }
+  return true;
+}
+
+bool MarketStream::Dispatch(const std::string &text) {
+  const auto received = std::chrono::steady_clock::now();
+  nlohmann::json message;
+  try {
+    message = nlohmann::json::parse(text);
+  } catch (const std::exception &ex) {
+    spdlog::error("Failed to parse stream message: {}", ex.what());
+    return true;
+  }
+  ++messages_;
+  if (!message.is_object()) {
+    spdlog::warn("Ignoring non-object stream message: {:.512}", text);
+    return true;
+  }
+
+  const std::string type = GetString(message, "type");
+  if (type == "error") {
+    spdlog::error("Market stream error: {}", text);
+    return true;
+  }
+
+  auto msg_iter = message.find("msg");
+  if (msg_iter == message.end() || !msg_iter->is_object()) {
+    return true;
+  }
+  const nlohmann::json &msg = *msg_iter;
+  const std::string ticker = GetString(msg, "market_ticker");
+
+  if (type == "ticker") {
+    if (!handlers_.on_ticker || ticker.empty()) {
+      return true;
+    }
+    TickerUpdate update;
+    update.ticker = ticker;
+    update.yes_bid = GetDouble(msg, "yes_bid");
+    update.yes_ask = GetDouble(msg, "yes_ask");
+    update.last_price = GetDouble(msg, "price");
+    update.volume = GetDouble(msg, "volume");
+    update.ts = static_cast<int64_t>(GetDouble(msg, "ts"));
+    update.raw_json = msg.dump();
+    update.received = received;
+    handlers_.on_ticker(update);
+    return true;
+  }
+
+  if (type != "orderbook_snapshot" && type != "orderbook_delta") {
+    return true;
+  }
+
+  // Orderbook deltas are only meaningful in sequence; a gap means our book is wrong.
+  const int64_t sid = GetInt(message, "sid");
+  const int64_t seq = GetInt(message, "seq");
+  if (type == "orderbook_delta") {
+    auto last = last_seq_.find(sid);
+    if (last != last_seq_.end() && seq != last->second + 1) {
+      ++sequence_gaps_;
+      spdlog::warn("Orderbook sequence gap on sid {} (expected {}, got {}); resyncing", sid, last->second + 1, seq);
+      return false;
+    }
+  }
+  last_seq_[sid] = seq;
+
+  if (type == "orderbook_snapshot") {
+    if (handlers_.on_orderbook_snapshot) {
+      OrderbookSnapshot snapshot;
+      snapshot.ticker = ticker;
+      snapshot.yes = ParseLevels(msg, "yes");
+      snapshot.no = ParseLevels(msg, "no");
+      handlers_.on_orderbook_snapshot(snapshot);
+    }
+  } else if (handlers_.on_orderbook_delta) {
+    OrderbookDelta delta;
+    delta.ticker = ticker;
+    delta.price = static_cast<int>(GetDouble(msg, "price"));
+    delta.delta = static_cast<long>(GetDouble(msg, "delta"));
+    delta.yes_side = GetString(msg, "side", "yes") == "yes";
+    handlers_.on_orderbook_delta(delta);
+  }
+  return true;
+}
+
+}  // namespace kalshi
@@ -0,0 +1,405 @@
+#include "kalshi/mock_feed_server.h"
+
+#include "utils/base64.h"
+
+#include <nlohmann/json.hpp>
+#include <openssl/sha.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <random>
+#include <set>
+#include <string>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace kalshi {
+
+#if defined(_WIN32)
+
+MockFeedServer::MockFeedServer(MockFeedConfig config) : config_(config) {}
+MockFeedServer::~MockFeedServer() = default;
+bool MockFeedServer::Start() {
+  spdlog::error("Mock feed server is not supported on Windows");
+  return false;
+}
+void MockFeedServer::Stop() {}
+void MockFeedServer::AcceptLoop() {}
+void MockFeedServer::Serve(int) {}
+
+#else
+
+namespace {
+
+constexpr char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+bool SendAll(int fd, const std::string &data) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    const ssize_t n = send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    offset += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool RecvExact(int fd, std::string *out, size_t size) {
+  out->resize(size);
+  size_t offset = 0;
+  while (offset < size) {
+    const ssize_t n = recv(fd, &(*out)[offset], size - offset, 0);
+    if (n <= 0) {
+      return false;
+    }
+    offset += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool SendFrame(int fd, const std::string &payload, unsigned char opcode = 0x1) {
+  std::string frame;
+  frame.push_back(static_cast<char>(0x80 | opcode));
+  const size_t size = payload.size();
+  if (size < 126) {
+    frame.push_back(static_cast<char>(size));
+  } else if (size <= 0xFFFF) {
+    frame.push_back(static_cast<char>(126));
+    frame.push_back(static_cast<char>((size >> 8) & 0xFF));
+    frame.push_back(static_cast<char>(size & 0xFF));
+  } else {
+    frame.push_back(static_cast<char>(127));
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      frame.push_back(static_cast<char>((static_cast<uint64_t>(size) >> shift) & 0xFF));
+    }
+  }
+  frame += payload;
+  return SendAll(fd, frame);
+}
+
+// Reads one client frame (clients always mask). Returns false on close or error.
+bool ReadFrame(int fd, unsigned char *opcode, std::string *payload) {
+  std::string header;
+  if (!RecvExact(fd, &header, 2)) {
+    return false;
+  }
+  *opcode = static_cast<unsigned char>(header[0]) & 0x0F;
+  const bool masked = (static_cast<unsigned char>(header[1]) & 0x80) != 0;
+  uint64_t size = static_cast<unsigned char>(header[1]) & 0x7F;
+  std::string extended;
+  if (size == 126) {
+    if (!RecvExact(fd, &extended, 2)) {
+      return false;
+    }
+    size = (static_cast<unsigned char>(extended[0]) << 8) | static_cast<unsigned char>(extended[1]);
+  } else if (size == 127) {
+    if (!RecvExact(fd, &extended, 8)) {
+      return false;
+    }
+    size = 0;
+    for (const char c : extended) {
+      size = (size << 8) | static_cast<unsigned char>(c);
+    }
+  }
+  std::string mask;
+  if (masked && !RecvExact(fd, &mask, 4)) {
+    return false;
+  }
+  if (!RecvExact(fd, payload, static_cast<size_t>(size))) {
+    return false;
+  }
+  if (masked) {
+    for (size_t i = 0; i < payload->size(); ++i) {
+      (*payload)[i] = static_cast<char>((*payload)[i] ^ mask[i % 4]);
+    }
+  }
+  return true;
+}
+
+bool Handshake(int fd) {
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos) {
+    const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0 || request.size() > 16 * 1024) {
+      return false;
+    }
+    request.append(buffer, static_cast<size_t>(n));
+  }
+
+  std::string lower = request;
+  std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+  const std::string header = "sec-websocket-key:";
+  const auto pos = lower.find(header);
+  if (pos == std::string::npos) {
+    return false;
+  }
+  const auto end = request.find("\r\n", pos);
+  std::string key = request.substr(pos + header.size(), end - pos - header.size());
+  key.erase(0, key.find_first_not_of(" \t"));
+  key.erase(key.find_last_not_of(" \t") + 1);
+
+  const std::string accept_source = key + kWebSocketGuid;
+  unsigned char digest[SHA_DIGEST_LENGTH];
+  SHA1(reinterpret_cast<const unsigned char *>(accept_source.data()), accept_source.size(), digest);
+  const std::string accept = utils::Base64Encode(std::string(reinterpret_cast<char *>(digest), sizeof(digest)));
+
+  return SendAll(fd,
+                 "HTTP/1.1 101 Switching Protocols\r\n"
+                 "Upgrade: websocket\r\n"
+                 "Connection: Upgrade\r\n"
+                 "Sec-WebSocket-Accept: " + accept + "\r\n\r\n");
+}
+
+struct MockMarket {
+  std::string ticker;
+  int yes_bid = 45;
+  int volume = 0;
+  long depth[2][100] = {};  // [yes=0/no=1][price]
+};
+
+}  // namespace
+
+MockFeedServer::MockFeedServer(MockFeedConfig config) : config_(config) {}
+
+MockFeedServer::~MockFeedServer() {
+  Stop();
+}
+
+bool MockFeedServer::Start() {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    spdlog::error("Mock feed: socket() failed");
+    return false;
+  }
+  int reuse = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(static_cast<uint16_t>(config_.port));
+  if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listen_fd_, 16) != 0) {
+    spdlog::error("Mock feed: failed to bind port {}", config_.port);
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  socklen_t addr_len = sizeof(addr);
+  getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+  port_ = ntohs(addr.sin_port);
+
+  stop_ = false;
+  acceptor_ = std::thread([this]() { AcceptLoop(); });
+  spdlog::info("Mock feed listening on ws://127.0.0.1:{}", port_);
+  return true;
+}
+
+void MockFeedServer::Stop() {
+  stop_ = true;
+  if (acceptor_.joinable()) {
+    acceptor_.join();
+  }
+  std::vector<std::thread> clients;
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    clients.swap(clients_);
+  }
+  for (auto &client : clients) {
+    client.join();
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+  }
+}
+
+void MockFeedServer::AcceptLoop() {
+  while (!stop_) {
+    pollfd pfd{listen_fd_, POLLIN, 0};
+    if (poll(&pfd, 1, 200) <= 0) {
+      continue;
+    }
+    const int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    clients_.emplace_back([this, fd]() {
+      Serve(fd);
+      close(fd);
+    });
+  }
+}
+
+void MockFeedServer::Serve(int fd) {
+  if (!Handshake(fd)) {
+    return;
+  }
+
+  std::mt19937 rng(static_cast<unsigned>(fd) * 7919u);
+  std::vector<MockMarket> markets(static_cast<size_t>(std::max(config_.markets, 1)));
+  for (size_t i = 0; i < markets.size(); ++i) {
+    markets[i].ticker = "MOCK-" + std::to_string(i);
+    markets[i].yes_bid = 20 + static_cast<int>(rng() % 60);
+    for (int level = 1; level <= 5; ++level) {
+      markets[i].depth[0][markets[i].yes_bid - level + 1] = 100 * level;
+      markets[i].depth[1][100 - markets[i].yes_bid - 2 - level + 1] = 100 * level;
+    }
+  }
+
+  bool ticker_all = false;
+  std::set<std::string> ticker_subs;
+  std::set<std::string> book_subs;
+  const int ticker_sid = 1;
+  const int book_sid = 2;
+  int64_t book_seq = 0;
+  long deltas_sent = 0;
+
+  const auto interval = std::chrono::microseconds(1000000 / std::max(config_.updates_per_second, 1));
+  auto next_tick = std::chrono::steady_clock::now();
+
+  while (!stop_) {
+    const auto now = std::chrono::steady_clock::now();
+    const int wait_ms = static_cast<int>(
+        std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(next_tick - now).count()));
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, wait_ms) > 0) {
+      unsigned char opcode = 0;
+      std::string payload;
+      if (!ReadFrame(fd, &opcode, &payload) || opcode == 0x8) {
+        return;
+      }
+      if (opcode == 0x9) {
+        SendFrame(fd, payload, 0xA);
+        continue;
+      }
+      if (opcode != 0x1) {
+        continue;
+      }
+
+      const auto command = nlohmann::json::parse(payload, nullptr, false);
+      if (!command.is_object() || command.value("cmd", nlohmann::json()) != "subscribe") {
+        continue;
+      }
+      // A malformed subscribe is ignored, like the real feed's error reply would be.
+      std::vector<std::string> tickers;
+      std::vector<std::string> channels;
+      int id = 0;
+      try {
+        id = command.value("id", 0);
+        const nlohmann::json params = command.value("params", nlohmann::json::object());
+        if (params.contains("market_tickers")) {
+          tickers = params["market_tickers"].get<std::vector<std::string>>();
+        }
+        channels = params.value("channels", std::vector<std::string>{});
+      } catch (const nlohmann::json::exception &ex) {
+        spdlog::warn("Mock feed: ignoring malformed subscribe: {}", ex.what());
+        continue;
+      }
+      for (const auto &channel : channels) {
+        if (channel == "ticker") {
+          ticker_all = tickers.empty();
+          ticker_subs.insert(tickers.begin(), tickers.end());
+          SendFrame(fd, nlohmann::json{{"id", id}, {"type", "subscribed"},
+                                       {"msg", {{"channel", "ticker"}, {"sid", ticker_sid}}}}.dump());
+        } else if (channel == "orderbook_delta") {
+          SendFrame(fd, nlohmann::json{{"id", id}, {"type", "subscribed"},
+                                       {"msg", {{"channel", "orderbook_delta"}, {"sid", book_sid}}}}.dump());
+          for (const auto &ticker : tickers) {
+            book_subs.insert(ticker);
+            for (const auto &market : markets) {
+              if (market.ticker != ticker) {
+                continue;
+              }
+              nlohmann::json yes = nlohmann::json::array();
+              nlohmann::json no = nlohmann::json::array();
+              for (int price = 1; price < 100; ++price) {
+                if (market.depth[0][price] > 0) {
+                  yes.push_back({price, market.depth[0][price]});
+                }
+                if (market.depth[1][price] > 0) {
+                  no.push_back({price, market.depth[1][price]});
+                }
+              }
+              SendFrame(fd, nlohmann::json{{"type", "orderbook_snapshot"}, {"sid", book_sid}, {"seq", ++book_seq},
+                                           {"msg", {{"market_ticker", ticker}, {"yes", yes}, {"no", no}}}}.dump());
+            }
+          }
+        }
+      }
+      continue;
+    }
+
+    if (std::chrono::steady_clock::now() < next_tick) {
+      continue;
+    }
+    next_tick += interval;
+
+    MockMarket &market = markets[rng() % markets.size()];
+    const int step = static_cast<int>(rng() % 5) - 2;
+    market.yes_bid = std::min(95, std::max(3, market.yes_bid + step));
+    market.volume += static_cast<int>(rng() % 50);
+
+    if (ticker_all || ticker_subs.count(market.ticker)) {
+      const auto ts = std::chrono::duration_cast<std::chrono::seconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+      nlohmann::json update = {
+          {"type", "ticker"},
+          {"sid", ticker_sid},
+          {"msg",
+           {{"market_ticker", market.ticker},
+            {"price", market.yes_bid + 1},
+            {"yes_bid", market.yes_bid},
+            {"yes_ask", market.yes_bid + 2},
+            {"volume", market.volume},
+            {"ts", ts}}},
+      };
+      if (!SendFrame(fd, update.dump())) {
+        return;
+      }
+    }
+
+    if (book_subs.count(market.ticker)) {
+      const bool yes_side = (rng() & 1) != 0;
+      const int price = yes_side ? market.yes_bid : 100 - market.yes_bid - 2;
+      const long delta = static_cast<long>(rng() % 200) - 100;
+      long &level = market.depth[yes_side ? 0 : 1][std::min(99, std::max(1, price))];
+      const long applied = std::max(-level, delta);
+      level += applied;
+
+      ++book_seq;
+      if (config_.gap_every > 0 && ++deltas_sent % config_.gap_every == 0) {
+        ++book_seq;
+      }
+      nlohmann::json update = {
+          {"type", "orderbook_delta"},
+          {"sid", book_sid},
+          {"seq", book_seq},
+          {"msg",
+           {{"market_ticker", market.ticker},
+            {"price", std::min(99, std::max(1, price))},
+            {"delta", applied},
+            {"side", yes_side ? "yes" : "no"}}},
+      };
+      if (!SendFrame(fd, update.dump())) {
+        return;
+      }
+    }
+  }
+}
+
+#endif
+
+}  // namespace kalshi
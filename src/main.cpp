@@ -1,7 +1,11 @@
 #include "analytics/alert_engine.h"
+#include "bench/benchmarks.h"
 #include "analytics/feature_engine.h"
 #include "kalshi/kalshi_client.h"
+#include "kalshi/market_stream.h"
+#include "kalshi/mock_feed_server.h"
 #include "storage/sqlite_store.h"
+#include "storage/time_series_store.h"
 #include "utils/env.h"
 #include "utils/http_client.h"
 #include "server/http_server.h"
@@ -11,11 +15,28 @@
 #include <curl/curl.h>
 #include <sqlite3.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
+#include <thread>
 
 namespace {
 
+// https://host/trade-api/v2 -> wss://host/trade-api/ws/v2
+std::string DefaultStreamUrl(const std::string &base_url) {
+  std::string url = base_url;
+  if (url.rfind("https://", 0) == 0) {
+    url = "wss://" + url.substr(8);
+  } else if (url.rfind("http://", 0) == 0) {
+    url = "ws://" + url.substr(7);
+  }
+  const std::string rest_suffix = "/trade-api/v2";
+  if (url.size() >= rest_suffix.size() && url.compare(url.size() - rest_suffix.size(), rest_suffix.size(), rest_suffix) == 0) {
+    url = url.substr(0, url.size() - rest_suffix.size()) + "/trade-api/ws/v2";
+  }
+  return url;
+}
+
 bool HasArg(int argc, char **argv, const std::string &flag) {
   for (int i = 1; i < argc; ++i) {
     if (flag == argv[i]) {
@@ -25,6 +46,15 @@ bool HasArg(int argc, char **argv, const std::string &flag) {
   return false;
 }
 
+std::string GetArg(int argc, char **argv, const std::string &flag, const std::string &default_value = "") {
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (flag == argv[i]) {
+      return argv[i + 1];
+    }
+  }
+  return default_value;
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
@@ -45,35 +75,173 @@ int main(int argc, char **argv) {
   config.api_key = utils::GetEnv("KALSHI_API_KEY", "");
   config.private_key_path = utils::GetEnv("KALSHI_PRIVATE_KEY", "");
   config.use_demo = env != "prod";
+  config.requests_per_second = utils::GetEnvDouble("KALSHI_RATE_LIMIT_RPS", 10.0);
+  config.burst = utils::GetEnvDouble("KALSHI_RATE_LIMIT_BURST", config.requests_per_second);
+
+  if (HasArg(argc, argv, "--mock-feed")) {
+    kalshi::MockFeedConfig mock_config;
+    mock_config.port = utils::GetEnvInt("KALSHI_MOCK_FEED_PORT", 9001);
+    mock_config.markets = utils::GetEnvInt("KALSHI_MOCK_FEED_MARKETS", 20);
+    mock_config.updates_per_second = utils::GetEnvInt("KALSHI_MOCK_FEED_RATE", 50);
+    mock_config.gap_every = utils::GetEnvInt("KALSHI_MOCK_FEED_GAP_EVERY", 0);
+    kalshi::MockFeedServer mock(mock_config);
+    if (!mock.Start()) {
+      return 1;
+    }
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+  }
+
+  if (HasArg(argc, argv, "--bench-signer")) {
+    const int threads = std::stoi(GetArg(argc, argv, "--threads", "4"));
+    const int code = bench::RunSignerBenchmark(config.private_key_path, threads, 2.0);
+    curl_global_cleanup();
+    return code;
+  }
+
+  if (HasArg(argc, argv, "--bench-store")) {
+    const int threads = std::stoi(GetArg(argc, argv, "--threads", "4"));
+    const int markets = std::stoi(GetArg(argc, argv, "--markets", "5000"));
+    const int code = bench::RunStoreBenchmark(threads, markets, 3.0);
+    curl_global_cleanup();
+    return code;
+  }
+
+  if (HasArg(argc, argv, "--bench-timeseries")) {
+    const int markets = std::stoi(GetArg(argc, argv, "--markets", "200"));
+    const int rows = std::stoi(GetArg(argc, argv, "--rows", "2000"));
+    const int code = bench::RunTimeSeriesBenchmark(markets, rows);
+    curl_global_cleanup();
+    return code;
+  }
+
+  if (HasArg(argc, argv, "--bench-correlation")) {
+    const int steps = std::stoi(GetArg(argc, argv, "--steps", "500"));
+    const int code = bench::RunCorrelationBenchmark(steps);
+    curl_global_cleanup();
+    return code;
+  }
 
   const std::string db_path = utils::GetEnv("KALSHI_DB_PATH", "data/kalshi.db");
   const int port = utils::GetEnvInt("KALSHI_PORT", 8080);
   const int limit = utils::GetEnvInt("KALSHI_REFRESH_LIMIT", 100);
+  const bool refresh_all = utils::GetEnvBool("KALSHI_REFRESH_ALL", false);
+  const int max_pages = utils::GetEnvInt("KALSHI_REFRESH_MAX_PAGES", 0);
   const double jump_threshold = utils::GetEnvDouble("KALSHI_ALERT_JUMP", 5.0);
   const double spread_threshold = utils::GetEnvDouble("KALSHI_ALERT_SPREAD", 10.0);
+  const double liquidity_threshold = utils::GetEnvDouble("KALSHI_ALERT_LIQUIDITY_DROP", 0.5);
+  const int book_depth = utils::GetEnvInt("KALSHI_BOOK_DEPTH", 5);
+
+  server::HttpServerOptions server_options;
+  server_options.skip_unchanged = utils::GetEnvBool("KALSHI_SKIP_UNCHANGED", true);
+  server_options.refresh.limit = limit;
+  server_options.refresh.all = refresh_all;
+  server_options.refresh.max_pages = max_pages;
+  server_options.refresh_interval_seconds = utils::GetEnvInt("KALSHI_REFRESH_INTERVAL", 0);
+  server_options.compress = utils::GetEnvBool("KALSHI_HTTP_COMPRESS", true);
+  server_options.async_persist = utils::GetEnvBool("KALSHI_PERSIST_ASYNC", true);
+  server_options.persist.capacity = static_cast<size_t>(utils::GetEnvInt("KALSHI_PERSIST_QUEUE", 65536));
+  server_options.persist.max_batch = static_cast<size_t>(utils::GetEnvInt("KALSHI_PERSIST_BATCH", 4096));
+  server_options.persist.policy = storage::ParseBackpressurePolicy(utils::GetEnv("KALSHI_PERSIST_POLICY", "block"));
+  server_options.persist.spill_path = utils::GetEnv("KALSHI_PERSIST_SPILL_PATH", "data/persist.spill");
+  server_options.retention.raw_hours = utils::GetEnvInt("KALSHI_RETAIN_RAW_HOURS", 24);
+  server_options.retention.minute_days = utils::GetEnvInt("KALSHI_RETAIN_1M_DAYS", 7);
+  server_options.retention.five_minute_days = utils::GetEnvInt("KALSHI_RETAIN_5M_DAYS", 90);
+  server_options.retention.hour_days = utils::GetEnvInt("KALSHI_RETAIN_1H_DAYS", 0);
+  server_options.retention.interval_seconds = utils::GetEnvInt("KALSHI_COMPACT_INTERVAL", 300);
+  server_options.compress_min_bytes = static_cast<size_t>(utils::GetEnvInt("KALSHI_HTTP_COMPRESS_MIN_BYTES", 1024));
+  server_options.response_cache_entries = static_cast<size_t>(utils::GetEnvInt("KALSHI_RESPONSE_CACHE_ENTRIES", 1024));
+  server_options.push.max_subscribers = static_cast<size_t>(utils::GetEnvInt("KALSHI_PUSH_MAX_SUBSCRIBERS", 32));
+  server_options.push.buffer_events = static_cast<size_t>(utils::GetEnvInt("KALSHI_PUSH_BUFFER_EVENTS", 1024));
+  server_options.correlation.max_tickers =
+      static_cast<size_t>(utils::GetEnvInt("KALSHI_CORRELATION_MAX_TICKERS", 1024));
+  server_options.correlation.half_life_steps = utils::GetEnvDouble("KALSHI_CORRELATION_HALF_LIFE", 120.0);
+  server_options.warm_start.threads = utils::GetEnvInt("KALSHI_WARM_START_THREADS", 4);
+  server_options.warm_start.max_seconds = utils::GetEnvDouble("KALSHI_WARM_START_SECONDS", 10.0);
+
+  utils::HttpClientOptions http_options;
+  http_options.max_host_connections = utils::GetEnvInt("KALSHI_HTTP_MAX_CONNECTIONS", 8);
+  http_options.http2 = utils::GetEnvBool("KALSHI_HTTP2", true);
+  http_options.compression = utils::GetEnvBool("KALSHI_HTTP_COMPRESS", true);
+  const std::string capture_path = utils::GetEnv("KALSHI_CAPTURE_PATH", "");
+  if (!capture_path.empty()) {
+    try {
+      http_options.capture = std::make_shared<utils::CaptureWriter>(capture_path);
+      spdlog::info("Capturing HTTP responses to {}", capture_path);
+    } catch (const std::exception &ex) {
+      spdlog::error("{}", ex.what());
+    }
+  }
 
-  auto http = std::make_shared<utils::HttpClient>();
+  auto http = std::make_shared<utils::HttpClient>(http_options);
   auto client = std::make_shared<kalshi::KalshiClient>(config, http);
-  auto store = std::make_shared<storage::SQLiteStore>(db_path);
-  auto features = std::make_shared<analytics::FeatureEngine>();
-  auto alerts = std::make_shared<analytics::AlertEngine>(jump_threshold, spread_threshold);
-
+  storage::SQLiteStoreOptions store_options;
+  store_options.wal = utils::GetEnvBool("KALSHI_DB_WAL", true);
+  store_options.read_connections = utils::GetEnvInt("KALSHI_DB_READERS", 4);
+  auto store = std::make_shared<storage::SQLiteStore>(db_path, store_options);
+  // Loads the persisted ticker ids, so it runs before anything else interns a ticker.
   store->Init();
+  std::shared_ptr<storage::TimeSeriesStore> series;
+  const std::string series_dir = utils::GetEnv("KALSHI_TIMESERIES_DIR", "data/timeseries");
+  // A replay re-ingests captured (older) rows, which the series would restamp with its
+  // last time; replayed features go to KALSHI_DB_PATH alone.
+  if (!series_dir.empty() && !HasArg(argc, argv, "--replay")) {
+    storage::TimeSeriesOptions series_options;
+    series_options.segment_rows = static_cast<uint32_t>(utils::GetEnvInt("KALSHI_TIMESERIES_SEGMENT_ROWS", 4096));
+    try {
+      series = std::make_shared<storage::TimeSeriesStore>(series_dir, series_options);
+    } catch (const std::exception &ex) {
+      spdlog::error("{}; feature history will be read from SQLite", ex.what());
+    }
+  }
+  auto features = std::make_shared<analytics::FeatureEngine>(book_depth);
+  auto alerts = std::make_shared<analytics::AlertEngine>(jump_threshold, spread_threshold, liquidity_threshold);
+
+  if (HasArg(argc, argv, "--replay")) {
+    // --replay-speed N replays N times faster than captured; "max" skips pacing.
+    const std::string speed_arg = GetArg(argc, argv, "--replay-speed", "max");
+    const double speed = speed_arg == "max" ? 0.0 : std::stod(speed_arg);
+    server::HttpServer server(client, store, series, features, alerts, server_options);
+    const int code = bench::RunReplay(server, GetArg(argc, argv, "--replay"), speed);
+    curl_global_cleanup();
+    return code;
+  }
 
   if (HasArg(argc, argv, "--once")) {
     spdlog::info("Running one-time refresh");
-    server::HttpServer server(client, store, features, alerts);
-    server.RefreshMarkets(limit);
+    server::HttpServer server(client, store, series, features, alerts, server_options);
+    server.WarmStart();
+    if (refresh_all) {
+      server.RefreshAllMarkets(limit, max_pages);
+    } else {
+      server.RefreshMarkets(limit);
+    }
     curl_global_cleanup();
     return 0;
   }
 
   spdlog::info("Kalshi Risk Desk starting with base URL {}", base_url);
 
-  server::HttpServer server(client, store, features, alerts);
+  server::HttpServer server(client, store, series, features, alerts, server_options);
+  server.WarmStart();
 
   if (utils::GetEnvBool("KALSHI_REFRESH_ON_START", true)) {
-    server.RefreshMarkets(limit);
+    if (refresh_all) {
+      server.RefreshAllMarkets(limit, max_pages);
+    } else {
+      server.RefreshMarkets(limit);
+    }
+  }
+
+  if (utils::GetEnvBool("KALSHI_STREAM", false)) {
+    kalshi::MarketStreamConfig stream_config;
+    stream_config.url = utils::GetEnv("KALSHI_WS_URL", DefaultStreamUrl(base_url));
+    stream_config.tickers = utils::GetEnvList("KALSHI_STREAM_TICKERS");
+    stream_config.orderbook = utils::GetEnvBool("KALSHI_STREAM_ORDERBOOK", true);
+    auto stream = std::make_shared<kalshi::MarketStream>(stream_config, client);
+    server.AttachStream(stream);
+    stream->Start();
   }
 
   server.Run(port);
@@ -1,31 +1,405 @@
 #include "server/http_server.h"
 
+#include "analytics/ticker_registry.h"
+#include "utils/compression.h"
+#include "utils/env.h"
+#include "utils/time.h"
+
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <fstream>
+#include <future>
+#include <limits>
 #include <sstream>
+#include <thread>
 
 namespace server {
 
+namespace {
+
+nlohmann::json JobToJson(const RefreshJob &job) {
+  return {
+      {"id", job.id},
+      {"state", RefreshJob::StateName(job.state)},
+      {"limit", job.request.limit},
+      {"all", job.request.all},
+      {"coalesced_requests", job.coalesced},
+      {"pages", job.stats.pages},
+      {"markets", job.stats.markets},
+      {"skipped", job.stats.skipped},
+      {"seconds", job.stats.seconds},
+      {"pages_per_sec", job.stats.PagesPerSecond()},
+      {"markets_per_sec", job.stats.MarketsPerSecond()},
+      {"error", job.error},
+  };
+}
+
+nlohmann::json PushToJson(const PushStats &stats, const PushOptions &options) {
+  return {
+      {"subscribers", stats.subscribers},
+      {"max_subscribers", options.max_subscribers},
+      {"events_published", stats.published},
+      {"events_delivered", stats.delivered},
+      {"events_dropped", stats.dropped},
+      {"rejected_subscriptions", stats.rejected},
+  };
+}
+
+// Shapes shared by /alerts, /features and the /stream events.
+nlohmann::json AlertToJson(const analytics::Alert &alert) {
+  return {
+      {"ticker", analytics::TickerName(alert.ticker)},
+      {"ts", utils::FormatIso8601Nanos(alert.ts)},
+      {"type", alert.type},
+      {"score", alert.score},
+      {"details", alert.details},
+  };
+}
+
+nlohmann::json FeatureToJson(const analytics::FeatureRow &feature) {
+  return {
+      {"ticker", analytics::TickerName(feature.ticker)},
+      {"ts", utils::FormatIso8601Nanos(feature.ts)},
+      {"mid", feature.mid},
+      {"spread", feature.spread},
+      {"prob", feature.prob},
+      {"volume", feature.volume},
+      {"bid_depth", feature.has_book ? nlohmann::json(feature.bid_depth) : nlohmann::json()},
+      {"ask_depth", feature.has_book ? nlohmann::json(feature.ask_depth) : nlohmann::json()},
+      {"imbalance", feature.has_book ? nlohmann::json(feature.imbalance) : nlohmann::json()},
+      {"microprice", feature.has_book ? nlohmann::json(feature.microprice) : nlohmann::json()},
+  };
+}
+
+// One server-sent event; JSON dumps carry no newlines, so data fits on one line.
+std::string SseFrame(const char *event, const nlohmann::json &data) {
+  std::string frame = "event: ";
+  frame += event;
+  frame += "\ndata: ";
+  frame += data.dump();
+  frame += "\n\n";
+  return frame;
+}
+
+nlohmann::json HistogramToJson(const utils::LatencyHistogram &histogram) {
+  return {
+      {"count", histogram.count()},
+      {"mean_us", histogram.MeanNanos() / 1000.0},
+      {"p50_us", histogram.PercentileNanos(50) / 1000.0},
+      {"p99_us", histogram.PercentileNanos(99) / 1000.0},
+      {"max_us", histogram.max() / 1000.0},
+  };
+}
+
+nlohmann::json PersistToJson(const storage::AsyncWriter &persist) {
+  const auto stats = persist.stats();
+  return {
+      {"mode", "async"},
+      {"policy", storage::BackpressurePolicyName(persist.options().policy)},
+      {"queue_depth", stats.depth},
+      {"capacity", stats.capacity},
+      {"pushed", stats.pushed},
+      {"written", stats.written},
+      {"dropped", stats.dropped},
+      {"spilled", stats.spilled},
+      {"blocked_pushes", stats.blocked},
+      {"drain_latency", HistogramToJson(persist.drain_latency())},
+      {"commit_latency", HistogramToJson(persist.commit_latency())},
+  };
+}
+
+nlohmann::json CompactionToJson(const storage::Compactor &compactor) {
+  const auto stats = compactor.stats();
+  return {
+      {"enabled", true},
+      {"runs", stats.runs},
+      {"rolled_up", stats.rolled_up},
+      {"raw_deleted", stats.raw_deleted},
+      {"series_rows_deleted", stats.series_rows_deleted},
+      {"bars_deleted", stats.bars_deleted},
+      {"payloads_deleted", stats.payloads_deleted},
+      {"last_run_seconds", stats.last_run_seconds},
+  };
+}
+
+nlohmann::json TimeSeriesToJson(const storage::TimeSeriesStore &series) {
+  const auto stats = series.stats();
+  return {
+      {"enabled", true},
+      {"series", stats.series},
+      {"segments", stats.segments},
+      {"rows", stats.rows},
+      {"disk_bytes", stats.disk_bytes},
+      {"failed_appends", stats.failed_appends},
+      {"invalid_segments", stats.invalid_segments},
+      {"expired_segments", stats.expired_segments},
+  };
+}
+
+// Longest span= a request may ask for; keeps span * kNanosPerSecond well inside int64.
+constexpr int64_t kMaxSpanSeconds = int64_t{10} * 366 * 86400;
+
+// Seconds, optionally suffixed with s, m, h or d. Returns 0 when malformed or longer
+// than kMaxSpanSeconds.
+int64_t ParseSpanSeconds(const std::string &text) {
+  size_t used = 0;
+  int64_t value = 0;
+  try {
+    value = std::stoll(text, &used);
+  } catch (const std::exception &) {
+    return 0;
+  }
+  const std::string unit = text.substr(used);
+  int64_t scale = 0;
+  if (unit.empty() || unit == "s") {
+    scale = 1;
+  } else if (unit == "m") {
+    scale = 60;
+  } else if (unit == "h") {
+    scale = 3600;
+  } else if (unit == "d") {
+    scale = 86400;
+  }
+  if (scale == 0 || value > kMaxSpanSeconds / scale) {
+    return 0;
+  }
+  return value * scale;
+}
+
+// Tickers one /features?tickers= request may ask for.
+constexpr size_t kMaxBatchTickers = 256;
+
+// Puts the rows of several tickers (grouped by ticker, newest first) on one time axis:
+// the union of their timestamps, oldest first and cut to the newest limit. Each
+// ticker's series holds its latest value as of each timestamp, null before its first
+// row, so series can be compared index by index.
+nlohmann::json AlignFeatures(const std::vector<std::string> &names, const std::vector<analytics::TickerId> &ids,
+                             const std::vector<analytics::FeatureRow> &rows, int limit) {
+  std::vector<int64_t> axis;
+  axis.reserve(rows.size());
+  for (const auto &row : rows) {
+    axis.push_back(row.ts);
+  }
+  std::sort(axis.begin(), axis.end());
+  axis.erase(std::unique(axis.begin(), axis.end()), axis.end());
+  if (limit > 0 && axis.size() > static_cast<size_t>(limit)) {
+    axis.erase(axis.begin(), axis.end() - limit);
+  }
+
+  // [first, last) of each ticker's rows.
+  std::unordered_map<analytics::TickerId, std::pair<size_t, size_t>> ranges;
+  for (size_t begin = 0; begin < rows.size();) {
+    size_t end = begin + 1;
+    while (end < rows.size() && rows[end].ticker == rows[begin].ticker) {
+      ++end;
+    }
+    ranges[rows[begin].ticker] = {begin, end};
+    begin = end;
+  }
+
+  nlohmann::json ts = nlohmann::json::array();
+  for (const int64_t nanos : axis) {
+    ts.push_back(utils::FormatIso8601Nanos(nanos));
+  }
+  nlohmann::json series = nlohmann::json::object();
+  for (size_t i = 0; i < names.size(); ++i) {
+    nlohmann::json mid = nlohmann::json::array();
+    nlohmann::json spread = nlohmann::json::array();
+    nlohmann::json prob = nlohmann::json::array();
+    nlohmann::json volume = nlohmann::json::array();
+    const auto range = ranges.find(ids[i]);
+    // Walks the ticker's rows oldest first alongside the axis.
+    size_t next = range != ranges.end() ? range->second.second : 0;
+    const size_t first = range != ranges.end() ? range->second.first : 0;
+    const analytics::FeatureRow *current = nullptr;
+    for (const int64_t nanos : axis) {
+      while (next > first && rows[next - 1].ts <= nanos) {
+        current = &rows[--next];
+      }
+      mid.push_back(current ? nlohmann::json(current->mid) : nlohmann::json());
+      spread.push_back(current ? nlohmann::json(current->spread) : nlohmann::json());
+      prob.push_back(current ? nlohmann::json(current->prob) : nlohmann::json());
+      volume.push_back(current ? nlohmann::json(current->volume) : nlohmann::json());
+    }
+    series[names[i]] = {{"mid", std::move(mid)}, {"spread", std::move(spread)}, {"prob", std::move(prob)},
+                        {"volume", std::move(volume)}};
+  }
+  return {{"tickers", names}, {"ts", std::move(ts)}, {"series", std::move(series)}};
+}
+
+// Tickers one /correlations response may cover; about 8 MB of JSON at the cap.
+constexpr size_t kMaxCorrelationTickers = 1024;
+
+// Rows of the matrix, rounded to 4 places, with null for undefined pairs.
+nlohmann::json CorrelationToJson(const analytics::CorrelationMatrix &matrix, const analytics::CorrelationOptions &options) {
+  const size_t count = matrix.tickers.size();
+  nlohmann::json tickers = nlohmann::json::array();
+  for (const analytics::TickerId ticker : matrix.tickers) {
+    tickers.push_back(analytics::TickerName(ticker));
+  }
+  nlohmann::json untracked = nlohmann::json::array();
+  for (const analytics::TickerId ticker : matrix.untracked) {
+    untracked.push_back(analytics::TickerName(ticker));
+  }
+  nlohmann::json rows = nlohmann::json::array();
+  for (size_t i = 0; i < count; ++i) {
+    nlohmann::json row = nlohmann::json::array();
+    for (size_t j = 0; j < count; ++j) {
+      const double r = matrix.values[i * count + j];
+      row.push_back(std::isnan(r) ? nlohmann::json() : nlohmann::json(std::round(r * 1e4) / 1e4));
+    }
+    rows.push_back(std::move(row));
+  }
+  return {
+      {"tickers", std::move(tickers)},
+      {"untracked", std::move(untracked)},
+      {"matrix", std::move(rows)},
+      {"steps", matrix.steps},
+      {"half_life_steps", options.half_life_steps},
+  };
+}
+
+nlohmann::json CorrelationStatsToJson(const analytics::CorrelationStats &stats,
+                                      const analytics::CorrelationOptions &options) {
+  return {
+      {"tracked", stats.tracked},
+      {"max_tickers", options.max_tickers},
+      {"steps", stats.steps},
+      {"admitted", stats.admitted},
+      {"evicted", stats.evicted},
+      {"not_tracked", stats.not_tracked},
+      {"last_step_ms", stats.last_step_seconds * 1000},
+      {"kernels", stats.kernels},
+  };
+}
+
+// Top of book, depth at N and imbalance; what a book update must move to be stored.
+bool SameBookFeatures(const analytics::FeatureRow &a, const analytics::FeatureRow &b) {
+  return a.mid == b.mid && a.spread == b.spread && a.bid_depth == b.bid_depth && a.ask_depth == b.ask_depth &&
+         a.imbalance == b.imbalance;
+}
+
+uint64_t NanosSince(std::chrono::steady_clock::time_point start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+nlohmann::json ResponseCacheToJson(const ResponseCacheStats &stats, size_t capacity) {
+  return {
+      {"enabled", capacity > 0},
+      {"entries", stats.entries},
+      {"capacity", capacity},
+      {"hits", stats.hits},
+      {"misses", stats.misses},
+      {"hit_ratio", stats.HitRatio()},
+      {"not_modified", stats.not_modified},
+      {"bytes_saved", stats.bytes_saved},
+  };
+}
+
+// The charset parameter keeps httplib's own (exact-match) compression from re-encoding
+// a body we already compressed.
+constexpr char kJsonContentType[] = "application/json; charset=utf-8";
+
+// Path, query parameters (httplib keeps them sorted by name), response encoding and
+// whatever else the handler resolved that the URL does not pin down.
+std::string CacheKey(const httplib::Request &req, utils::ContentEncoding encoding, std::string_view variant) {
+  std::string key = req.path;
+  char separator = '?';
+  for (const auto &param : req.params) {
+    key.push_back(separator);
+    key += param.first;
+    key.push_back('=');
+    key += param.second;
+    separator = '&';
+  }
+  key.push_back('#');
+  key += utils::EncodingName(encoding);
+  if (!variant.empty()) {
+    key.push_back('#');
+    key += variant;
+  }
+  return key;
+}
+
+// Ticker ids per warm-start query; also bounds how far past its deadline a worker runs.
+constexpr analytics::TickerId kWarmStartChunk = 1024;
+
+}  // namespace
+
 HttpServer::HttpServer(std::shared_ptr<kalshi::KalshiClient> client,
                        std::shared_ptr<storage::SQLiteStore> store,
+                       std::shared_ptr<storage::TimeSeriesStore> series,
                        std::shared_ptr<analytics::FeatureEngine> features,
-                       std::shared_ptr<analytics::AlertEngine> alerts)
+                       std::shared_ptr<analytics::AlertEngine> alerts,
+                       HttpServerOptions options)
     : client_(std::move(client)),
       store_(std::move(store)),
+      series_(std::move(series)),
       features_(std::move(features)),
-      alerts_(std::move(alerts)) {
+      alerts_(std::move(alerts)),
+      options_(options),
+      response_cache_(options_.response_cache_entries),
+      push_(options_.push),
+      correlations_(options_.correlation) {
+  if (options_.async_persist) {
+    persist_ = std::make_unique<storage::AsyncWriter>(store_, options_.persist);
+    persist_->Start();
+  }
+  if (options_.retention.interval_seconds > 0) {
+    compactor_ = std::make_unique<storage::Compactor>(store_, series_, options_.retention);
+    compactor_->Start();
+  }
+  const analytics::TickerId max_id = analytics::TickerRegistry::Global().max_id();
+  if (max_id != analytics::kNoTicker) {
+    market_table_.Load(store_->MarketsByTicker(1, max_id));
+  }
+  scheduler_ = std::make_unique<RefreshScheduler>(
+      [this](const RefreshRequest &request) {
+        return request.all ? RefreshAllMarkets(request.limit, request.max_pages) : RefreshMarkets(request.limit);
+      },
+      options_.refresh_interval_seconds, options_.refresh);
+  // Every /stream client holds a worker for as long as it is connected; they get
+  // workers of their own so request handling keeps its usual pool.
+  const size_t workers = CPPHTTPLIB_THREAD_POOL_COUNT + options_.push.max_subscribers;
+  server_.new_task_queue = [workers] { return new httplib::ThreadPool(workers); };
   RegisterRoutes();
 }
 
+HttpServer::~HttpServer() {
+  push_.Close();
+  // Both threads call back into this object.
+  if (stream_) {
+    stream_->Stop();
+  }
+  scheduler_->Stop();
+  if (compactor_) {
+    compactor_->Stop();
+  }
+  // Last, so everything the threads above ingested is drained to SQLite.
+  if (persist_) {
+    persist_->Stop();
+  }
+}
+
 void HttpServer::Run(int port) {
+  scheduler_->Start();
   spdlog::info("Starting HTTP server on port {}", port);
   if (!server_.listen("0.0.0.0", port)) {
     spdlog::error("HTTP server failed to bind to port {}", port);
   }
 }
 
+void HttpServer::Stop() {
+  // Ends the /stream responses, which would otherwise hold their workers open.
+  push_.Close();
+  server_.stop();
+}
+
 void HttpServer::RegisterRoutes() {
   auto serve_file = [](const std::string &path, const std::string &content_type, httplib::Response &res) {
     std::ifstream file(path, std::ios::binary);
@@ -65,22 +439,26 @@ void HttpServer::RegisterRoutes() {
       search = req.get_param_value("search");
     }
 
-    const auto markets = store_->ListMarkets(limit, search);
-    nlohmann::json out = nlohmann::json::array();
-    for (const auto &market : markets) {
-      out.push_back({
-          {"ticker", market.ticker},
-          {"event_ticker", market.event_ticker},
-          {"status", market.status},
-          {"category", market.category},
-          {"yes_bid", market.yes_bid},
-          {"yes_ask", market.yes_ask},
-          {"last_price", market.last_price},
-          {"volume", market.volume},
-          {"updated_at", market.updated_at},
-      });
-    }
-    res.set_content(out.dump(2), "application/json");
+    SendCached(req, res, DataDomain::kMarkets, [&] {
+      // Served from memory; the view stays valid (and unchanged) while we hold it.
+      const std::shared_ptr<const MarketView> view = market_table_.Current();
+      nlohmann::json out = nlohmann::json::array();
+      for (const MarketRow *row : view->Markets(limit, search)) {
+        const analytics::MarketSnapshot &market = row->snapshot;
+        out.push_back({
+            {"ticker", row->ticker},
+            {"event_ticker", market.event_ticker},
+            {"status", market.status},
+            {"category", market.category},
+            {"yes_bid", market.yes_bid},
+            {"yes_ask", market.yes_ask},
+            {"last_price", market.last_price},
+            {"volume", market.volume},
+            {"updated_at", utils::FormatIso8601Nanos(market.updated_at)},
+        });
+      }
+      return out;
+    });
   });
 
   server_.Get("/events", [this](const httplib::Request &req, httplib::Response &res) {
@@ -93,29 +471,219 @@ void HttpServer::RegisterRoutes() {
       search = req.get_param_value("search");
     }
 
-    const auto events = store_->ListEvents(limit, search);
-    nlohmann::json out = nlohmann::json::array();
-    for (const auto &event : events) {
-      out.push_back({
-          {"event_ticker", event.event_ticker},
-          {"category", event.category},
-          {"market_count", event.market_count},
-          {"total_volume", event.total_volume},
-          {"updated_at", event.updated_at},
-      });
-    }
-    res.set_content(out.dump(2), "application/json");
+    SendCached(req, res, DataDomain::kMarkets, [&] {
+      const std::shared_ptr<const MarketView> view = market_table_.Current();
+      nlohmann::json out = nlohmann::json::array();
+      for (const analytics::EventSummary *summary : view->Events(limit, search)) {
+        const analytics::EventSummary &event = *summary;
+        out.push_back({
+            {"event_ticker", event.event_ticker},
+            {"category", event.category},
+            {"market_count", event.market_count},
+            {"total_volume", event.total_volume},
+            {"updated_at", utils::FormatIso8601Nanos(event.updated_at)},
+        });
+      }
+      return out;
+    });
   });
 
   server_.Post("/markets/refresh", [this](const httplib::Request &req, httplib::Response &res) {
-    int limit = 100;
+    RefreshRequest request;
     if (req.has_param("limit")) {
-      limit = std::stoi(req.get_param_value("limit"));
+      request.limit = std::stoi(req.get_param_value("limit"));
+    }
+    request.all = req.has_param("all") && req.get_param_value("all") == "true";
+    if (req.has_param("max_pages")) {
+      request.max_pages = std::stoi(req.get_param_value("max_pages"));
+    }
+
+    bool coalesced = false;
+    const uint64_t id = scheduler_->Submit(request, &coalesced);
+
+    // wait=true keeps the old synchronous behaviour for scripts.
+    if (req.has_param("wait") && req.get_param_value("wait") == "true") {
+      const auto job = scheduler_->Wait(id, std::chrono::minutes(5));
+      nlohmann::json out = job ? JobToJson(*job) : nlohmann::json{{"id", id}};
+      out["coalesced"] = coalesced;
+      SendJson(req, res, out);
+      return;
+    }
+
+    const auto job = scheduler_->Job(id);
+    nlohmann::json out = job ? JobToJson(*job) : nlohmann::json{{"id", id}};
+    out["coalesced"] = coalesced;
+    res.status = 202;
+    SendJson(req, res, out);
+  });
+
+  server_.Get(R"(/markets/refresh/(\d+))", [this](const httplib::Request &req, httplib::Response &res) {
+    const auto job = scheduler_->Job(std::stoull(req.matches[1]));
+    if (!job) {
+      res.status = 404;
+      res.set_content("unknown job", "text/plain");
+      return;
+    }
+    SendJson(req, res, JobToJson(*job));
+  });
+
+  // The stored /markets entry, decompressed only here on demand.
+  server_.Get(R"(/markets/([A-Za-z0-9_.-]+)/raw)", [this](const httplib::Request &req, httplib::Response &res) {
+    std::string json;
+    const analytics::TickerId ticker = analytics::TickerRegistry::Global().Find(req.matches[1].str());
+    if (ticker == analytics::kNoTicker || !store_->MarketPayload(ticker, &json)) {
+      res.status = 404;
+      res.set_content("unknown market", "text/plain");
+      return;
+    }
+    SendBody(req, res, std::move(json));
+  });
+
+  // Server-sent events: "feature" for each new feature row of the tickers in
+  // ?tickers=A,B (or * for all), "alert" for each new alert of the types in
+  // ?alert_types=a,b (all by default, none with alert_types=none), and "lagged" when the
+  // client fell behind and lost events, so it should reload over REST.
+  server_.Get("/stream", [this](const httplib::Request &req, httplib::Response &res) {
+    PushFilter filter;
+    for (std::string &ticker : utils::SplitList(req.get_param_value("tickers"))) {
+      if (ticker == "*") {
+        filter.every_ticker = true;
+      } else {
+        filter.tickers.insert(std::move(ticker));
+      }
+    }
+    if (req.has_param("alert_types")) {
+      filter.every_alert_type = false;
+      for (std::string &type : utils::SplitList(req.get_param_value("alert_types"))) {
+        if (type == "*") {
+          filter.every_alert_type = true;
+        } else if (type != "none") {
+          filter.alert_types.insert(std::move(type));
+        }
+      }
+    }
+
+    std::shared_ptr<PushSubscriber> subscriber = push_.Subscribe(std::move(filter));
+    if (!subscriber) {
+      res.status = 503;
+      res.set_header("Retry-After", "5");
+      res.set_content("too many stream subscribers", "text/plain");
+      return;
     }
+    res.set_header("Cache-Control", "no-cache");
+    // Stops nginx-style proxies from buffering the stream.
+    res.set_header("X-Accel-Buffering", "no");
+    const std::chrono::milliseconds heartbeat(std::max(1, options_.push.heartbeat_seconds) * 1000);
+    std::vector<std::shared_ptr<const std::string>> frames;
+    res.set_chunked_content_provider(
+        "text/event-stream",
+        [subscriber, heartbeat, frames](size_t, httplib::DataSink &sink) mutable {
+          uint64_t dropped = 0;
+          frames.clear();
+          if (!subscriber->Next(heartbeat, &frames, &dropped)) {
+            sink.done();
+            return true;
+          }
+          if (dropped > 0) {
+            const std::string lagged = SseFrame("lagged", {{"dropped", dropped}});
+            if (!sink.write(lagged.data(), lagged.size())) {
+              return false;
+            }
+          }
+          if (frames.empty() && dropped == 0) {
+            static const char kHeartbeat[] = ": keep-alive\n\n";
+            return sink.write(kHeartbeat, sizeof(kHeartbeat) - 1);
+          }
+          for (const auto &frame : frames) {
+            if (!sink.write(frame->data(), frame->size())) {
+              return false;
+            }
+          }
+          return true;
+        },
+        [this, subscriber](bool) { push_.Unsubscribe(subscriber); });
+  });
 
-    RefreshMarkets(limit);
-    nlohmann::json out = { {"status", "ok"}, {"limit", limit} };
-    res.set_content(out.dump(2), "application/json");
+  server_.Get("/metrics", [this](const httplib::Request &req, httplib::Response &res) {
+    const std::shared_ptr<const MarketView> view = market_table_.Current();
+    nlohmann::json out = {
+        {"ingest",
+         {
+             {"processed", changes_.processed()},
+             {"skipped", changes_.skipped()},
+             {"tracked_markets", changes_.tracked()},
+         }},
+        {"pipeline",
+         {
+             {"parse", HistogramToJson(pipeline_.parse)},
+             {"detect", HistogramToJson(pipeline_.detect)},
+             {"features", HistogramToJson(pipeline_.features)},
+             {"alerts", HistogramToJson(pipeline_.alerts)},
+             {"store", HistogramToJson(pipeline_.store)},
+             {"publish", HistogramToJson(pipeline_.publish)},
+             {"ingest", HistogramToJson(pipeline_.ingest)},
+         }},
+        {"kalshi",
+         {
+             {"rate_limit_waits", client_->limiter().waits()},
+             {"rate_limit_backoffs", client_->limiter().backoffs()},
+             {"wire_bytes", client_->http().wire_bytes()},
+             {"decoded_bytes", client_->http().decoded_bytes()},
+             {"bytes_saved", client_->http().decoded_bytes() - std::min(client_->http().decoded_bytes(),
+                                                                       client_->http().wire_bytes())},
+         }},
+        {"store",
+         {
+             {"rows_written", store_->write_totals().rows},
+             {"rows_per_sec", store_->write_totals().RowsPerSecond()},
+             {"search_index", store_->has_search_index()},
+             {"payloads_stored", store_->payload_stats().stored},
+             {"payloads_deduplicated", store_->payload_stats().deduplicated},
+             {"payload_raw_bytes", store_->payload_stats().raw_bytes},
+             {"payload_stored_bytes", store_->payload_stats().stored_bytes},
+         }},
+        {"read_model",
+         {
+             {"generation", view->generation()},
+             {"markets", view->market_count()},
+             {"events", view->event_count()},
+         }},
+        {"persist",
+         persist_ ? PersistToJson(*persist_) : nlohmann::json{{"mode", "sync"}}},
+        {"compaction", compactor_ ? CompactionToJson(*compactor_) : nlohmann::json{{"enabled", false}}},
+        {"timeseries", series_ ? TimeSeriesToJson(*series_) : nlohmann::json{{"enabled", false}}},
+        {"warm_start",
+         {
+             {"ready_ms", warm_start_.seconds * 1000},
+             {"features_restored", warm_start_.features},
+             {"markets_restored", warm_start_.markets},
+             {"complete", warm_start_.complete},
+         }},
+        {"responses",
+         {
+             {"json_bytes", json_bytes_.load()},
+             {"sent_bytes", sent_bytes_.load()},
+             {"bytes_saved", json_bytes_.load() - std::min(json_bytes_.load(), sent_bytes_.load())},
+             {"compressed", compressed_responses_.load()},
+         }},
+        {"response_cache", ResponseCacheToJson(response_cache_.stats(), options_.response_cache_entries)},
+        {"push", PushToJson(push_.stats(), push_.options())},
+        {"correlation", CorrelationStatsToJson(correlations_.stats(), correlations_.options())},
+    };
+    if (stream_) {
+      const auto stats = stream_->stats();
+      const uint64_t updates = stream_updates_.load();
+      out["stream"] = {
+          {"connected", stats.connected},
+          {"messages", stats.messages},
+          {"connects", stats.connects},
+          {"sequence_gaps", stats.sequence_gaps},
+          {"ticker_updates", updates},
+          {"avg_ingest_latency_ms", updates > 0 ? stream_latency_total_us_.load() / 1000.0 / updates : 0.0},
+          {"max_ingest_latency_ms", stream_latency_max_us_.load() / 1000.0},
+      };
+    }
+    SendJson(req, res, out);
   });
 
   server_.Get("/alerts", [this](const httplib::Request &req, httplib::Response &res) {
@@ -124,80 +692,737 @@ void HttpServer::RegisterRoutes() {
       limit = std::stoi(req.get_param_value("limit"));
     }
 
-    const auto alerts = store_->RecentAlerts(limit);
-    nlohmann::json out = nlohmann::json::array();
-    for (const auto &alert : alerts) {
-      out.push_back({
-          {"ticker", alert.ticker},
-          {"ts", alert.ts},
-          {"type", alert.type},
-          {"score", alert.score},
-          {"details", alert.details},
-      });
+    SendCached(req, res, DataDomain::kAlerts, [&] {
+      const auto alerts = store_->RecentAlerts(limit);
+      nlohmann::json out = nlohmann::json::array();
+      for (const auto &alert : alerts) {
+        out.push_back(AlertToJson(alert));
+      }
+      return out;
+    });
+  });
+
+  server_.Get("/features", [this](const httplib::Request &req, httplib::Response &res) {
+    std::vector<std::string> names;
+    for (std::string &name : utils::SplitList(req.get_param_value("tickers"))) {
+      if (std::find(names.begin(), names.end(), name) == names.end()) {
+        names.push_back(std::move(name));
+      }
+    }
+    if (names.empty() || names.size() > kMaxBatchTickers) {
+      res.status = 400;
+      SendJson(req, res, {{"error", "tickers must list 1 to " + std::to_string(kMaxBatchTickers) + " tickers"}});
+      return;
+    }
+    int limit = 50;
+    if (req.has_param("limit")) {
+      limit = std::stoi(req.get_param_value("limit"));
+    }
+
+    SendCached(req, res, DataDomain::kFeatures, [&] {
+      std::vector<analytics::TickerId> ids;
+      std::vector<analytics::TickerId> known;
+      for (const std::string &name : names) {
+        ids.push_back(analytics::TickerRegistry::Global().Find(name));
+        if (ids.back() != analytics::kNoTicker) {
+          known.push_back(ids.back());
+        }
+      }
+      std::vector<analytics::FeatureRow> rows;
+      if (series_) {
+        for (const analytics::TickerId ticker : known) {
+          const auto latest = RawFeatures(ticker, std::numeric_limits<int64_t>::min(),
+                                          std::numeric_limits<int64_t>::max(), limit);
+          rows.insert(rows.end(), latest.begin(), latest.end());
+        }
+      } else {
+        rows = store_->LatestFeatures(known, limit);
+      }
+      return AlignFeatures(names, ids, rows, limit);
+    });
+  });
+
+  server_.Get("/correlations", [this](const httplib::Request &req, httplib::Response &res) {
+    std::vector<std::string> names;
+    for (std::string &name : utils::SplitList(req.get_param_value("tickers"))) {
+      if (std::find(names.begin(), names.end(), name) == names.end()) {
+        names.push_back(std::move(name));
+      }
+    }
+    const std::string event = req.get_param_value("event");
+    const std::string category = req.get_param_value("category");
+    if (names.empty() == (event.empty() && category.empty())) {
+      res.status = 400;
+      SendJson(req, res, {{"error", "give either tickers or event/category"}});
+      return;
+    }
+    if (names.size() > kMaxCorrelationTickers) {
+      res.status = 400;
+      SendJson(req, res,
+               {{"error", "tickers must list at most " + std::to_string(kMaxCorrelationTickers) + " tickers"}});
+      return;
     }
 
-    res.set_content(out.dump(2), "application/json");
+    SendCached(req, res, DataDomain::kCorrelations, [&] {
+      std::vector<analytics::TickerId> ids;
+      std::vector<std::string> unknown;
+      bool truncated = false;
+      if (!names.empty()) {
+        for (const std::string &name : names) {
+          const analytics::TickerId id = analytics::TickerRegistry::Global().Find(name);
+          if (id != analytics::kNoTicker) {
+            ids.push_back(id);
+          } else {
+            unknown.push_back(name);
+          }
+        }
+      } else {
+        // The most recently updated members first, so a cut keeps the live ones.
+        const std::shared_ptr<const MarketView> view = market_table_.Current();
+        for (const MarketRow *row : view->Markets(-1, !event.empty() ? event : category)) {
+          const analytics::MarketSnapshot &market = row->snapshot;
+          if ((!event.empty() && market.event_ticker != event) || (!category.empty() && market.category != category)) {
+            continue;
+          }
+          if (ids.size() == kMaxCorrelationTickers) {
+            truncated = true;
+            break;
+          }
+          ids.push_back(market.ticker);
+        }
+      }
+      nlohmann::json out = CorrelationToJson(correlations_.Correlations(ids), correlations_.options());
+      for (std::string &name : unknown) {
+        out["untracked"].push_back(std::move(name));
+      }
+      out["truncated"] = truncated;
+      return out;
+    });
   });
 
   server_.Get(R"(/features/([A-Za-z0-9_-]+))", [this](const httplib::Request &req, httplib::Response &res) {
-    const std::string ticker = req.matches[1];
+    // An unknown ticker has no rows anywhere, so kNoTicker simply yields an empty array.
+    const analytics::TickerId ticker = analytics::TickerRegistry::Global().Find(req.matches[1].str());
     int limit = 50;
     if (req.has_param("limit")) {
       limit = std::stoi(req.get_param_value("limit"));
     }
 
-    const auto features = store_->LatestFeatures(ticker, limit);
-    nlohmann::json out = nlohmann::json::array();
-    for (const auto &feature : features) {
-      out.push_back({
-          {"ticker", feature.ticker},
-          {"ts", feature.ts},
-          {"mid", feature.mid},
-          {"spread", feature.spread},
-          {"prob", feature.prob},
-          {"volume", feature.volume},
-      });
+    storage::Resolution resolution = storage::Resolution::kAuto;
+    if (req.has_param("resolution") && !storage::ParseResolution(req.get_param_value("resolution"), &resolution)) {
+      res.status = 400;
+      SendJson(req, res, {{"error", "resolution must be auto, raw, 1m, 5m or 1h"}});
+      return;
     }
 
-    res.set_content(out.dump(2), "application/json");
+    // An ISO-8601 from/to window (either end may be left open), or the trailing span.
+    const bool windowed = req.has_param("from") || req.has_param("to") || req.has_param("span");
+    const std::string from = req.get_param_value("from");
+    const std::string to = req.get_param_value("to");
+    int64_t from_nanos = std::numeric_limits<int64_t>::min();
+    int64_t to_nanos = std::numeric_limits<int64_t>::max();
+    if ((!from.empty() && !utils::ParseIso8601(from, &from_nanos)) ||
+        (!to.empty() && !utils::ParseIso8601(to, &to_nanos))) {
+      res.status = 400;
+      SendJson(req, res, {{"error", "from/to must be ISO-8601 timestamps"}});
+      return;
+    }
+    if (req.has_param("span")) {
+      const int64_t span = ParseSpanSeconds(req.get_param_value("span"));
+      if (span <= 0) {
+        res.status = 400;
+        SendJson(req, res, {{"error", "span must be a duration of at most 10 years, such as 3600, 90m, 12h or 7d"}});
+        return;
+      }
+      to_nanos = std::min(to_nanos, utils::NowNanos());
+      const int64_t span_nanos = span * utils::kNanosPerSecond;
+      if (to_nanos >= std::numeric_limits<int64_t>::min() + span_nanos) {
+        from_nanos = std::max(from_nanos, to_nanos - span_nanos);
+      }
+    }
+
+    if (resolution == storage::Resolution::kAuto) {
+      // Without a window this is the classic "latest N raw rows" query.
+      const int64_t span_seconds =
+          from_nanos == std::numeric_limits<int64_t>::min()
+              ? std::numeric_limits<int64_t>::max()
+              : (std::min(to_nanos, utils::NowNanos()) - from_nanos) / utils::kNanosPerSecond;
+      resolution = windowed ? storage::ChooseResolution(options_.retention, span_seconds, limit)
+                            : storage::Resolution::kRaw;
+    }
+    res.set_header("X-Resolution", storage::ResolutionName(resolution));
+
+    auto build = [&] {
+      if (resolution != storage::Resolution::kRaw) {
+        const auto bars = store_->FeatureHistory(ticker, resolution, from_nanos, to_nanos, limit);
+        nlohmann::json out = nlohmann::json::array();
+        for (const auto &bar : bars) {
+          out.push_back({
+              {"ticker", analytics::TickerName(bar.ticker)},
+              {"ts", utils::FormatIso8601Nanos(bar.ts)},
+              {"resolution", storage::ResolutionName(resolution)},
+              {"open", bar.open},
+              {"high", bar.high},
+              {"low", bar.low},
+              {"close", bar.close},
+              {"mid", bar.close},
+              {"spread", bar.spread},
+              {"prob", bar.prob},
+              {"volume", bar.volume},
+              {"volume_delta", bar.volume_delta},
+              {"samples", bar.samples},
+          });
+        }
+        return out;
+      }
+
+      std::vector<analytics::FeatureRow> features;
+      if (windowed) {
+        features = RawFeatures(ticker, from_nanos, to_nanos, limit);
+      } else {
+        features = series_ ? RawFeatures(ticker, std::numeric_limits<int64_t>::min(),
+                                         std::numeric_limits<int64_t>::max(), limit)
+                           : store_->LatestFeatures(ticker, limit);
+      }
+      nlohmann::json out = nlohmann::json::array();
+      for (const auto &feature : features) {
+        out.push_back(FeatureToJson(feature));
+      }
+      return out;
+    };
+    // A span slides with the clock, so the same URL means a different window each time.
+    if (req.has_param("span")) {
+      SendJson(req, res, build());
+    } else {
+      // auto may resolve to another tier as an open-ended window ages.
+      SendCached(req, res, DataDomain::kFeatures, build, storage::ResolutionName(resolution));
+    }
   });
 }
 
-void HttpServer::RefreshMarkets(int limit) {
-  auto response = client_->GetMarkets(limit);
-  if (response.is_null()) {
-    spdlog::warn("Empty response from markets");
+void HttpServer::SendJson(const httplib::Request &req, httplib::Response &res, const nlohmann::json &body) {
+  SendBody(req, res, body.dump());
+}
+
+void HttpServer::SendBody(const httplib::Request &req, httplib::Response &res, std::string json) {
+  Send(res, Encode(req, std::move(json)));
+}
+
+void HttpServer::SendCached(const httplib::Request &req, httplib::Response &res, DataDomain domain,
+                            const std::function<nlohmann::json()> &build, std::string_view variant) {
+  if (options_.response_cache_entries == 0) {
+    SendJson(req, res, build());
+    return;
+  }
+  // Read before building, so a body may be newer than the generation it is filed
+  // under (and is rebuilt once more) but never older.
+  const uint64_t generation = DataGeneration(domain);
+  const utils::ContentEncoding encoding =
+      options_.compress ? utils::NegotiateEncoding(req.get_header_value("Accept-Encoding"))
+                        : utils::ContentEncoding::kIdentity;
+  const std::string key = CacheKey(req, encoding, variant);
+  std::shared_ptr<const CachedResponse> response = response_cache_.Find(key, generation);
+  if (!response) {
+    response = std::make_shared<const CachedResponse>(Encode(req, build().dump()));
+    response_cache_.Put(key, static_cast<uint32_t>(domain), generation, response);
+  }
+
+  res.set_header("ETag", response->etag);
+  // Clients may keep the body but must revalidate it, which is a 304 while nothing changed.
+  res.set_header("Cache-Control", "no-cache");
+  if (ResponseCache::Matches(req.get_header_value("If-None-Match"), response->etag)) {
+    if (options_.compress && response->json_bytes >= options_.compress_min_bytes) {
+      res.set_header("Vary", "Accept-Encoding");
+    }
+    res.status = 304;
+    response_cache_.RecordNotModified(response->body.size());
     return;
   }
+  Send(res, *response);
+}
+
+CachedResponse HttpServer::Encode(const httplib::Request &req, std::string json) const {
+  CachedResponse response;
+  response.json_bytes = json.size();
+  if (options_.compress && json.size() >= options_.compress_min_bytes) {
+    const utils::ContentEncoding encoding = utils::NegotiateEncoding(req.get_header_value("Accept-Encoding"));
+    std::string compressed;
+    // Level 1: JSON still shrinks ~10x and the handler thread stays cheap.
+    if (utils::Compress(json, encoding, &compressed, 1) && compressed.size() < json.size()) {
+      response.body = std::move(compressed);
+      response.encoding = encoding;
+    }
+  }
+  if (response.encoding == utils::ContentEncoding::kIdentity) {
+    response.body = std::move(json);
+  }
+  if (options_.response_cache_entries > 0) {
+    response.etag = ResponseCache::ETag(response.body);
+  }
+  return response;
+}
+
+void HttpServer::Send(httplib::Response &res, CachedResponse response) {
+  json_bytes_.fetch_add(response.json_bytes, std::memory_order_relaxed);
+  sent_bytes_.fetch_add(response.body.size(), std::memory_order_relaxed);
+  if (options_.compress && response.json_bytes >= options_.compress_min_bytes) {
+    res.set_header("Vary", "Accept-Encoding");
+  }
+  if (response.encoding != utils::ContentEncoding::kIdentity) {
+    compressed_responses_.fetch_add(1, std::memory_order_relaxed);
+    res.set_header("Content-Encoding", utils::EncodingName(response.encoding));
+  }
+  res.set_content(std::move(response.body), kJsonContentType);
+}
+
+uint64_t HttpServer::DataGeneration(DataDomain domain) const {
+  // Each counter moves only after its change is visible to readers.
+  switch (domain) {
+    case DataDomain::kMarkets:
+      return market_table_.Current()->generation();
+    case DataDomain::kAlerts:
+      return store_->write_totals().alerts;
+    case DataDomain::kFeatures: {
+      // Raw rows come from series_ when it is on and SQLite otherwise; rollups and
+      // pruning come from compaction.
+      const uint64_t rows = series_ ? series_batches_.load() : store_->write_totals().features;
+      return rows + (compactor_ ? compactor_->stats().runs : 0);
+    }
+    case DataDomain::kCorrelations:
+      return correlations_.steps();
+  }
+  return 0;
+}
+
+WarmStartStats HttpServer::WarmStart() {
+  const auto start = std::chrono::steady_clock::now();
+  const analytics::TickerId max_id = analytics::TickerRegistry::Global().max_id();
+  if (options_.warm_start.threads <= 0 || max_id == analytics::kNoTicker) {
+    return warm_start_;
+  }
 
-  nlohmann::json markets;
-  if (response.contains("markets")) {
-    markets = response["markets"];
+  const auto deadline =
+      start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  std::chrono::duration<double>(options_.warm_start.max_seconds));
+  const analytics::TickerId chunks = (max_id + kWarmStartChunk - 1) / kWarmStartChunk;
+  std::atomic<analytics::TickerId> next_chunk{0};
+  std::atomic<bool> expired{false};
+  WarmStartStats stats;
+
+  // Reads run in parallel on the store's reader pool; applying a chunk is cheap and
+  // serialised on ingest_mutex_, which also owns the engines.
+  auto worker = [&]() {
+    for (analytics::TickerId chunk = next_chunk++; chunk < chunks; chunk = next_chunk++) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        expired = true;
+        return;
+      }
+      const analytics::TickerId first = chunk * kWarmStartChunk + 1;
+      const analytics::TickerId last = std::min<analytics::TickerId>(max_id, first + kWarmStartChunk - 1);
+      const auto features = store_->LatestFeaturePerTicker(first, last);
+      const auto markets = store_->MarketsByTicker(first, last);
+
+      std::lock_guard<std::mutex> lock(ingest_mutex_);
+      for (const auto &feature : features) {
+        alerts_->Restore(feature);
+      }
+      for (const auto &market : markets) {
+        changes_.Restore(market);
+        live_.emplace(market.ticker, market);
+      }
+      stats.features += features.size();
+      stats.markets += markets.size();
+    }
+  };
+
+  const int threads = static_cast<int>(std::min<analytics::TickerId>(options_.warm_start.threads, chunks));
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back(worker);
+  }
+  for (auto &thread : workers) {
+    thread.join();
+  }
+
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stats.complete = !expired;
+  if (stats.complete) {
+    spdlog::info("Warm start: restored {} feature rows and {} markets for {} tickers in {:.0f}ms ({} threads)",
+                 stats.features, stats.markets, max_id, stats.seconds * 1000, threads);
   } else {
-    markets = response;
+    spdlog::warn("Warm start stopped after {:.1f}s with {} feature rows and {} markets restored; remaining tickers "
+                 "start cold",
+                 stats.seconds, stats.features, stats.markets);
   }
+  warm_start_ = stats;
+  return stats;
+}
 
-  if (!markets.is_array()) {
-    spdlog::warn("Markets response not array");
-    return;
+RefreshStats HttpServer::RefreshMarkets(int limit) {
+  const auto start = std::chrono::steady_clock::now();
+  RefreshStats stats = IngestPage(client_->GetMarketsRawAsync(limit).get());
+  correlations_.Step();
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return stats;
+}
+
+RefreshStats HttpServer::IngestPage(utils::HttpResponse response) {
+  const auto start = std::chrono::steady_clock::now();
+  RefreshStats stats;
+  stats.pages = 1;
+
+  analytics::MarketBatch batch;
+  if (auto body = ParsePage(std::move(response), &batch)) {
+    stats.markets = IngestBatch(batch, body, &stats.skipped);
   }
 
-  for (const auto &market : markets) {
-    analytics::MarketSnapshot snapshot = features_->ParseMarketSnapshot(market);
-    if (snapshot.ticker.empty()) {
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return stats;
+}
+
+void HttpServer::FlushWrites() {
+  if (persist_) {
+    persist_->Flush();
+  }
+}
+
+RefreshStats HttpServer::RefreshAllMarkets(int page_size, int max_pages) {
+  const auto start = std::chrono::steady_clock::now();
+  RefreshStats stats;
+
+  std::string last_cursor;
+  auto pending = client_->GetMarketsRawAsync(page_size, last_cursor);
+  analytics::MarketBatch batch;
+  while (pending.valid()) {
+    ++stats.pages;
+    const auto body = ParsePage(pending.get(), &batch);
+    if (!body) {
+      break;
+    }
+
+    // Kick off the next page before ingesting this one so the network round-trip
+    // overlaps with storage and alert evaluation.
+    const bool more = !batch.cursor.empty() && batch.cursor != last_cursor &&
+                      (max_pages <= 0 || stats.pages < max_pages);
+    if (more) {
+      last_cursor = batch.cursor;
+      pending = client_->GetMarketsRawAsync(page_size, last_cursor);
+    }
+
+    stats.markets += IngestBatch(batch, body, &stats.skipped);
+  }
+  correlations_.Step();
+
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  spdlog::info("Full refresh: {} markets ({} unchanged) across {} pages in {:.2f}s ({:.1f} pages/s, {:.1f} markets/s)",
+               stats.markets + stats.skipped, stats.skipped, stats.pages, stats.seconds, stats.PagesPerSecond(),
+               stats.MarketsPerSecond());
+  return stats;
+}
+
+std::shared_ptr<const std::string> HttpServer::ParsePage(utils::HttpResponse response,
+                                                         analytics::MarketBatch *batch) {
+  if (response.body.empty()) {
+    spdlog::warn("Empty response from markets");
+    return nullptr;
+  }
+  // Shared so queued write records can keep pointing into the page after it is parsed.
+  auto body = std::make_shared<const std::string>(std::move(response.body));
+  const auto start = std::chrono::steady_clock::now();
+  const bool parsed = features_->ParseMarketBatch(*body, batch);
+  pipeline_.parse.Record(NanosSince(start));
+  if (!parsed) {
+    spdlog::error("Failed to parse markets response (HTTP {})", response.status);
+    return nullptr;
+  }
+  return body;
+}
+
+int HttpServer::IngestBatch(const analytics::MarketBatch &batch,
+                            const std::shared_ptr<const std::string> &body,
+                            int *skipped) {
+  std::lock_guard<std::mutex> lock(ingest_mutex_);
+  int ingested = 0;
+  for (size_t i = 0; i < batch.snapshots.size(); ++i) {
+    const analytics::MarketSnapshot &snapshot = batch.snapshots[i];
+    if (snapshot.ticker == analytics::kNoTicker) {
       continue;
     }
+    if (IngestLocked(snapshot, body, batch.raw_json[i])) {
+      ++ingested;
+    } else {
+      ++*skipped;
+    }
+  }
+  CommitLocked();
+  return ingested;
+}
+
+void HttpServer::CommitLocked() {
+  if (pending_.empty()) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  published_.clear();
+  for (const auto &record : pending_) {
+    if (record.has_market) {
+      published_.push_back(&record.market);
+    }
+  }
+  if (!published_.empty()) {
+    market_table_.Apply(published_);
+    pipeline_.publish.Record(NanosSince(start));
+    start = std::chrono::steady_clock::now();
+  }
+  if (series_) {
+    // A mapped append is a few stores, cheap enough for the ingest path.
+    for (const auto &record : pending_) {
+      series_->Append(record.feature);
+    }
+    series_batches_.fetch_add(1);
+  }
+  if (push_.has_subscribers()) {
+    PushLocked();
+  }
+  if (persist_) {
+    for (auto &record : pending_) {
+      persist_->Push(std::move(record));
+    }
+  } else {
+    storage::WriteBatch batch;
+    for (auto &record : pending_) {
+      if (record.has_market) {
+        batch.markets.push_back({std::move(record.market), record.raw_json});
+      }
+      batch.features.push_back({std::move(record.feature), record.raw_json});
+      batch.alerts.insert(batch.alerts.end(), record.alerts.begin(), record.alerts.end());
+    }
+    store_->Write(batch);
+  }
+  pipeline_.store.Record(NanosSince(start));
+  pending_.clear();
+}
+
+void HttpServer::PushLocked() {
+  // (record, alert) per event; alert is -1 for the record's feature row.
+  std::vector<std::pair<size_t, int>> sources;
+  push_events_.clear();
+  for (size_t i = 0; i < pending_.size(); ++i) {
+    const storage::WriteRecord &record = pending_[i];
+    PushEvent feature;
+    feature.kind = PushEvent::Kind::kFeature;
+    feature.ticker = analytics::TickerName(record.feature.ticker);
+    push_events_.push_back(std::move(feature));
+    sources.emplace_back(i, -1);
+    for (size_t j = 0; j < record.alerts.size(); ++j) {
+      PushEvent alert;
+      alert.kind = PushEvent::Kind::kAlert;
+      alert.ticker = analytics::TickerName(record.alerts[j].ticker);
+      alert.alert_type = record.alerts[j].type;
+      push_events_.push_back(std::move(alert));
+      sources.emplace_back(i, static_cast<int>(j));
+    }
+  }
+  push_.Publish(push_events_, [&](size_t index) {
+    const storage::WriteRecord &record = pending_[sources[index].first];
+    const int alert = sources[index].second;
+    return alert < 0 ? SseFrame("feature", FeatureToJson(record.feature))
+                     : SseFrame("alert", AlertToJson(record.alerts[alert]));
+  });
+}
+
+bool HttpServer::IngestLocked(const analytics::MarketSnapshot &snapshot,
+                              const std::shared_ptr<const std::string> &owner,
+                              std::string_view raw_json,
+                              bool store_market) {
+  const auto start = std::chrono::steady_clock::now();
+  live_[snapshot.ticker] = snapshot;
+  book_spread_alerted_.erase(snapshot.ticker);
+  // Unchanged markets too: a mid that did not move is a zero return, not an idle ticker.
+  correlations_.Observe(snapshot.ticker, analytics::MidPrice(snapshot));
+  const bool changed = !options_.skip_unchanged || changes_.Changed(snapshot);
+  pipeline_.detect.Record(NanosSince(start));
+  if (!changed) {
+    return false;
+  }
+
+  auto stage = std::chrono::steady_clock::now();
+  const auto book = books_.find(snapshot.ticker);
+  const analytics::FeatureRow feature =
+      features_->ComputeFeatures(snapshot, book != books_.end() ? &book->second : nullptr);
+  pipeline_.features.Record(NanosSince(stage));
+
+  stage = std::chrono::steady_clock::now();
+  const auto alerts = alerts_->Evaluate(feature);
+  pipeline_.alerts.Record(NanosSince(stage));
+
+  storage::WriteRecord record;
+  record.has_market = store_market;
+  record.market = snapshot;
+  record.feature = feature;
+  record.alerts = alerts;
+  record.owner = owner;
+  record.raw_json = raw_json;
+  pending_.push_back(std::move(record));
+  pipeline_.ingest.Record(NanosSince(start));
+  return true;
+}
+
+void HttpServer::AttachStream(std::shared_ptr<kalshi::MarketStream> stream) {
+  stream_ = std::move(stream);
+  kalshi::MarketStream::Handlers handlers;
+  handlers.on_ticker = [this](const kalshi::TickerUpdate &update) { ApplyTickerUpdate(update); };
+  handlers.on_orderbook_snapshot = [this](const kalshi::OrderbookSnapshot &snapshot) {
+    ApplyOrderbookSnapshot(snapshot);
+  };
+  handlers.on_orderbook_delta = [this](const kalshi::OrderbookDelta &delta) { ApplyOrderbookDelta(delta); };
+  handlers.on_resync = [this, tickers = stream_->config().tickers]() { ResyncFromRest(tickers); };
+  stream_->SetHandlers(std::move(handlers));
+}
+
+void HttpServer::ApplyTickerUpdate(const kalshi::TickerUpdate &update) {
+  {
+    std::lock_guard<std::mutex> lock(ingest_mutex_);
+    const analytics::TickerId ticker = analytics::InternTicker(update.ticker);
+    analytics::MarketSnapshot snapshot;
+    auto iter = live_.find(ticker);
+    if (iter != live_.end()) {
+      snapshot = iter->second;
+    } else if (const analytics::MarketSnapshot *stored = market_table_.Find(ticker)) {
+      // Not warm-started (or seen since), but known to the markets table.
+      snapshot = *stored;
+    } else {
+      snapshot.ticker = ticker;
+    }
+    snapshot.yes_bid = update.yes_bid;
+    snapshot.yes_ask = update.yes_ask;
+    snapshot.last_price = update.last_price;
+    snapshot.volume = update.volume;
+    snapshot.updated_at = update.ts > 0 ? update.ts * utils::kNanosPerSecond : utils::NowNanos();
+    auto raw_json = std::make_shared<const std::string>(update.raw_json);
+    // Ticker messages carry no event or category. Upserting a market we have never
+    // seen in full would blank those columns and pull it out of its event, so until a
+    // REST refresh fills them in, only its prices (in live_) and features are kept.
+    const bool metadata_known = !snapshot.event_ticker.empty();
+    IngestLocked(snapshot, raw_json, *raw_json, metadata_known);
+    CommitLocked();
+  }
+
+  const auto latency_us = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - update.received)
+          .count());
+  stream_updates_.fetch_add(1, std::memory_order_relaxed);
+  stream_latency_total_us_.fetch_add(latency_us, std::memory_order_relaxed);
+  uint64_t prev_max = stream_latency_max_us_.load(std::memory_order_relaxed);
+  while (latency_us > prev_max && !stream_latency_max_us_.compare_exchange_weak(prev_max, latency_us)) {
+  }
+}
+
+void HttpServer::ApplyOrderbookSnapshot(const kalshi::OrderbookSnapshot &snapshot) {
+  std::lock_guard<std::mutex> lock(ingest_mutex_);
+  const analytics::TickerId ticker = analytics::InternTicker(snapshot.ticker);
+  analytics::OrderBook &book = books_[ticker];
+  book.Clear();
+  for (const auto &level : snapshot.yes) {
+    book.SetLevel(true, level.price, level.quantity);
+  }
+  for (const auto &level : snapshot.no) {
+    book.SetLevel(false, level.price, level.quantity);
+  }
+  IngestBookLocked(ticker);
+}
+
+void HttpServer::ApplyOrderbookDelta(const kalshi::OrderbookDelta &delta) {
+  std::lock_guard<std::mutex> lock(ingest_mutex_);
+  const analytics::TickerId ticker = analytics::InternTicker(delta.ticker);
+  books_[ticker].ApplyDelta(delta.yes_side, delta.price, delta.delta);
+  IngestBookLocked(ticker);
+}
+
+void HttpServer::IngestBookLocked(analytics::TickerId ticker) {
+  const analytics::OrderBook &book = books_[ticker];
+  analytics::MarketSnapshot &snapshot = live_[ticker];
+  snapshot.ticker = ticker;
+  snapshot.yes_bid = book.BestYesBid();
+  snapshot.yes_ask = book.BestYesAsk();
+  snapshot.updated_at = utils::NowNanos();
+
+  storage::WriteRecord record;
+  record.feature = features_->ComputeFeatures(snapshot, &book);
+  correlations_.Observe(ticker, record.feature.mid);
+  // Most deltas land below the top N levels; those change nothing we store.
+  analytics::FeatureRow &last = book_features_[ticker];
+  if (last.ticker != analytics::kNoTicker && SameBookFeatures(last, record.feature)) {
+    return;
+  }
+  last = record.feature;
+  record.alerts = alerts_->Evaluate(record.feature);
+  // A wide book stays wide across many deltas; raise wide_spread once per refresh.
+  const auto wide = std::find_if(record.alerts.begin(), record.alerts.end(),
+                                 [](const analytics::Alert &alert) { return alert.type == "wide_spread"; });
+  if (wide != record.alerts.end() && !book_spread_alerted_.insert(ticker).second) {
+    record.alerts.erase(wide);
+  }
+  pending_.push_back(std::move(record));
+  CommitLocked();
+}
+
+void HttpServer::ResyncFromRest(const std::vector<std::string> &tickers) {
+  if (tickers.empty()) {
+    const uint64_t id = scheduler_->Submit(options_.refresh);
+    spdlog::info("Stream resync: queued refresh job {}", id);
+    return;
+  }
 
-    store_->UpsertMarket(snapshot, market.dump());
+  std::vector<std::future<nlohmann::json>> pending;
+  pending.reserve(tickers.size());
+  for (const auto &ticker : tickers) {
+    pending.push_back(client_->GetMarketAsync(ticker));
+  }
 
-    analytics::FeatureRow feature = features_->ComputeFeatures(snapshot);
-    store_->InsertFeature(feature, market.dump());
+  std::vector<analytics::MarketSnapshot> snapshots;
+  std::vector<std::shared_ptr<const std::string>> raw_json;
+  snapshots.reserve(tickers.size());
+  raw_json.reserve(tickers.size());
+  for (auto &future : pending) {
+    const nlohmann::json response = future.get();
+    if (!response.contains("market") || !response["market"].is_object()) {
+      continue;
+    }
+    const nlohmann::json &market = response["market"];
+    analytics::MarketSnapshot snapshot = features_->ParseMarketSnapshot(market);
+    if (snapshot.ticker == analytics::kNoTicker) {
+      continue;
+    }
+    snapshots.push_back(std::move(snapshot));
+    raw_json.push_back(std::make_shared<const std::string>(market.dump()));
+  }
 
-    const auto alerts = alerts_->Evaluate(feature);
-    for (const auto &alert : alerts) {
-      store_->InsertAlert(alert);
+  {
+    std::lock_guard<std::mutex> lock(ingest_mutex_);
+    for (size_t i = 0; i < snapshots.size(); ++i) {
+      IngestLocked(snapshots[i], raw_json[i], *raw_json[i]);
     }
+    CommitLocked();
+  }
+  spdlog::info("Stream resync: {}/{} markets refreshed over REST", snapshots.size(), tickers.size());
+}
+
+std::vector<analytics::FeatureRow> HttpServer::RawFeatures(analytics::TickerId ticker, int64_t from_nanos,
+                                                           int64_t to_nanos, int limit) const {
+  int64_t first_nanos = 0;
+  if (!series_ || !series_->FirstTime(ticker, &first_nanos)) {
+    return store_->FeatureRange(ticker, from_nanos, to_nanos, limit);
+  }
+  std::vector<analytics::FeatureRow> rows = series_->Range(ticker, from_nanos, to_nanos, limit);
+  if ((limit > 0 && rows.size() >= static_cast<size_t>(limit)) || from_nanos >= first_nanos) {
+    return rows;
   }
+  const int remaining = limit > 0 ? limit - static_cast<int>(rows.size()) : 0;
+  const auto older = store_->FeatureRange(ticker, from_nanos, std::min(to_nanos, first_nanos - 1), remaining);
+  rows.insert(rows.end(), older.begin(), older.end());
+  return rows;
 }
 
 }  // namespace server
@@ -0,0 +1,318 @@
+#include "server/market_table.h"
+
+#include "analytics/ticker_registry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <iterator>
+#include <utility>
+
+namespace server {
+
+namespace {
+
+// "" for markets without an event, which are not summarised.
+std::string EventKey(const analytics::MarketSnapshot &snapshot) {
+  if (snapshot.event_ticker.empty()) {
+    return {};
+  }
+  std::string key = snapshot.event_ticker;
+  key.push_back('\x1f');
+  key += snapshot.category;
+  return key;
+}
+
+bool MarketBefore(const MarketRow &a, const MarketRow &b) {
+  if (a.snapshot.updated_at != b.snapshot.updated_at) {
+    return a.snapshot.updated_at > b.snapshot.updated_at;
+  }
+  return a.snapshot.ticker < b.snapshot.ticker;
+}
+
+bool EventBefore(const analytics::EventSummary &a, const analytics::EventSummary &b) {
+  if (a.updated_at != b.updated_at) {
+    return a.updated_at > b.updated_at;
+  }
+  if (a.event_ticker != b.event_ticker) {
+    return a.event_ticker < b.event_ticker;
+  }
+  return a.category < b.category;
+}
+
+// ASCII case-insensitive, matching SQLite's LIKE.
+bool ContainsFolded(const std::string &text, const std::string &needle) {
+  return std::search(text.begin(), text.end(), needle.begin(), needle.end(), [](char a, char b) {
+           return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+         }) != text.end();
+}
+
+size_t Limit(int limit, size_t available) {
+  return limit < 0 ? available : std::min(available, static_cast<size_t>(limit));
+}
+
+// Target chunk length: a publish copies about one chunk per changed row plus one
+// pointer per chunk, which balances near the square root of markets per changed row.
+constexpr size_t kChunkRows = 64;
+
+// previous without removed (elements of previous, by identity) and with added (sorted
+// by before) merged in. Chunks that neither touches are shared with previous.
+template <typename T, typename Before>
+ChunkedOrder<T> Patch(const ChunkedOrder<T> &previous, const std::vector<const T *> &removed,
+                      const std::vector<std::shared_ptr<const T>> &added, Before before) {
+  using Chunk = typename ChunkedOrder<T>::Chunk;
+  const auto &chunks = previous.chunks;
+  const auto element_before = [&](const std::shared_ptr<const T> &a, const std::shared_ptr<const T> &b) {
+    return before(*a, *b);
+  };
+  // The chunk an element sorts into: the first whose last element is not before it,
+  // or the last chunk for elements past the end.
+  const auto chunk_of = [&](const T &element) {
+    const auto iter = std::partition_point(chunks.begin(), chunks.end(), [&](const auto &chunk) {
+      return before(*chunk->back(), element);
+    });
+    return std::min(static_cast<size_t>(iter - chunks.begin()), chunks.size() - 1);
+  };
+
+  ChunkedOrder<T> next;
+  Chunk pending;
+  // Splits pending into even chunks of at most kChunkRows.
+  const auto flush = [&]() {
+    const size_t pieces = (pending.size() + kChunkRows - 1) / kChunkRows;
+    for (size_t piece = 0; piece < pieces; ++piece) {
+      next.chunks.push_back(std::make_shared<const Chunk>(pending.begin() + pending.size() * piece / pieces,
+                                                          pending.begin() + pending.size() * (piece + 1) / pieces));
+    }
+    next.size += pending.size();
+    pending.clear();
+  };
+  if (chunks.empty()) {
+    pending = added;
+    flush();
+    return next;
+  }
+
+  // (chunk, index in chunk) of each removed element; keys are unique within a version,
+  // so a binary search finds it.
+  std::vector<std::pair<size_t, size_t>> holes;
+  holes.reserve(removed.size());
+  for (const T *element : removed) {
+    const size_t c = chunk_of(*element);
+    const Chunk &chunk = *chunks[c];
+    const auto iter = std::partition_point(chunk.begin(), chunk.end(),
+                                           [&](const auto &row) { return before(*row, *element); });
+    if (iter != chunk.end() && iter->get() == element) {
+      holes.emplace_back(c, static_cast<size_t>(iter - chunk.begin()));
+    }
+  }
+  std::sort(holes.begin(), holes.end());
+  // added is sorted, so its chunks are too.
+  std::vector<size_t> added_chunks;
+  added_chunks.reserve(added.size());
+  for (const auto &element : added) {
+    added_chunks.push_back(chunk_of(*element));
+  }
+
+  auto hole = holes.begin();
+  size_t add = 0;
+  Chunk kept;
+  for (size_t c = 0; c < chunks.size(); ++c) {
+    const Chunk &chunk = *chunks[c];
+    const bool affected = (hole != holes.end() && hole->first == c) || (add < added.size() && added_chunks[add] == c);
+    // A short run left by removals takes in the next chunk rather than stay on its own.
+    if (!affected && (pending.empty() || pending.size() >= kChunkRows / 2)) {
+      flush();
+      next.chunks.push_back(chunks[c]);
+      next.size += chunk.size();
+      continue;
+    }
+    kept.clear();
+    size_t first = 0;
+    for (; hole != holes.end() && hole->first == c; ++hole) {
+      kept.insert(kept.end(), chunk.begin() + first, chunk.begin() + hole->second);
+      first = hole->second + 1;
+    }
+    kept.insert(kept.end(), chunk.begin() + first, chunk.end());
+    const size_t first_added = add;
+    while (add < added.size() && added_chunks[add] == c) {
+      ++add;
+    }
+    std::merge(std::make_move_iterator(kept.begin()), std::make_move_iterator(kept.end()),
+               added.begin() + first_added, added.begin() + add, std::back_inserter(pending), element_before);
+  }
+  flush();
+  return next;
+}
+
+}  // namespace
+
+std::vector<const MarketRow *> MarketView::Markets(int limit, const std::string &search) const {
+  std::vector<const MarketRow *> results;
+  const size_t wanted = Limit(limit, markets_.size);
+  results.reserve(search.empty() ? wanted : std::min<size_t>(wanted, 256));
+  for (const auto &chunk : markets_.chunks) {
+    for (const auto &row : *chunk) {
+      if (results.size() >= wanted) {
+        return results;
+      }
+      if (search.empty() || ContainsFolded(row->ticker, search) ||
+          ContainsFolded(row->snapshot.event_ticker, search) || ContainsFolded(row->snapshot.category, search)) {
+        results.push_back(row.get());
+      }
+    }
+  }
+  return results;
+}
+
+std::vector<const analytics::EventSummary *> MarketView::Events(int limit, const std::string &search) const {
+  std::vector<const analytics::EventSummary *> results;
+  const size_t wanted = Limit(limit, events_.size);
+  for (const auto &chunk : events_.chunks) {
+    for (const auto &summary : *chunk) {
+      if (results.size() >= wanted) {
+        return results;
+      }
+      if (search.empty() || ContainsFolded(summary->event_ticker, search) ||
+          ContainsFolded(summary->category, search)) {
+        results.push_back(summary.get());
+      }
+    }
+  }
+  return results;
+}
+
+MarketTable::MarketTable() : current_(std::make_shared<const MarketView>()) {}
+
+std::shared_ptr<const MarketView> MarketTable::Current() const {
+  return std::atomic_load(&current_);
+}
+
+void MarketTable::Load(const std::vector<analytics::MarketSnapshot> &markets) {
+  rows_.clear();
+  events_.clear();
+  changed_in_.clear();
+
+  std::vector<const analytics::MarketSnapshot *> updates;
+  updates.reserve(markets.size());
+  for (const auto &market : markets) {
+    updates.push_back(&market);
+  }
+  // Patched onto an empty version, keeping the generation moving forward.
+  auto empty = std::make_shared<MarketView>();
+  empty->generation_ = Current()->generation_;
+  Publish(std::move(empty));
+  Apply(updates);
+}
+
+const analytics::MarketSnapshot *MarketTable::Find(analytics::TickerId ticker) const {
+  if (ticker >= rows_.size() || !rows_[ticker]) {
+    return nullptr;
+  }
+  return &rows_[ticker]->snapshot;
+}
+
+void MarketTable::Apply(const std::vector<const analytics::MarketSnapshot *> &updates) {
+  const std::shared_ptr<const MarketView> previous = Current();
+  auto next = std::make_shared<MarketView>();
+  next->generation_ = previous->generation_ + 1;
+  const uint64_t generation = next->generation_;
+
+  std::vector<analytics::TickerId> changed_ids;
+  // Rows of previous that changed; previous keeps them alive until we are done.
+  std::vector<const MarketRow *> replaced;
+  std::unordered_set<std::string> touched_events;
+  for (const analytics::MarketSnapshot *update : updates) {
+    const analytics::TickerId id = update->ticker;
+    if (id == analytics::kNoTicker) {
+      continue;
+    }
+    if (id >= rows_.size()) {
+      rows_.resize(static_cast<size_t>(id) + 1);
+      changed_in_.resize(static_cast<size_t>(id) + 1, 0);
+    }
+
+    std::shared_ptr<const MarketRow> &slot = rows_[id];
+    if (changed_in_[id] != generation) {
+      changed_in_[id] = generation;
+      changed_ids.push_back(id);
+      if (slot) {
+        replaced.push_back(slot.get());
+      }
+    }
+    if (slot) {
+      const std::string old_key = EventKey(slot->snapshot);
+      if (!old_key.empty()) {
+        events_[old_key].tickers.erase(id);
+        touched_events.insert(old_key);
+      }
+    }
+    auto row = std::make_shared<MarketRow>();
+    row->snapshot = *update;
+    row->ticker = analytics::TickerName(id);
+    slot = std::move(row);
+
+    const std::string key = EventKey(*update);
+    if (!key.empty()) {
+      EventMembers &members = events_[key];
+      if (members.tickers.empty()) {
+        members.event_ticker = update->event_ticker;
+        members.category = update->category;
+      }
+      members.tickers.insert(id);
+      touched_events.insert(key);
+    }
+  }
+  if (changed_ids.empty()) {
+    return;
+  }
+
+  std::vector<std::shared_ptr<const MarketRow>> changed;
+  changed.reserve(changed_ids.size());
+  for (const analytics::TickerId id : changed_ids) {
+    changed.push_back(rows_[id]);
+  }
+  std::sort(changed.begin(), changed.end(),
+            [](const auto &a, const auto &b) { return MarketBefore(*a, *b); });
+  next->markets_ = Patch(previous->markets_, replaced, changed, MarketBefore);
+
+  // Touched events are re-aggregated from their members; an event keeps a handful of
+  // markets, so this stays proportional to the update.
+  std::vector<const analytics::EventSummary *> stale;
+  std::vector<std::shared_ptr<const analytics::EventSummary>> summaries;
+  for (const std::string &key : touched_events) {
+    const auto iter = events_.find(key);
+    if (iter == events_.end()) {
+      continue;
+    }
+    EventMembers &members = iter->second;
+    if (members.summary) {
+      stale.push_back(members.summary.get());
+    }
+    if (members.tickers.empty()) {
+      events_.erase(iter);
+      continue;
+    }
+    auto summary = std::make_shared<analytics::EventSummary>();
+    summary->event_ticker = members.event_ticker;
+    summary->category = members.category;
+    for (const analytics::TickerId id : members.tickers) {
+      const analytics::MarketSnapshot &market = rows_[id]->snapshot;
+      ++summary->market_count;
+      summary->total_volume += market.volume;
+      summary->updated_at = std::max(summary->updated_at, market.updated_at);
+    }
+    members.summary = summary;
+    summaries.push_back(std::move(summary));
+  }
+  std::sort(summaries.begin(), summaries.end(),
+            [](const auto &a, const auto &b) { return EventBefore(*a, *b); });
+  next->events_ = Patch(previous->events_, stale, summaries, EventBefore);
+
+  Publish(std::move(next));
+}
+
+void MarketTable::Publish(std::shared_ptr<MarketView> next) {
+  std::atomic_store(&current_, std::shared_ptr<const MarketView>(std::move(next)));
+}
+
+}  // namespace server
@@ -0,0 +1,134 @@
+#include "server/push_hub.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace server {
+
+bool PushFilter::WantsFeature(const std::string &ticker) const {
+  return every_ticker || tickers.count(ticker) > 0;
+}
+
+bool PushFilter::WantsAlert(const std::string &type) const {
+  return every_alert_type || alert_types.count(type) > 0;
+}
+
+PushSubscriber::PushSubscriber(PushFilter filter, size_t capacity)
+    : filter_(std::move(filter)), capacity_(std::max<size_t>(capacity, 1)) {}
+
+bool PushSubscriber::Next(std::chrono::milliseconds timeout, std::vector<std::shared_ptr<const std::string>> *frames,
+                          uint64_t *dropped) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ready_.wait_for(lock, timeout, [this] { return closed_ || !frames_.empty(); });
+  if (closed_) {
+    return false;
+  }
+  frames->insert(frames->end(), std::make_move_iterator(frames_.begin()), std::make_move_iterator(frames_.end()));
+  frames_.clear();
+  *dropped = dropped_;
+  dropped_ = 0;
+  return true;
+}
+
+bool PushSubscriber::Offer(const std::shared_ptr<const std::string> &frame) {
+  bool kept_all = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return true;
+    }
+    if (frames_.size() >= capacity_) {
+      frames_.pop_front();
+      ++dropped_;
+      kept_all = false;
+    }
+    frames_.push_back(frame);
+  }
+  ready_.notify_one();
+  return kept_all;
+}
+
+void PushSubscriber::Close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    frames_.clear();
+  }
+  ready_.notify_all();
+}
+
+PushHub::PushHub(PushOptions options) : options_(options) {}
+
+std::shared_ptr<PushSubscriber> PushHub::Subscribe(PushFilter filter) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_ || subscribers_.size() >= options_.max_subscribers) {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  auto subscriber = std::make_shared<PushSubscriber>(std::move(filter), options_.buffer_events);
+  subscribers_.push_back(subscriber);
+  subscriber_count_.store(subscribers_.size(), std::memory_order_relaxed);
+  return subscriber;
+}
+
+void PushHub::Unsubscribe(const std::shared_ptr<PushSubscriber> &subscriber) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  subscribers_.erase(std::remove(subscribers_.begin(), subscribers_.end(), subscriber), subscribers_.end());
+  subscriber_count_.store(subscribers_.size(), std::memory_order_relaxed);
+}
+
+void PushHub::Publish(const std::vector<PushEvent> &events, const PushFormatter &format) {
+  uint64_t published = 0;
+  uint64_t delivered = 0;
+  uint64_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < events.size(); ++i) {
+      const PushEvent &event = events[i];
+      std::shared_ptr<const std::string> frame;
+      for (const auto &subscriber : subscribers_) {
+        const bool wanted = event.kind == PushEvent::Kind::kAlert ? subscriber->filter_.WantsAlert(event.alert_type)
+                                                                   : subscriber->filter_.WantsFeature(event.ticker);
+        if (!wanted) {
+          continue;
+        }
+        if (!frame) {
+          frame = std::make_shared<const std::string>(format(i));
+          ++published;
+        }
+        ++delivered;
+        if (!subscriber->Offer(frame)) {
+          ++dropped;
+        }
+      }
+    }
+  }
+  published_.fetch_add(published, std::memory_order_relaxed);
+  delivered_.fetch_add(delivered, std::memory_order_relaxed);
+  dropped_.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+void PushHub::Close() {
+  std::vector<std::shared_ptr<PushSubscriber>> subscribers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    subscribers.swap(subscribers_);
+    subscriber_count_.store(0, std::memory_order_relaxed);
+  }
+  for (const auto &subscriber : subscribers) {
+    subscriber->Close();
+  }
+}
+
+PushStats PushHub::stats() const {
+  PushStats stats;
+  stats.subscribers = subscriber_count_.load(std::memory_order_relaxed);
+  stats.published = published_.load(std::memory_order_relaxed);
+  stats.delivered = delivered_.load(std::memory_order_relaxed);
+  stats.dropped = dropped_.load(std::memory_order_relaxed);
+  stats.rejected = rejected_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace server
@@ -0,0 +1,171 @@
+#include "server/refresh_scheduler.h"
+
+#include <spdlog/spdlog.h>
+
+namespace server {
+
+namespace {
+// Finished jobs kept around for status lookups.
+constexpr size_t kJobHistory = 256;
+}  // namespace
+
+const char *RefreshJob::StateName(State state) {
+  switch (state) {
+    case State::kQueued:
+      return "queued";
+    case State::kRunning:
+      return "running";
+    case State::kDone:
+      return "done";
+    case State::kFailed:
+      return "failed";
+  }
+  return "unknown";
+}
+
+RefreshScheduler::RefreshScheduler(Runner runner, int interval_seconds, RefreshRequest periodic)
+    : runner_(std::move(runner)), interval_seconds_(interval_seconds), periodic_(periodic) {}
+
+RefreshScheduler::~RefreshScheduler() {
+  Stop();
+}
+
+void RefreshScheduler::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (worker_.joinable()) {
+    return;
+  }
+  stop_ = false;
+  worker_ = std::thread([this]() { Run(); });
+}
+
+void RefreshScheduler::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+uint64_t RefreshScheduler::Submit(const RefreshRequest &request, bool *coalesced) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto absorb = [&](uint64_t id) {
+    ++jobs_[id].coalesced;
+    if (coalesced) {
+      *coalesced = true;
+    }
+    return id;
+  };
+
+  if (running_id_ != 0 && jobs_[running_id_].request == request) {
+    return absorb(running_id_);
+  }
+  for (const uint64_t id : queue_) {
+    if (jobs_[id].request == request) {
+      return absorb(id);
+    }
+  }
+
+  RefreshJob job;
+  job.id = next_id_++;
+  job.request = request;
+  job.submitted_at = std::chrono::system_clock::now();
+  jobs_[job.id] = job;
+  queue_.push_back(job.id);
+  if (coalesced) {
+    *coalesced = false;
+  }
+  cv_.notify_all();
+  return job.id;
+}
+
+std::optional<RefreshJob> RefreshScheduler::Job(uint64_t id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = jobs_.find(id);
+  if (iter == jobs_.end()) {
+    return std::nullopt;
+  }
+  return iter->second;
+}
+
+std::optional<RefreshJob> RefreshScheduler::Wait(uint64_t id, std::chrono::milliseconds timeout) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait_for(lock, timeout, [&]() {
+    auto iter = jobs_.find(id);
+    return iter == jobs_.end() || iter->second.state == RefreshJob::State::kDone ||
+           iter->second.state == RefreshJob::State::kFailed;
+  });
+  auto iter = jobs_.find(id);
+  if (iter == jobs_.end()) {
+    return std::nullopt;
+  }
+  return iter->second;
+}
+
+void RefreshScheduler::Run() {
+  auto next_periodic = std::chrono::steady_clock::now() + std::chrono::seconds(interval_seconds_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    if (queue_.empty()) {
+      if (interval_seconds_ > 0) {
+        cv_.wait_until(lock, next_periodic, [this]() { return stop_ || !queue_.empty(); });
+      } else {
+        cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      }
+    }
+    if (stop_) {
+      break;
+    }
+
+    if (interval_seconds_ > 0 && std::chrono::steady_clock::now() >= next_periodic) {
+      next_periodic = std::chrono::steady_clock::now() + std::chrono::seconds(interval_seconds_);
+      lock.unlock();
+      Submit(periodic_);
+      lock.lock();
+    }
+    if (queue_.empty()) {
+      continue;
+    }
+
+    const uint64_t id = queue_.front();
+    queue_.pop_front();
+    running_id_ = id;
+    jobs_[id].state = RefreshJob::State::kRunning;
+    const RefreshRequest request = jobs_[id].request;
+    lock.unlock();
+
+    RefreshStats stats;
+    std::string error;
+    try {
+      stats = runner_(request);
+    } catch (const std::exception &ex) {
+      error = ex.what();
+      spdlog::error("Refresh job {} failed: {}", id, error);
+    }
+
+    lock.lock();
+    RefreshJob &job = jobs_[id];
+    job.stats = stats;
+    job.error = error;
+    job.state = error.empty() ? RefreshJob::State::kDone : RefreshJob::State::kFailed;
+    job.finished_at = std::chrono::system_clock::now();
+    running_id_ = 0;
+    Trim();
+    cv_.notify_all();
+  }
+}
+
+void RefreshScheduler::Trim() {
+  while (jobs_.size() > kJobHistory) {
+    auto oldest = jobs_.begin();
+    if (oldest->second.state == RefreshJob::State::kQueued || oldest->second.state == RefreshJob::State::kRunning) {
+      break;
+    }
+    jobs_.erase(oldest);
+  }
+}
+
+}  // namespace server
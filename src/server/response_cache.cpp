@@ -0,0 +1,117 @@
+#include "server/response_cache.h"
+
+#include <cstdio>
+#include <utility>
+
+namespace server {
+
+namespace {
+
+constexpr uint64_t kFnvOffset = 1469598103934665603ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+std::string_view Trim(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+}  // namespace
+
+ResponseCache::ResponseCache(size_t max_entries) : max_entries_(max_entries) {}
+
+std::shared_ptr<const CachedResponse> ResponseCache::Find(const std::string &key, uint64_t generation) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto iter = entries_.find(key);
+    if (iter != entries_.end() && iter->second.generation == generation) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return iter->second.response;
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+void ResponseCache::Put(const std::string &key, uint32_t domain, uint64_t generation,
+                        std::shared_ptr<const CachedResponse> response) {
+  if (max_entries_ == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto iter = entries_.find(key);
+  if (iter != entries_.end()) {
+    // Two requests may race to rebuild the same key; keep the newer body.
+    if (iter->second.generation <= generation) {
+      iter->second = {domain, generation, std::move(response)};
+    }
+    return;
+  }
+  if (entries_.size() >= max_entries_) {
+    // Only this domain's generation is known to be current here.
+    for (auto stale = entries_.begin(); stale != entries_.end();) {
+      const Entry &entry = stale->second;
+      stale = entry.domain == domain && entry.generation < generation ? entries_.erase(stale) : std::next(stale);
+    }
+    // Nothing of this domain was stale: the key space outgrew the cache, so drop any one.
+    if (entries_.size() >= max_entries_) {
+      entries_.erase(entries_.begin());
+    }
+  }
+  entries_.emplace(key, Entry{domain, generation, std::move(response)});
+}
+
+void ResponseCache::RecordNotModified(size_t body_bytes) {
+  not_modified_.fetch_add(1, std::memory_order_relaxed);
+  bytes_saved_.fetch_add(body_bytes, std::memory_order_relaxed);
+}
+
+ResponseCacheStats ResponseCache::stats() const {
+  ResponseCacheStats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.not_modified = not_modified_.load(std::memory_order_relaxed);
+  stats.bytes_saved = bytes_saved_.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats.entries = entries_.size();
+  return stats;
+}
+
+std::string ResponseCache::ETag(std::string_view body) {
+  uint64_t hash = kFnvOffset;
+  for (const char c : body) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= kFnvPrime;
+  }
+  char tag[20];
+  std::snprintf(tag, sizeof(tag), "\"%016llx\"", static_cast<unsigned long long>(hash));
+  return tag;
+}
+
+bool ResponseCache::Matches(std::string_view if_none_match, std::string_view etag) {
+  if_none_match = Trim(if_none_match);
+  if (if_none_match == "*") {
+    return true;
+  }
+  while (!if_none_match.empty()) {
+    const size_t comma = if_none_match.find(',');
+    std::string_view candidate = Trim(if_none_match.substr(0, comma));
+    if (candidate.substr(0, 2) == "W/") {
+      candidate.remove_prefix(2);
+    }
+    if (candidate == etag) {
+      return true;
+    }
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    if_none_match.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
+}  // namespace server
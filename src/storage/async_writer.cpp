@@ -0,0 +1,400 @@
+#include "storage/async_writer.h"
+
+#include "analytics/ticker_registry.h"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <cstdio>
+
+namespace storage {
+
+namespace {
+
+uint64_t NanosSince(std::chrono::steady_clock::time_point start) {
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() > 0
+             ? static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+             : 0;
+}
+
+// Spill files can outlive the process, so tickers are written by name: ids are only
+// stable once SQLite has persisted them.
+nlohmann::json SpillToJson(const WriteRecord &record) {
+  nlohmann::json out;
+  if (record.has_market) {
+    const auto &m = record.market;
+    out["m"] = {analytics::TickerName(m.ticker), m.event_ticker, m.status, m.category, m.yes_bid, m.yes_ask,
+                m.last_price, m.volume, m.updated_at};
+  }
+  const auto &f = record.feature;
+  out["f"] = {analytics::TickerName(f.ticker), f.ts, f.mid, f.spread, f.prob, f.volume,
+              f.has_book, f.bid_depth, f.ask_depth, f.imbalance, f.microprice};
+  out["a"] = nlohmann::json::array();
+  for (const auto &a : record.alerts) {
+    out["a"].push_back({analytics::TickerName(a.ticker), a.ts, a.type, a.score, a.details});
+  }
+  out["r"] = record.raw_json;
+  out["t"] = record.enqueued.time_since_epoch().count();
+  return out;
+}
+
+WriteRecord SpillFromJson(const nlohmann::json &in) {
+  WriteRecord record;
+  if (in.contains("m")) {
+    const auto &m = in["m"];
+    record.has_market = true;
+    record.market = {analytics::InternTicker(m[0].get<std::string>()), m[1], m[2], m[3], m[4], m[5], m[6], m[7],
+                     m[8]};
+  }
+  const auto &f = in["f"];
+  record.feature = {analytics::InternTicker(f[0].get<std::string>()), f[1], f[2], f[3], f[4], f[5], f[6], f[7],
+                    f[8], f[9], f[10]};
+  for (const auto &a : in["a"]) {
+    record.alerts.push_back({analytics::InternTicker(a[0].get<std::string>()), a[1], a[2], a[3], a[4]});
+  }
+  record.owner = std::make_shared<const std::string>(in["r"].get<std::string>());
+  record.raw_json = *record.owner;
+  record.enqueued = std::chrono::steady_clock::time_point(
+      std::chrono::steady_clock::duration(in["t"].get<std::chrono::steady_clock::rep>()));
+  return record;
+}
+
+}  // namespace
+
+BackpressurePolicy ParseBackpressurePolicy(const std::string &name) {
+  if (name == "drop-oldest") {
+    return BackpressurePolicy::kDropOldest;
+  }
+  if (name == "spill") {
+    return BackpressurePolicy::kSpill;
+  }
+  if (name != "block") {
+    spdlog::warn("Unknown backpressure policy '{}', using block", name);
+  }
+  return BackpressurePolicy::kBlock;
+}
+
+const char *BackpressurePolicyName(BackpressurePolicy policy) {
+  switch (policy) {
+    case BackpressurePolicy::kDropOldest:
+      return "drop-oldest";
+    case BackpressurePolicy::kSpill:
+      return "spill";
+    case BackpressurePolicy::kBlock:
+      break;
+  }
+  return "block";
+}
+
+AsyncWriter::AsyncWriter(std::shared_ptr<SQLiteStore> store, AsyncWriterOptions options)
+    : store_(std::move(store)),
+      options_(std::move(options)),
+      queue_(options_.capacity),
+      started_(std::chrono::steady_clock::now()) {
+  if (options_.max_batch == 0) {
+    options_.max_batch = 1;
+  }
+}
+
+AsyncWriter::~AsyncWriter() {
+  Stop();
+}
+
+void AsyncWriter::Start() {
+  if (worker_.joinable()) {
+    return;
+  }
+  if (options_.policy == BackpressurePolicy::kSpill) {
+    // Records spilled by a previous run that never caught up are replayed first.
+    std::ifstream leftover(options_.spill_path, std::ios::binary | std::ios::ate);
+    const auto size = leftover ? static_cast<long long>(leftover.tellg()) : 0;
+    long long position = 0;
+    std::ifstream saved(SpillPositionPath());
+    if (!(saved >> position) || position < 0 || position > size) {
+      position = 0;
+    }
+    if (size > position) {
+      spdlog::info("Replaying spilled records from {} (byte {} of {})", options_.spill_path, position, size);
+      spill_read_ = static_cast<uint64_t>(position);
+      spill_committed_ = spill_read_;
+      spilling_ = true;
+    }
+  }
+  stop_ = false;
+  worker_ = std::thread([this]() { Run(); });
+}
+
+void AsyncWriter::Stop() {
+  stop_ = true;
+  wake_cv_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void AsyncWriter::Push(WriteRecord record) {
+  pushed_.fetch_add(1, std::memory_order_relaxed);
+  record.enqueued = std::chrono::steady_clock::now();
+
+  if (spilling_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(spill_mutex_);
+    if (spilling_) {
+      Spill(record);
+      return;
+    }
+  }
+
+  bool waited = false;
+  while (!queue_.TryPush(record)) {
+    switch (options_.policy) {
+      case BackpressurePolicy::kBlock:
+        if (!waited) {
+          blocked_.fetch_add(1, std::memory_order_relaxed);
+          waited = true;
+        }
+        wake_cv_.notify_one();
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        break;
+      case BackpressurePolicy::kDropOldest: {
+        WriteRecord victim;
+        if (queue_.TryPop(&victim)) {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        break;
+      }
+      case BackpressurePolicy::kSpill: {
+        std::lock_guard<std::mutex> lock(spill_mutex_);
+        if (!spilling_ && spilled_.load() == 0) {
+          spdlog::warn("Persist queue full ({} records); spilling to {}", queue_.capacity(), options_.spill_path);
+        }
+        spilling_ = true;
+        Spill(record);
+        wake_cv_.notify_one();
+        return;
+      }
+    }
+  }
+  wake_cv_.notify_one();
+}
+
+void AsyncWriter::Flush() {
+  const uint64_t target = pushed_.load();
+  wake_cv_.notify_one();
+  std::unique_lock<std::mutex> lock(wake_mutex_);
+  // Timed so a notify racing with this wait (drop-oldest evictions) cannot strand it.
+  while (written_.load() + dropped_.load() < target && worker_.joinable()) {
+    flushed_cv_.wait_for(lock, std::chrono::milliseconds(50));
+  }
+}
+
+AsyncWriter::Stats AsyncWriter::stats() const {
+  Stats stats;
+  stats.depth = queue_.size();
+  stats.capacity = queue_.capacity();
+  stats.pushed = pushed_.load();
+  stats.written = written_.load();
+  stats.dropped = dropped_.load();
+  stats.spilled = spilled_.load();
+  stats.blocked = blocked_.load();
+  return stats;
+}
+
+void AsyncWriter::Run() {
+  std::vector<WriteRecord> records;
+  records.reserve(options_.max_batch);
+  while (true) {
+    records.clear();
+    WriteRecord record;
+    while (records.size() < options_.max_batch && queue_.TryPop(&record)) {
+      records.push_back(std::move(record));
+    }
+    if (!records.empty()) {
+      if (!Commit(records)) {
+        // Ahead of anything already spilled, which was pushed after these.
+        Respill(records);
+      }
+      records.clear();
+      flushed_cv_.notify_all();
+      continue;
+    }
+
+    // The queue only empties while spilling once the writer has caught up.
+    if (spilling_ && TakeSpilled(&records)) {
+      // A chunk of nothing but corrupt lines has nothing to commit.
+      const bool committed = records.empty() || Commit(records);
+      SpillDone(committed);
+      records.clear();
+      flushed_cv_.notify_all();
+      if (committed) {
+        continue;
+      }
+      // Left in the file; retried after a pause, or on the next start.
+      if (stop_) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    if (stop_) {
+      break;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_cv_.wait_for(lock, std::chrono::milliseconds(50),
+                      [this]() { return stop_.load() || queue_.size() > 0 || spilling_.load(); });
+  }
+}
+
+void AsyncWriter::Spill(const WriteRecord &record) {
+  if (!spill_out_.is_open()) {
+    spill_out_.open(options_.spill_path, std::ios::binary | std::ios::app);
+    if (!spill_out_) {
+      spdlog::error("Failed to open spill file {}; dropping record", options_.spill_path);
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  spill_out_ << SpillToJson(record).dump() << '\n';
+  spilled_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool AsyncWriter::TakeSpilled(std::vector<WriteRecord> *records) {
+  std::lock_guard<std::mutex> lock(spill_mutex_);
+  if (spill_out_.is_open()) {
+    spill_out_.flush();
+  }
+
+  std::ifstream in(options_.spill_path, std::ios::binary);
+  in.seekg(static_cast<std::streamoff>(spill_read_));
+  std::string line;
+  size_t lines = 0;
+  while (lines < options_.max_batch && std::getline(in, line)) {
+    ++lines;
+    spill_read_ += line.size() + 1;
+    try {
+      records->push_back(SpillFromJson(nlohmann::json::parse(line)));
+    } catch (const std::exception &ex) {
+      spdlog::error("Skipping corrupt spill record: {}", ex.what());
+    }
+  }
+  in.close();
+
+  if (lines == 0) {
+    // Caught up, and every chunk read before this one is committed: producers can go
+    // back to the queue.
+    spill_out_.close();
+    std::remove(options_.spill_path.c_str());
+    std::remove(SpillPositionPath().c_str());
+    spill_read_ = 0;
+    spill_committed_ = 0;
+    spilling_ = false;
+    spdlog::info("Spill file {} replayed", options_.spill_path);
+    return false;
+  }
+
+  // Records spilled by an earlier process have no meaningful enqueue time.
+  const auto now = std::chrono::steady_clock::now();
+  for (auto &record : *records) {
+    if (record.enqueued < started_ || record.enqueued > now) {
+      record.enqueued = now;
+    }
+  }
+  return true;
+}
+
+void AsyncWriter::SpillDone(bool committed) {
+  std::lock_guard<std::mutex> lock(spill_mutex_);
+  if (!committed) {
+    spill_read_ = spill_committed_;
+    return;
+  }
+  spill_committed_ = spill_read_;
+  // A restart resumes from here instead of committing the replayed chunks again.
+  std::ofstream position(SpillPositionPath(), std::ios::trunc);
+  position << spill_committed_ << '\n';
+}
+
+void AsyncWriter::Respill(const std::vector<WriteRecord> &records) {
+  std::lock_guard<std::mutex> lock(spill_mutex_);
+  if (spill_out_.is_open()) {
+    spill_out_.close();
+  }
+  // Rewrites the file as these records followed by whatever is still unreplayed.
+  const std::string rewritten = options_.spill_path + ".tmp";
+  {
+    std::ofstream out(rewritten, std::ios::binary | std::ios::trunc);
+    for (const auto &record : records) {
+      out << SpillToJson(record).dump() << '\n';
+    }
+    std::ifstream in(options_.spill_path, std::ios::binary);
+    if (in) {
+      in.seekg(static_cast<std::streamoff>(spill_read_));
+      out << in.rdbuf();
+    }
+    if (!out) {
+      spdlog::error("Failed to re-spill {} records to {}; dropping them", records.size(), rewritten);
+      dropped_.fetch_add(records.size(), std::memory_order_relaxed);
+      return;
+    }
+  }
+  if (std::rename(rewritten.c_str(), options_.spill_path.c_str()) != 0) {
+    spdlog::error("Failed to replace spill file {}; dropping {} records", options_.spill_path, records.size());
+    dropped_.fetch_add(records.size(), std::memory_order_relaxed);
+    return;
+  }
+  std::remove(SpillPositionPath().c_str());
+  spill_read_ = 0;
+  spill_committed_ = 0;
+  spilled_.fetch_add(records.size(), std::memory_order_relaxed);
+  spilling_ = true;
+  spdlog::warn("Re-spilled {} records after a failed commit", records.size());
+}
+
+std::string AsyncWriter::SpillPositionPath() const {
+  return options_.spill_path + ".pos";
+}
+
+bool AsyncWriter::Commit(std::vector<WriteRecord> &records) {
+  WriteBatch batch;
+  batch.features.reserve(records.size());
+  // Under the spill policy a failed batch is written out again, so it is copied.
+  const bool keep = options_.policy == BackpressurePolicy::kSpill;
+  for (auto &record : records) {
+    if (keep) {
+      if (record.has_market) {
+        batch.markets.push_back({record.market, record.raw_json});
+      }
+      batch.features.push_back({record.feature, record.raw_json});
+      batch.alerts.insert(batch.alerts.end(), record.alerts.begin(), record.alerts.end());
+      continue;
+    }
+    if (record.has_market) {
+      batch.markets.push_back({std::move(record.market), record.raw_json});
+    }
+    batch.features.push_back({std::move(record.feature), record.raw_json});
+    for (auto &alert : record.alerts) {
+      batch.alerts.push_back(std::move(alert));
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const WriteStats result = store_->Write(batch);
+  commit_latency_.Record(NanosSince(start));
+
+  if (result.rows == 0) {
+    if (options_.policy == BackpressurePolicy::kSpill) {
+      spdlog::error("Persist batch of {} records failed; keeping it in the spill file", records.size());
+      return false;
+    }
+    spdlog::error("Persist batch of {} records failed; dropping it", records.size());
+    dropped_.fetch_add(records.size(), std::memory_order_relaxed);
+    return true;
+  }
+  for (const auto &record : records) {
+    drain_latency_.Record(NanosSince(record.enqueued));
+  }
+  written_.fetch_add(records.size(), std::memory_order_relaxed);
+  return true;
+}
+
+}  // namespace storage
@@ -0,0 +1,153 @@
+#include "storage/compactor.h"
+
+#include "utils/time.h"
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+namespace storage {
+
+namespace {
+
+constexpr int64_t kSecondsPerHour = 3600;
+constexpr int64_t kSecondsPerDay = 86400;
+
+}  // namespace
+
+Resolution ChooseResolution(const RetentionOptions &options, int64_t span_seconds, int limit) {
+  struct Tier {
+    Resolution resolution;
+    int64_t seconds;
+    int64_t retention;  // 0 = forever
+  };
+  const Tier tiers[] = {
+      {Resolution::kRaw, 1, options.raw_hours * kSecondsPerHour},
+      {Resolution::kMinute, 60, options.minute_days * kSecondsPerDay},
+      {Resolution::kFiveMinutes, 300, options.five_minute_days * kSecondsPerDay},
+      {Resolution::kHour, 3600, options.hour_days * kSecondsPerDay},
+  };
+  for (const Tier &tier : tiers) {
+    const bool fits = limit <= 0 || span_seconds / tier.seconds <= limit;
+    const bool retained = tier.retention == 0 || span_seconds <= tier.retention;
+    if (fits && retained) {
+      return tier.resolution;
+    }
+  }
+  return Resolution::kHour;
+}
+
+Compactor::Compactor(std::shared_ptr<SQLiteStore> store, std::shared_ptr<TimeSeriesStore> series,
+                     RetentionOptions options)
+    : store_(std::move(store)), series_(std::move(series)), options_(options) {}
+
+Compactor::~Compactor() {
+  Stop();
+}
+
+void Compactor::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (worker_.joinable() || options_.interval_seconds <= 0) {
+    return;
+  }
+  stop_ = false;
+  worker_ = std::thread([this]() { Run(); });
+}
+
+void Compactor::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void Compactor::Run() {
+  // The first pass waits a full interval too, so startup refreshes have the writer.
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!cv_.wait_for(lock, std::chrono::seconds(options_.interval_seconds), [this]() { return stop_; })) {
+    lock.unlock();
+    RunOnce();
+    lock.lock();
+  }
+}
+
+void Compactor::RunOnce() {
+  std::lock_guard<std::mutex> run_lock(run_mutex_);
+  const auto start = std::chrono::steady_clock::now();
+
+  uint64_t rolled_up = 0;
+  for (;;) {
+    const uint64_t rows = store_->RollupFeatures(options_.batch_rows);
+    rolled_up += rows;
+    if (rows < options_.batch_rows) {
+      break;
+    }
+  }
+
+  // Raw rows are only deleted once rolled up, so a failed rollup never loses history.
+  const int64_t now = utils::NowNanos();
+  uint64_t raw_deleted = 0;
+  uint64_t series_rows_deleted = 0;
+  std::vector<int64_t> released;
+  if (options_.raw_hours > 0) {
+    const int64_t raw_horizon = now - options_.raw_hours * kSecondsPerHour * utils::kNanosPerSecond;
+    raw_deleted = store_->PruneFeatures(raw_horizon, &released);
+    // Whole segments only, so the series keeps up to one segment past the horizon.
+    if (series_) {
+      series_rows_deleted = series_->DropBefore(raw_horizon);
+    }
+  }
+  // Payloads are shared between rows, so they are collected after the rows go. Every
+  // markets row is written with a feature row carrying the same payload, so only the
+  // payloads of deleted feature rows can have lost their last reference.
+  uint64_t payloads_deleted = 0;
+  if (raw_deleted > 0 && !released.empty()) {
+    payloads_deleted = store_->PrunePayloads(released);
+  }
+  uint64_t bars_deleted = 0;
+  const std::pair<Resolution, int> bar_retention[] = {
+      {Resolution::kMinute, options_.minute_days},
+      {Resolution::kFiveMinutes, options_.five_minute_days},
+      {Resolution::kHour, options_.hour_days},
+  };
+  for (const auto &entry : bar_retention) {
+    if (entry.second > 0) {
+      bars_deleted += store_->PruneBars(entry.first, now - entry.second * kSecondsPerDay * utils::kNanosPerSecond);
+    }
+  }
+
+  const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+  runs_.fetch_add(1, std::memory_order_relaxed);
+  rolled_up_.fetch_add(rolled_up, std::memory_order_relaxed);
+  raw_deleted_.fetch_add(raw_deleted, std::memory_order_relaxed);
+  series_rows_deleted_.fetch_add(series_rows_deleted, std::memory_order_relaxed);
+  bars_deleted_.fetch_add(bars_deleted, std::memory_order_relaxed);
+  payloads_deleted_.fetch_add(payloads_deleted, std::memory_order_relaxed);
+  last_run_nanos_.store(static_cast<uint64_t>(nanos.count()), std::memory_order_relaxed);
+  if (rolled_up > 0 || raw_deleted > 0 || series_rows_deleted > 0 || bars_deleted > 0) {
+    spdlog::info(
+        "Compaction: rolled up {} raw rows, deleted {} raw rows, {} series rows, {} payloads and {} bars in {:.2f}s",
+        rolled_up, raw_deleted, series_rows_deleted, payloads_deleted, bars_deleted,
+        std::chrono::duration<double>(nanos).count());
+  }
+}
+
+CompactionStats Compactor::stats() const {
+  CompactionStats stats;
+  stats.runs = runs_.load(std::memory_order_relaxed);
+  stats.rolled_up = rolled_up_.load(std::memory_order_relaxed);
+  stats.raw_deleted = raw_deleted_.load(std::memory_order_relaxed);
+  stats.series_rows_deleted = series_rows_deleted_.load(std::memory_order_relaxed);
+  stats.bars_deleted = bars_deleted_.load(std::memory_order_relaxed);
+  stats.payloads_deleted = payloads_deleted_.load(std::memory_order_relaxed);
+  stats.last_run_seconds = last_run_nanos_.load(std::memory_order_relaxed) / 1e9;
+  return stats;
+}
+
+}  // namespace storage
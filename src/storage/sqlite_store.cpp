@@ -2,21 +2,541 @@
 
 #include <spdlog/spdlog.h>
 
+#include "analytics/ticker_registry.h"
+#include "utils/compression.h"
+#include "utils/time.h"
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
 #include <stdexcept>
+#include <utility>
 
 namespace storage {
 
-SQLiteStore::SQLiteStore(const std::string &path) : path_(path) {
-  if (sqlite3_open(path_.c_str(), &db_) != SQLITE_OK) {
+namespace {
+
+struct Migration {
+  int version;
+  const char *description;
+  std::vector<const char *> statements;
+};
+
+// Keep markets_fts in step with markets; recreated whenever markets is rebuilt.
+constexpr char kMarketsFtsInsertTrigger[] =
+    "CREATE TRIGGER IF NOT EXISTS markets_fts_insert AFTER INSERT ON markets BEGIN"
+    " INSERT INTO markets_fts(rowid, ticker, event_ticker, category)"
+    " VALUES (new.rowid, new.ticker, new.event_ticker, new.category);"
+    " END";
+constexpr char kMarketsFtsDeleteTrigger[] =
+    "CREATE TRIGGER IF NOT EXISTS markets_fts_delete AFTER DELETE ON markets BEGIN"
+    " INSERT INTO markets_fts(markets_fts, rowid, ticker, event_ticker, category)"
+    " VALUES ('delete', old.rowid, old.ticker, old.event_ticker, old.category);"
+    " END";
+// Upserts rewrite every column; only reindex when a searched one changed.
+constexpr char kMarketsFtsUpdateTrigger[] =
+    "CREATE TRIGGER IF NOT EXISTS markets_fts_update AFTER UPDATE OF ticker, event_ticker, category ON markets"
+    " WHEN old.ticker IS NOT new.ticker OR old.event_ticker IS NOT new.event_ticker"
+    " OR old.category IS NOT new.category BEGIN"
+    " INSERT INTO markets_fts(markets_fts, rowid, ticker, event_ticker, category)"
+    " VALUES ('delete', old.rowid, old.ticker, old.event_ticker, old.category);"
+    " INSERT INTO markets_fts(rowid, ticker, event_ticker, category)"
+    " VALUES (new.rowid, new.ticker, new.event_ticker, new.category);"
+    " END";
+
+// Keep event_summaries in step with markets, so /events never aggregates markets.
+// Aggregates are keyed by (event_ticker, category), with a NULL category counted as
+// ''; markets without an event are not summarised. Removing a market only rescans its
+// event (through idx_markets_event) when it held the event's latest updated_at.
+constexpr char kEventSummariesInsertTrigger[] =
+    "CREATE TRIGGER IF NOT EXISTS event_summaries_insert AFTER INSERT ON markets"
+    " WHEN new.event_ticker != '' BEGIN"
+    " INSERT INTO event_summaries (event_ticker, category, market_count, total_volume, updated_at)"
+    " VALUES (new.event_ticker, COALESCE(new.category, ''), 1, COALESCE(new.volume, 0), new.updated_at)"
+    " ON CONFLICT (event_ticker, category) DO UPDATE SET market_count = market_count + 1,"
+    " total_volume = total_volume + excluded.total_volume, updated_at = max(updated_at, excluded.updated_at);"
+    " END";
+constexpr char kEventSummariesDeleteTrigger[] =
+    "CREATE TRIGGER IF NOT EXISTS event_summaries_delete AFTER DELETE ON markets"
+    " WHEN old.event_ticker != '' BEGIN"
+    " UPDATE event_summaries SET market_count = market_count - 1,"
+    " total_volume = total_volume - COALESCE(old.volume, 0),"
+    " updated_at = CASE WHEN old.updated_at < updated_at THEN updated_at ELSE COALESCE((SELECT MAX(updated_at)"
+    " FROM markets WHERE event_ticker = old.event_ticker AND COALESCE(category, '') = COALESCE(old.category, '')),"
+    " 0) END"
+    " WHERE event_ticker = old.event_ticker AND category = COALESCE(old.category, '');"
+    " DELETE FROM event_summaries WHERE event_ticker = old.event_ticker AND category = COALESCE(old.category, '')"
+    " AND market_count <= 0;"
+    " END";
+// Upserts rewrite every column; a market that stays in its event only adjusts the
+// volume and latest update in place.
+constexpr char kEventSummariesUpdateTrigger[] =
+    "CREATE TRIGGER IF NOT EXISTS event_summaries_update AFTER UPDATE OF volume, updated_at ON markets"
+    " WHEN new.event_ticker != '' AND old.event_ticker IS new.event_ticker AND old.category IS new.category"
+    " AND (old.volume IS NOT new.volume OR old.updated_at IS NOT new.updated_at) BEGIN"
+    " UPDATE event_summaries SET total_volume = total_volume + COALESCE(new.volume, 0) - COALESCE(old.volume, 0),"
+    " updated_at = CASE WHEN new.updated_at >= updated_at THEN new.updated_at"
+    " WHEN old.updated_at < updated_at THEN updated_at ELSE (SELECT MAX(updated_at)"
+    " FROM markets WHERE event_ticker = new.event_ticker AND COALESCE(category, '') = COALESCE(new.category, ''))"
+    " END"
+    " WHERE event_ticker = new.event_ticker AND category = COALESCE(new.category, '');"
+    " END";
+// A market that changes event or category leaves one summary and joins another.
+constexpr char kEventSummariesMoveTrigger[] =
+    "CREATE TRIGGER IF NOT EXISTS event_summaries_move AFTER UPDATE OF event_ticker, category ON markets"
+    " WHEN old.event_ticker IS NOT new.event_ticker OR old.category IS NOT new.category BEGIN"
+    " UPDATE event_summaries SET market_count = market_count - 1,"
+    " total_volume = total_volume - COALESCE(old.volume, 0),"
+    " updated_at = CASE WHEN old.updated_at < updated_at THEN updated_at ELSE COALESCE((SELECT MAX(updated_at)"
+    " FROM markets WHERE event_ticker = old.event_ticker AND COALESCE(category, '') = COALESCE(old.category, '')),"
+    " 0) END"
+    " WHERE event_ticker = old.event_ticker AND category = COALESCE(old.category, '');"
+    " DELETE FROM event_summaries WHERE event_ticker = old.event_ticker AND category = COALESCE(old.category, '')"
+    " AND market_count <= 0;"
+    " INSERT INTO event_summaries (event_ticker, category, market_count, total_volume, updated_at)"
+    " SELECT new.event_ticker, COALESCE(new.category, ''), 1, COALESCE(new.volume, 0), new.updated_at"
+    " WHERE new.event_ticker != ''"
+    " ON CONFLICT (event_ticker, category) DO UPDATE SET market_count = market_count + 1,"
+    " total_volume = total_volume + excluded.total_volume, updated_at = max(updated_at, excluded.updated_at);"
+    " END";
+
+// Applied in order, each in its own transaction; a database records the last one it
+// has in PRAGMA user_version. Append new steps, never edit shipped ones.
+const std::vector<Migration> &Migrations() {
+  static const std::vector<Migration> migrations = {
+      {1,
+       "query indexes",
+       {
+           // LatestFeatures seeks to the ticker and walks id backwards for LIMIT rows.
+           "CREATE INDEX IF NOT EXISTS idx_features_ticker_id ON features(ticker, id)",
+           // ListMarkets without a search reads the newest rows straight off the index.
+           "CREATE INDEX IF NOT EXISTS idx_markets_updated_at ON markets(updated_at)",
+           // Covers ListEvents, so grouping never touches the (raw_json heavy) table.
+           "CREATE INDEX IF NOT EXISTS idx_markets_event"
+           " ON markets(event_ticker, category, volume, updated_at)",
+       }},
+      {2,
+       "trigram search index",
+       {
+           // External content: the index stores trigrams only and reads columns back
+           // from markets by rowid. markets has no INTEGER PRIMARY KEY, so a VACUUM may
+           // renumber rows and must be followed by a 'rebuild'.
+           "CREATE VIRTUAL TABLE IF NOT EXISTS markets_fts USING fts5("
+           "ticker, event_ticker, category, content='markets', content_rowid='rowid', tokenize='trigram')",
+           kMarketsFtsInsertTrigger,
+           kMarketsFtsDeleteTrigger,
+           kMarketsFtsUpdateTrigger,
+           "INSERT INTO markets_fts(markets_fts) VALUES ('rebuild')",
+       }},
+      {3,
+       "feature rollups",
+       {
+           "CREATE TABLE IF NOT EXISTS features_1m ("
+           "ticker TEXT NOT NULL, bucket INTEGER NOT NULL, open REAL, high REAL, low REAL, close REAL,"
+           " spread REAL, prob REAL, volume REAL, volume_delta REAL, samples INTEGER,"
+           " PRIMARY KEY (ticker, bucket)) WITHOUT ROWID",
+           "CREATE TABLE IF NOT EXISTS features_5m ("
+           "ticker TEXT NOT NULL, bucket INTEGER NOT NULL, open REAL, high REAL, low REAL, close REAL,"
+           " spread REAL, prob REAL, volume REAL, volume_delta REAL, samples INTEGER,"
+           " PRIMARY KEY (ticker, bucket)) WITHOUT ROWID",
+           "CREATE TABLE IF NOT EXISTS features_1h ("
+           "ticker TEXT NOT NULL, bucket INTEGER NOT NULL, open REAL, high REAL, low REAL, close REAL,"
+           " spread REAL, prob REAL, volume REAL, volume_delta REAL, samples INTEGER,"
+           " PRIMARY KEY (ticker, bucket)) WITHOUT ROWID",
+           // Retention deletes by age.
+           "CREATE INDEX IF NOT EXISTS idx_features_ts ON features(ts)",
+           "CREATE INDEX IF NOT EXISTS idx_features_1m_bucket ON features_1m(bucket)",
+           "CREATE INDEX IF NOT EXISTS idx_features_5m_bucket ON features_5m(bucket)",
+           "CREATE INDEX IF NOT EXISTS idx_features_1h_bucket ON features_1h(bucket)",
+           // Highest features.id already folded into the rollups.
+           "CREATE TABLE IF NOT EXISTS rollup_state (id INTEGER PRIMARY KEY CHECK (id = 1), last_feature_id INTEGER)",
+           "INSERT OR IGNORE INTO rollup_state (id, last_feature_id) VALUES (1, 0)",
+       }},
+      {4,
+       "deduplicated payloads",
+       {
+           // hash is the first 8 bytes of the payload's SHA-256; codec names the
+           // compression dictionary (kPayloadCodec).
+           "CREATE TABLE IF NOT EXISTS payloads ("
+           "hash INTEGER PRIMARY KEY, codec INTEGER NOT NULL, size INTEGER NOT NULL, data BLOB NOT NULL)",
+           // raw_json stays as a (NULL) column so older binaries can still open the file.
+           "ALTER TABLE markets ADD COLUMN payload_hash INTEGER",
+           "ALTER TABLE features ADD COLUMN payload_hash INTEGER",
+       }},
+      {5,
+       "integer tickers and timestamps",
+       {
+           // Tickers are interned: rows carry tickers.id, and timestamps become unix
+           // nanoseconds (iso8601_nanos is registered on the writer connection).
+           "CREATE TABLE IF NOT EXISTS tickers (id INTEGER PRIMARY KEY, ticker TEXT NOT NULL UNIQUE)",
+           "INSERT OR IGNORE INTO tickers (ticker)"
+           " SELECT ticker FROM markets WHERE ticker IS NOT NULL"
+           " UNION SELECT ticker FROM features WHERE ticker IS NOT NULL"
+           " UNION SELECT ticker FROM alerts WHERE ticker IS NOT NULL"
+           " UNION SELECT ticker FROM features_1m UNION SELECT ticker FROM features_5m"
+           " UNION SELECT ticker FROM features_1h"
+           " ORDER BY 1",
+
+           // markets keeps the ticker text for search; ticker_id doubles as the rowid,
+           // so VACUUM no longer renumbers the rows markets_fts points at.
+           "DROP TRIGGER IF EXISTS markets_fts_insert",
+           "DROP TRIGGER IF EXISTS markets_fts_delete",
+           "DROP TRIGGER IF EXISTS markets_fts_update",
+           "CREATE TABLE markets_v5 ("
+           "ticker_id INTEGER PRIMARY KEY, ticker TEXT NOT NULL, event_ticker TEXT, status TEXT, category TEXT,"
+           " yes_bid REAL, yes_ask REAL, last_price REAL, volume REAL, updated_at INTEGER, payload_hash INTEGER)",
+           "INSERT INTO markets_v5 SELECT t.id, m.ticker, m.event_ticker, m.status, m.category, m.yes_bid, m.yes_ask,"
+           " m.last_price, m.volume, COALESCE(iso8601_nanos(m.updated_at), 0), m.payload_hash"
+           " FROM markets m JOIN tickers t ON t.ticker = m.ticker",
+           "DROP TABLE markets",
+           "ALTER TABLE markets_v5 RENAME TO markets",
+           "CREATE INDEX idx_markets_updated_at ON markets(updated_at)",
+           "CREATE INDEX idx_markets_event ON markets(event_ticker, category, volume, updated_at)",
+           kMarketsFtsInsertTrigger,
+           kMarketsFtsDeleteTrigger,
+           kMarketsFtsUpdateTrigger,
+           "INSERT INTO markets_fts(markets_fts) VALUES ('rebuild')",
+
+           // The inline raw_json column (NULL since migration 4) is dropped with the rebuild.
+           "CREATE TABLE features_v5 ("
+           "id INTEGER PRIMARY KEY AUTOINCREMENT, ticker_id INTEGER NOT NULL, ts INTEGER NOT NULL,"
+           " mid REAL, spread REAL, prob REAL, volume REAL,"
+           " bid_depth REAL, ask_depth REAL, imbalance REAL, microprice REAL, payload_hash INTEGER)",
+           "INSERT INTO features_v5 SELECT f.id, t.id, COALESCE(iso8601_nanos(f.ts), 0), f.mid, f.spread, f.prob,"
+           " f.volume, f.bid_depth, f.ask_depth, f.imbalance, f.microprice, f.payload_hash"
+           " FROM features f JOIN tickers t ON t.ticker = f.ticker",
+           "DROP TABLE features",
+           "ALTER TABLE features_v5 RENAME TO features",
+           // New ids must stay above the rollup watermark even if the newest rows were pruned.
+           "INSERT INTO sqlite_sequence (name, seq) SELECT 'features', 0"
+           " WHERE NOT EXISTS (SELECT 1 FROM sqlite_sequence WHERE name = 'features')",
+           "UPDATE sqlite_sequence SET seq = max(seq, (SELECT last_feature_id FROM rollup_state WHERE id = 1))"
+           " WHERE name = 'features'",
+           "CREATE INDEX idx_features_ticker_id ON features(ticker_id, id)",
+           "CREATE INDEX idx_features_ts ON features(ts)",
+
+           "CREATE TABLE alerts_v5 ("
+           "id INTEGER PRIMARY KEY AUTOINCREMENT, ticker_id INTEGER NOT NULL, ts INTEGER NOT NULL,"
+           " type TEXT, score REAL, details TEXT)",
+           "INSERT INTO alerts_v5 SELECT a.id, t.id, COALESCE(iso8601_nanos(a.ts), 0), a.type, a.score, a.details"
+           " FROM alerts a JOIN tickers t ON t.ticker = a.ticker",
+           "DROP TABLE alerts",
+           "ALTER TABLE alerts_v5 RENAME TO alerts",
+
+           // Bucket starts move from seconds to nanoseconds with the rest.
+           "CREATE TABLE features_1m_v5 ("
+           "ticker_id INTEGER NOT NULL, bucket INTEGER NOT NULL, open REAL, high REAL, low REAL, close REAL,"
+           " spread REAL, prob REAL, volume REAL, volume_delta REAL, samples INTEGER,"
+           " PRIMARY KEY (ticker_id, bucket)) WITHOUT ROWID",
+           "INSERT INTO features_1m_v5 SELECT t.id, b.bucket * 1000000000, b.open, b.high, b.low, b.close, b.spread,"
+           " b.prob, b.volume, b.volume_delta, b.samples FROM features_1m b JOIN tickers t ON t.ticker = b.ticker",
+           "DROP TABLE features_1m",
+           "ALTER TABLE features_1m_v5 RENAME TO features_1m",
+           "CREATE INDEX idx_features_1m_bucket ON features_1m(bucket)",
+           "CREATE TABLE features_5m_v5 ("
+           "ticker_id INTEGER NOT NULL, bucket INTEGER NOT NULL, open REAL, high REAL, low REAL, close REAL,"
+           " spread REAL, prob REAL, volume REAL, volume_delta REAL, samples INTEGER,"
+           " PRIMARY KEY (ticker_id, bucket)) WITHOUT ROWID",
+           "INSERT INTO features_5m_v5 SELECT t.id, b.bucket * 1000000000, b.open, b.high, b.low, b.close, b.spread,"
+           " b.prob, b.volume, b.volume_delta, b.samples FROM features_5m b JOIN tickers t ON t.ticker = b.ticker",
+           "DROP TABLE features_5m",
+           "ALTER TABLE features_5m_v5 RENAME TO features_5m",
+           "CREATE INDEX idx_features_5m_bucket ON features_5m(bucket)",
+           "CREATE TABLE features_1h_v5 ("
+           "ticker_id INTEGER NOT NULL, bucket INTEGER NOT NULL, open REAL, high REAL, low REAL, close REAL,"
+           " spread REAL, prob REAL, volume REAL, volume_delta REAL, samples INTEGER,"
+           " PRIMARY KEY (ticker_id, bucket)) WITHOUT ROWID",
+           "INSERT INTO features_1h_v5 SELECT t.id, b.bucket * 1000000000, b.open, b.high, b.low, b.close, b.spread,"
+           " b.prob, b.volume, b.volume_delta, b.samples FROM features_1h b JOIN tickers t ON t.ticker = b.ticker",
+           "DROP TABLE features_1h",
+           "ALTER TABLE features_1h_v5 RENAME TO features_1h",
+           "CREATE INDEX idx_features_1h_bucket ON features_1h(bucket)",
+       }},
+      {6,
+       "event summaries",
+       {
+           "CREATE TABLE IF NOT EXISTS event_summaries ("
+           "event_ticker TEXT NOT NULL, category TEXT NOT NULL, market_count INTEGER NOT NULL,"
+           " total_volume REAL NOT NULL, updated_at INTEGER NOT NULL,"
+           " PRIMARY KEY (event_ticker, category)) WITHOUT ROWID",
+           // ListEvents reads the newest summaries straight off this index.
+           "CREATE INDEX IF NOT EXISTS idx_event_summaries_updated_at ON event_summaries(updated_at)",
+           "INSERT INTO event_summaries (event_ticker, category, market_count, total_volume, updated_at)"
+           " SELECT event_ticker, COALESCE(category, ''), COUNT(*), COALESCE(SUM(volume), 0),"
+           " COALESCE(MAX(updated_at), 0) FROM markets WHERE event_ticker != ''"
+           " GROUP BY event_ticker, COALESCE(category, '')",
+           kEventSummariesInsertTrigger,
+           kEventSummariesDeleteTrigger,
+           kEventSummariesUpdateTrigger,
+           kEventSummariesMoveTrigger,
+       }},
+      {7,
+       "payload reference indexes",
+       {
+           // PrunePayloads probes these for each payload a compaction pass released.
+           "CREATE INDEX IF NOT EXISTS idx_features_payload ON features(payload_hash) WHERE payload_hash IS NOT NULL",
+           "CREATE INDEX IF NOT EXISTS idx_markets_payload ON markets(payload_hash) WHERE payload_hash IS NOT NULL",
+       }},
+  };
+  return migrations;
+}
+
+constexpr int kSearchIndexVersion = 2;
+constexpr int kPayloadVersion = 4;
+constexpr int kEventSummariesVersion = 6;
+
+// Preset dictionary for payload compression: a Kalshi /markets entry with the values
+// blanked, so every document starts with its keys already in the window. Changing it
+// needs a new kPayloadCodec, since stored payloads only inflate with the original.
+constexpr int kPayloadCodec = 1;
+constexpr char kPayloadDictionary[] =
+    "{\"ticker\": \"\", \"event_ticker\": \"\", \"status\": \"open\", \"category\": \"\", "
+    "\"yes_bid\": , \"yes_ask\": , \"last_price\": , \"volume\": }"
+    "{\"ticker\":\"\",\"event_ticker\":\"\",\"market_type\":\"binary\",\"title\":\"\",\"subtitle\":\"\","
+    "\"yes_sub_title\":\"\",\"no_sub_title\":\"\",\"open_time\":\"2025-01-01T00:00:00Z\",\"close_time\":\"\","
+    "\"expected_expiration_time\":\"\",\"expiration_time\":\"\",\"latest_expiration_time\":\"\","
+    "\"settlement_timer_seconds\":,\"status\":\"active\",\"response_price_units\":\"usd_cent\","
+    "\"notional_value\":100,\"notional_value_dollars\":\"1.0000\",\"tick_size\":1,"
+    "\"previous_yes_bid\":,\"previous_yes_bid_dollars\":\"0.\",\"previous_yes_ask\":,"
+    "\"previous_yes_ask_dollars\":\"0.\",\"previous_price\":,\"previous_price_dollars\":\"0.\","
+    "\"volume_24h\":,\"liquidity\":,\"liquidity_dollars\":\"\",\"open_interest\":,\"result\":\"\","
+    "\"can_close_early\":true,\"expiration_value\":\"\",\"category\":\"\",\"risk_limit_cents\":0,"
+    "\"strike_type\":\"\",\"floor_strike\":,\"cap_strike\":,\"rules_primary\":\"If \",\"rules_secondary\":\"\","
+    "\"settlement_value\":,\"price_level_structure\":\"linear_cent\","
+    "\"price_ranges\":[{\"start\":\"0.0000\",\"end\":\"1.0000\",\"step\":\"0.0100\"}],"
+    "\"no_bid\":,\"no_bid_dollars\":\"0.\",\"no_ask\":,\"no_ask_dollars\":\"0.\","
+    "\"yes_bid\":,\"yes_bid_dollars\":\"0.\",\"yes_ask\":,\"yes_ask_dollars\":\"0.\","
+    "\"last_price\":,\"last_price_dollars\":\"0.\",\"volume\":,";
+
+// SQL function for migration 5: ISO-8601 text to unix nanoseconds, NULL when unparseable.
+void Iso8601NanosFunction(sqlite3_context *context, int, sqlite3_value **argv) {
+  const auto *text = reinterpret_cast<const char *>(sqlite3_value_text(argv[0]));
+  int64_t nanos = 0;
+  if (text && utils::ParseIso8601(text, &nanos)) {
+    sqlite3_result_int64(context, nanos);
+  } else {
+    sqlite3_result_null(context);
+  }
+}
+
+// Hashes cached as present before the cache is dropped and rebuilt from lookups.
+constexpr size_t kKnownPayloadLimit = 1 << 20;
+
+int64_t ContentHash(std::string_view data) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  EVP_Digest(data.data(), data.size(), digest, &length, EVP_sha256(), nullptr);
+  uint64_t hash = 0;
+  for (int i = 0; i < 8; ++i) {
+    hash = (hash << 8) | digest[i];
+  }
+  // 0 means "no payload".
+  return hash == 0 ? 1 : static_cast<int64_t>(hash);
+}
+
+struct RollupTier {
+  Resolution resolution;
+  int seconds;
+  const char *table;
+};
+
+constexpr RollupTier kRollupTiers[] = {
+    {Resolution::kMinute, 60, "features_1m"},
+    {Resolution::kFiveMinutes, 300, "features_5m"},
+    {Resolution::kHour, 3600, "features_1h"},
+};
+
+const RollupTier *FindTier(Resolution resolution) {
+  for (const RollupTier &tier : kRollupTiers) {
+    if (tier.resolution == resolution) {
+      return &tier;
+    }
+  }
+  return nullptr;
+}
+
+// Floor division, so buckets before 1970 still start on a boundary.
+int64_t BucketStart(int64_t nanos, int64_t width) {
+  const int64_t bucket = nanos / width * width;
+  return bucket > nanos ? bucket - width : bucket;
+}
+
+struct BarAccumulator {
+  double open = 0.0;
+  double high = 0.0;
+  double low = 0.0;
+  double close = 0.0;
+  double spread = 0.0;
+  double prob = 0.0;
+  double volume = 0.0;
+  double volume_delta = 0.0;
+  int samples = 0;
+
+  void Add(double mid, double row_spread, double row_prob, double row_volume, double delta) {
+    if (samples == 0) {
+      open = high = low = mid;
+    }
+    high = std::max(high, mid);
+    low = std::min(low, mid);
+    close = mid;
+    spread = row_spread;
+    prob = row_prob;
+    volume = row_volume;
+    volume_delta += delta;
+    ++samples;
+  }
+};
+
+// The trigram tokenizer cannot match substrings shorter than three characters.
+bool UseTrigramIndex(const std::string &search) {
+  size_t characters = 0;
+  for (const unsigned char c : search) {
+    characters += (c & 0xC0) != 0x80;
+  }
+  return characters >= 3;
+}
+
+// An FTS5 phrase, so the term matches as a literal substring.
+std::string PhraseQuery(const std::string &search) {
+  std::string phrase = "\"";
+  for (const char c : search) {
+    phrase.push_back(c);
+    if (c == '"') {
+      phrase.push_back('"');
+    }
+  }
+  phrase.push_back('"');
+  return phrase;
+}
+
+}  // namespace
+
+bool ParseResolution(const std::string &name, Resolution *resolution) {
+  static const std::pair<const char *, Resolution> kNames[] = {
+      {"auto", Resolution::kAuto},   {"raw", Resolution::kRaw}, {"1m", Resolution::kMinute},
+      {"5m", Resolution::kFiveMinutes}, {"1h", Resolution::kHour},
+  };
+  for (const auto &entry : kNames) {
+    if (name == entry.first) {
+      *resolution = entry.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *ResolutionName(Resolution resolution) {
+  switch (resolution) {
+    case Resolution::kAuto:
+      return "auto";
+    case Resolution::kRaw:
+      return "raw";
+    case Resolution::kMinute:
+      return "1m";
+    case Resolution::kFiveMinutes:
+      return "5m";
+    case Resolution::kHour:
+      return "1h";
+  }
+  return "unknown";
+}
+
+int ResolutionSeconds(Resolution resolution) {
+  const RollupTier *tier = FindTier(resolution);
+  return tier ? tier->seconds : 0;
+}
+
+sqlite3_stmt *SQLiteStore::Connection::Statement(const std::string &sql) {
+  auto iter = statements.find(sql);
+  if (iter != statements.end()) {
+    return iter->second;
+  }
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v3(db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+    spdlog::error("SQLite prepare failed: {}", sqlite3_errmsg(db));
+    return nullptr;
+  }
+  statements.emplace(sql, stmt);
+  return stmt;
+}
+
+void SQLiteStore::Connection::Close() {
+  for (auto &entry : statements) {
+    sqlite3_finalize(entry.second);
+  }
+  statements.clear();
+  if (db) {
+    sqlite3_close(db);
+    db = nullptr;
+  }
+}
+
+SQLiteStore::ReadLease::ReadLease(const SQLiteStore &store) : store_(store) {
+  if (store_.readers_.empty()) {
+    writer_lock_ = std::unique_lock<std::mutex>(store_.mutex_);
+    connection_ = &store_.writer_;
+    return;
+  }
+  std::unique_lock<std::mutex> lock(store_.readers_mutex_);
+  store_.readers_cv_.wait(lock, [this]() { return !store_.idle_readers_.empty(); });
+  connection_ = store_.idle_readers_.back();
+  store_.idle_readers_.pop_back();
+}
+
+SQLiteStore::ReadLease::~ReadLease() {
+  if (writer_lock_.owns_lock()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(store_.readers_mutex_);
+    store_.idle_readers_.push_back(connection_);
+  }
+  store_.readers_cv_.notify_one();
+}
+
+SQLiteStore::SQLiteStore(const std::string &path, SQLiteStoreOptions options)
+    : path_(path),
+      options_(options),
+      payload_codec_(std::make_unique<utils::DictionaryCompressor>(
+          std::string(kPayloadDictionary, sizeof(kPayloadDictionary) - 1))) {
+  if (sqlite3_open(path_.c_str(), &writer_.db) != SQLITE_OK) {
+    writer_.Close();
     throw std::runtime_error("Failed to open sqlite db");
   }
-  sqlite3_busy_timeout(db_, 5000);
+  sqlite3_busy_timeout(writer_.db, 5000);
+  sqlite3_create_function_v2(writer_.db, "iso8601_nanos", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                             Iso8601NanosFunction, nullptr, nullptr, nullptr);
+
+  const bool in_memory = path_.empty() || path_ == ":memory:";
+  if (options_.wal && !in_memory) {
+    // NORMAL is durable across application crashes in WAL mode; only an OS crash can
+    // lose the last commits.
+    Exec("PRAGMA journal_mode=WAL");
+    Exec("PRAGMA synchronous=NORMAL");
+  }
+
+  for (int i = 0; !in_memory && i < options_.read_connections; ++i) {
+    auto reader = std::make_unique<Connection>();
+    // Each reader is leased to one thread at a time, so SQLite's own mutex is redundant.
+    if (sqlite3_open_v2(path_.c_str(), &reader->db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) !=
+        SQLITE_OK) {
+      spdlog::error("Failed to open read connection: {}", sqlite3_errmsg(reader->db));
+      reader->Close();
+      break;
+    }
+    sqlite3_busy_timeout(reader->db, 5000);
+    idle_readers_.push_back(reader.get());
+    readers_.push_back(std::move(reader));
+  }
 }
 
 SQLiteStore::~SQLiteStore() {
-  if (db_) {
-    sqlite3_close(db_);
+  for (auto &reader : readers_) {
+    reader->Close();
   }
+  writer_.Close();
 }
 
 void SQLiteStore::Init() {
@@ -41,9 +561,19 @@ void SQLiteStore::Init() {
        "spread REAL,"
        "prob REAL,"
        "volume REAL,"
-       "raw_json TEXT"
+       "raw_json TEXT,"
+       "bid_depth REAL,"
+       "ask_depth REAL,"
+       "imbalance REAL,"
+       "microprice REAL"
        ");");
 
+  // Databases created before orderbook features existed.
+  AddColumnIfMissing("features", "bid_depth", "REAL");
+  AddColumnIfMissing("features", "ask_depth", "REAL");
+  AddColumnIfMissing("features", "imbalance", "REAL");
+  AddColumnIfMissing("features", "microprice", "REAL");
+
   Exec("CREATE TABLE IF NOT EXISTS alerts ("
        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
        "ticker TEXT,"
@@ -52,14 +582,439 @@ void SQLiteStore::Init() {
        "score REAL,"
        "details TEXT"
        ");");
+
+  Migrate();
+  LoadTickers();
 }
 
-void SQLiteStore::UpsertMarket(const analytics::MarketSnapshot &snapshot, const std::string &raw_json) {
+void SQLiteStore::LoadTickers() {
   std::lock_guard<std::mutex> lock(mutex_);
-  const char *sql =
-      "INSERT INTO markets (ticker, event_ticker, status, category, yes_bid, yes_ask, last_price, volume, updated_at, raw_json)"
-      " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
-      " ON CONFLICT(ticker) DO UPDATE SET"
+  sqlite3_stmt *stmt = writer_.Statement("SELECT id, ticker FROM tickers ORDER BY id");
+  if (!stmt) {
+    spdlog::error("Failed to prepare ticker load");
+    return;
+  }
+  auto &registry = analytics::TickerRegistry::Global();
+  size_t loaded = 0;
+  std::string conflict;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const auto id = static_cast<analytics::TickerId>(sqlite3_column_int64(stmt, 0));
+    const auto *ticker = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    if (!ticker || !registry.Adopt(id, ticker)) {
+      conflict = ticker ? ticker : "";
+      break;
+    }
+    persisted_tickers_ = std::max(persisted_tickers_, id);
+    ++loaded;
+  }
+  sqlite3_reset(stmt);
+  if (!conflict.empty()) {
+    throw std::runtime_error("Ticker id of " + conflict + " in " + path_ + " conflicts with one already interned");
+  }
+  spdlog::info("Loaded {} ticker ids", loaded);
+}
+
+bool SQLiteStore::PersistTickersLocked(analytics::TickerId *through) {
+  const auto &registry = analytics::TickerRegistry::Global();
+  const analytics::TickerId last = registry.max_id();
+  *through = persisted_tickers_;
+  if (last <= persisted_tickers_) {
+    return true;
+  }
+  sqlite3_stmt *stmt = writer_.Statement("INSERT OR IGNORE INTO tickers (id, ticker) VALUES (?, ?)");
+  if (!stmt) {
+    return false;
+  }
+  for (analytics::TickerId id = persisted_tickers_ + 1; id <= last; ++id) {
+    const std::string &ticker = registry.Name(id);
+    if (ticker.empty()) {
+      continue;
+    }
+    sqlite3_bind_int64(stmt, 1, id);
+    sqlite3_bind_text(stmt, 2, ticker.c_str(), static_cast<int>(ticker.size()), SQLITE_STATIC);
+    const bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_reset(stmt);
+    if (!ok) {
+      spdlog::error("Failed to persist ticker {}: {}", ticker, sqlite3_errmsg(writer_.db));
+      return false;
+    }
+  }
+  *through = last;
+  return true;
+}
+
+int64_t SQLiteStore::QueryInt(const std::string &sql) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(writer_.db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    spdlog::error("Failed to prepare {}: {}", sql, sqlite3_errmsg(writer_.db));
+    return 0;
+  }
+  const int64_t value = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+  sqlite3_finalize(stmt);
+  return value;
+}
+
+uint64_t SQLiteStore::DatabaseBytes() const {
+  return static_cast<uint64_t>(QueryInt("PRAGMA page_count") * QueryInt("PRAGMA page_size"));
+}
+
+void SQLiteStore::Migrate() {
+  int version = static_cast<int>(QueryInt("PRAGMA user_version"));
+  for (const Migration &migration : Migrations()) {
+    if (migration.version <= version) {
+      continue;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t bytes_before = DatabaseBytes();
+    uint64_t moved = 0;
+    bool ok = Exec("BEGIN IMMEDIATE");
+    for (size_t i = 0; ok && i < migration.statements.size(); ++i) {
+      ok = Exec(migration.statements[i]);
+    }
+    if (ok && migration.version == kPayloadVersion) {
+      ok = MigratePayloads(&moved);
+    }
+    ok = ok && Exec("PRAGMA user_version = " + std::to_string(migration.version)) && Exec("COMMIT");
+    if (!ok) {
+      Exec("ROLLBACK");
+      // Later steps may depend on this one; retried on the next start.
+      spdlog::warn("Schema migration {} ({}) failed; staying at version {}", migration.version,
+                   migration.description, version);
+      break;
+    }
+    version = migration.version;
+    const auto millis =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Applied schema migration {} ({}) in {}ms", version, migration.description, millis);
+
+    if (moved > 0) {
+      // Freed pages are only returned to the filesystem by a VACUUM, which may also
+      // renumber markets rows, so the external-content search index is rebuilt after.
+      Exec("VACUUM");
+      Exec("INSERT INTO markets_fts(markets_fts) VALUES ('rebuild')");
+      Exec("PRAGMA wal_checkpoint(TRUNCATE)");
+      spdlog::info("Database size {:.1f} MB -> {:.1f} MB after moving {} inline payloads", bytes_before / 1e6,
+                   DatabaseBytes() / 1e6, moved);
+    }
+  }
+
+  search_index_ = version >= kSearchIndexVersion;
+  event_summaries_ = version >= kEventSummariesVersion;
+  if (!search_index_) {
+    spdlog::warn("Search index unavailable; ListMarkets and ListEvents search will scan with LIKE");
+  }
+}
+
+int64_t SQLiteStore::PutPayloadLocked(std::string_view raw_json, bool *ok) {
+  *ok = true;
+  if (raw_json.empty()) {
+    return 0;
+  }
+  const int64_t hash = ContentHash(raw_json);
+  if (known_payloads_.count(hash)) {
+    payloads_deduplicated_.fetch_add(1, std::memory_order_relaxed);
+    return hash;
+  }
+  if (known_payloads_.size() >= kKnownPayloadLimit) {
+    known_payloads_.clear();
+  }
+
+  // A rowid probe is far cheaper than compressing a payload we already have.
+  sqlite3_stmt *exists = writer_.Statement("SELECT 1 FROM payloads WHERE hash = ?");
+  if (!exists) {
+    *ok = false;
+    return 0;
+  }
+  sqlite3_bind_int64(exists, 1, hash);
+  const bool present = sqlite3_step(exists) == SQLITE_ROW;
+  sqlite3_reset(exists);
+  if (present) {
+    known_payloads_.insert(hash);
+    payloads_deduplicated_.fetch_add(1, std::memory_order_relaxed);
+    return hash;
+  }
+
+  std::string compressed;
+  if (!payload_codec_->Compress(raw_json, &compressed)) {
+    spdlog::error("Failed to compress payload");
+    *ok = false;
+    return 0;
+  }
+  sqlite3_stmt *insert = writer_.Statement("INSERT INTO payloads (hash, codec, size, data) VALUES (?, ?, ?, ?)");
+  if (!insert) {
+    *ok = false;
+    return 0;
+  }
+  sqlite3_bind_int64(insert, 1, hash);
+  sqlite3_bind_int(insert, 2, kPayloadCodec);
+  sqlite3_bind_int64(insert, 3, static_cast<int64_t>(raw_json.size()));
+  sqlite3_bind_blob(insert, 4, compressed.data(), static_cast<int>(compressed.size()), SQLITE_STATIC);
+  *ok = sqlite3_step(insert) == SQLITE_DONE;
+  if (!*ok) {
+    spdlog::error("Failed to insert payload: {}", sqlite3_errmsg(writer_.db));
+  }
+  sqlite3_reset(insert);
+  sqlite3_clear_bindings(insert);
+  if (!*ok) {
+    return 0;
+  }
+  // Write() drops the cache when its batch rolls back, taking this insert with it.
+  known_payloads_.insert(hash);
+  payloads_stored_.fetch_add(1, std::memory_order_relaxed);
+  payload_raw_bytes_.fetch_add(raw_json.size(), std::memory_order_relaxed);
+  payload_stored_bytes_.fetch_add(compressed.size(), std::memory_order_relaxed);
+  return hash;
+}
+
+bool SQLiteStore::MigratePayloads(uint64_t *moved) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint64_t stored_before = payloads_stored_.load();
+  const uint64_t stored_bytes_before = payload_stored_bytes_.load();
+  uint64_t raw_bytes = 0;
+
+  for (const std::string table : {"markets", "features"}) {
+    sqlite3_stmt *select = writer_.Statement("SELECT rowid, raw_json FROM " + table +
+                                             " WHERE rowid > ? AND raw_json IS NOT NULL ORDER BY rowid LIMIT 5000");
+    sqlite3_stmt *update = writer_.Statement("UPDATE " + table + " SET payload_hash = ?, raw_json = NULL WHERE rowid = ?");
+    if (!select || !update) {
+      return false;
+    }
+    // Read a page, then rewrite it, rather than updating rows under an open cursor.
+    std::vector<std::pair<int64_t, std::string>> page;
+    int64_t last_rowid = std::numeric_limits<int64_t>::min();
+    do {
+      page.clear();
+      sqlite3_bind_int64(select, 1, last_rowid);
+      while (sqlite3_step(select) == SQLITE_ROW) {
+        const auto *text = reinterpret_cast<const char *>(sqlite3_column_text(select, 1));
+        page.emplace_back(sqlite3_column_int64(select, 0),
+                          std::string(text ? text : "", static_cast<size_t>(sqlite3_column_bytes(select, 1))));
+      }
+      sqlite3_reset(select);
+
+      for (const auto &row : page) {
+        bool ok = false;
+        const int64_t hash = PutPayloadLocked(row.second, &ok);
+        if (!ok) {
+          return false;
+        }
+        if (hash != 0) {
+          sqlite3_bind_int64(update, 1, hash);
+        } else {
+          sqlite3_bind_null(update, 1);
+        }
+        sqlite3_bind_int64(update, 2, row.first);
+        ok = sqlite3_step(update) == SQLITE_DONE;
+        sqlite3_reset(update);
+        if (!ok) {
+          spdlog::error("Failed to move {} payload: {}", table, sqlite3_errmsg(writer_.db));
+          return false;
+        }
+        raw_bytes += row.second.size();
+        ++*moved;
+        last_rowid = row.first;
+      }
+    } while (!page.empty());
+  }
+
+  if (*moved > 0) {
+    const uint64_t distinct = payloads_stored_.load() - stored_before;
+    const uint64_t stored_bytes = payload_stored_bytes_.load() - stored_bytes_before;
+    spdlog::info("Payload migration: {} inline payloads ({:.1f} MB) -> {} distinct, {:.1f} MB compressed ({:.1f}x)",
+                 *moved, raw_bytes / 1e6, distinct, stored_bytes / 1e6,
+                 stored_bytes > 0 ? static_cast<double>(raw_bytes) / stored_bytes : 0.0);
+  }
+  return true;
+}
+
+bool SQLiteStore::MarketPayload(analytics::TickerId ticker, std::string *json) const {
+  ReadLease connection(*this);
+  sqlite3_stmt *stmt = connection->Statement(
+      "SELECT p.codec, p.size, p.data FROM markets m JOIN payloads p ON p.hash = m.payload_hash WHERE m.ticker_id = ?");
+  if (!stmt) {
+    spdlog::error("Failed to prepare market payload");
+    return false;
+  }
+  sqlite3_bind_int64(stmt, 1, ticker);
+
+  bool ok = false;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    const int codec = sqlite3_column_int(stmt, 0);
+    const auto size = static_cast<size_t>(sqlite3_column_int64(stmt, 1));
+    const std::string_view data(static_cast<const char *>(sqlite3_column_blob(stmt, 2)),
+                                static_cast<size_t>(sqlite3_column_bytes(stmt, 2)));
+    if (codec != kPayloadCodec) {
+      spdlog::error("Payload for {} uses unknown codec {}", analytics::TickerName(ticker), codec);
+    } else {
+      ok = utils::InflateWithDictionary(data, std::string_view(kPayloadDictionary, sizeof(kPayloadDictionary) - 1),
+                                        size, json);
+      if (!ok) {
+        spdlog::error("Failed to inflate payload for {}", analytics::TickerName(ticker));
+      }
+    }
+  }
+
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return ok;
+}
+
+uint64_t SQLiteStore::PrunePayloads(const std::vector<int64_t> &candidates) {
+  // Batched like DeleteInBatches, so writers get the mutex between batches.
+  constexpr size_t kBatch = 1000;
+  uint64_t deleted = 0;
+  for (size_t first = 0; first < candidates.size(); first += kBatch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sqlite3_stmt *stmt = writer_.Statement(
+        "DELETE FROM payloads WHERE hash = ?1"
+        " AND NOT EXISTS (SELECT 1 FROM features WHERE payload_hash = ?1)"
+        " AND NOT EXISTS (SELECT 1 FROM markets WHERE payload_hash = ?1)");
+    sqlite3_stmt *begin = writer_.Statement("BEGIN IMMEDIATE");
+    const bool begun = stmt && begin && sqlite3_step(begin) == SQLITE_DONE;
+    sqlite3_reset(begin);
+    if (!begun) {
+      spdlog::error("Failed to begin payload prune: {}", sqlite3_errmsg(writer_.db));
+      return deleted;
+    }
+    const size_t last = std::min(candidates.size(), first + kBatch);
+    std::vector<int64_t> removed;
+    bool ok = true;
+    for (size_t i = first; ok && i < last; ++i) {
+      sqlite3_bind_int64(stmt, 1, candidates[i]);
+      ok = sqlite3_step(stmt) == SQLITE_DONE;
+      if (ok && sqlite3_changes(writer_.db) > 0) {
+        removed.push_back(candidates[i]);
+      }
+      sqlite3_reset(stmt);
+    }
+    sqlite3_clear_bindings(stmt);
+    sqlite3_stmt *finish = writer_.Statement(ok ? "COMMIT" : "ROLLBACK");
+    if (!finish || sqlite3_step(finish) != SQLITE_DONE) {
+      ok = false;
+    }
+    sqlite3_reset(finish);
+    if (!ok) {
+      spdlog::error("Failed to prune payloads: {}", sqlite3_errmsg(writer_.db));
+      if (!sqlite3_get_autocommit(writer_.db)) {
+        sqlite3_exec(writer_.db, "ROLLBACK", nullptr, nullptr, nullptr);
+      }
+      return deleted;
+    }
+    // A later write must store these again rather than reference them.
+    for (const int64_t hash : removed) {
+      known_payloads_.erase(hash);
+    }
+    deleted += removed.size();
+  }
+  return deleted;
+}
+
+PayloadStats SQLiteStore::payload_stats() const {
+  PayloadStats stats;
+  stats.stored = payloads_stored_.load(std::memory_order_relaxed);
+  stats.deduplicated = payloads_deduplicated_.load(std::memory_order_relaxed);
+  stats.raw_bytes = payload_raw_bytes_.load(std::memory_order_relaxed);
+  stats.stored_bytes = payload_stored_bytes_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+// Single rows go through Write() so new tickers are persisted with them.
+void SQLiteStore::UpsertMarket(const analytics::MarketSnapshot &snapshot, std::string_view raw_json) {
+  WriteBatch batch;
+  batch.markets.push_back({snapshot, raw_json});
+  Write(batch);
+}
+
+void SQLiteStore::InsertFeature(const analytics::FeatureRow &feature, std::string_view raw_json) {
+  WriteBatch batch;
+  batch.features.push_back({feature, raw_json});
+  Write(batch);
+}
+
+void SQLiteStore::InsertAlert(const analytics::Alert &alert) {
+  WriteBatch batch;
+  batch.alerts.push_back(alert);
+  Write(batch);
+}
+
+WriteStats SQLiteStore::Write(const WriteBatch &batch) {
+  WriteStats stats;
+  if (batch.empty()) {
+    return stats;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  sqlite3_stmt *begin = writer_.Statement("BEGIN IMMEDIATE");
+  const bool begun = begin && sqlite3_step(begin) == SQLITE_DONE;
+  sqlite3_reset(begin);
+  if (!begun) {
+    spdlog::error("Failed to begin write batch: {}", sqlite3_errmsg(writer_.db));
+    return stats;
+  }
+
+  analytics::TickerId tickers = persisted_tickers_;
+  bool ok = PersistTickersLocked(&tickers);
+  for (size_t i = 0; ok && i < batch.markets.size(); ++i) {
+    ok = UpsertMarketLocked(batch.markets[i].snapshot, batch.markets[i].raw_json);
+  }
+  for (size_t i = 0; ok && i < batch.features.size(); ++i) {
+    ok = InsertFeatureLocked(batch.features[i].row, batch.features[i].raw_json);
+  }
+  for (size_t i = 0; ok && i < batch.alerts.size(); ++i) {
+    ok = InsertAlertLocked(batch.alerts[i]);
+  }
+
+  sqlite3_stmt *finish = writer_.Statement(ok ? "COMMIT" : "ROLLBACK");
+  if (sqlite3_step(finish) != SQLITE_DONE) {
+    spdlog::error("Failed to {} write batch: {}", ok ? "commit" : "roll back", sqlite3_errmsg(writer_.db));
+    ok = false;
+  }
+  sqlite3_reset(finish);
+  if (!ok) {
+    // A failed COMMIT can leave the transaction open.
+    if (!sqlite3_get_autocommit(writer_.db)) {
+      sqlite3_exec(writer_.db, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+    known_payloads_.clear();
+    return stats;
+  }
+
+  persisted_tickers_ = tickers;
+  stats.rows = batch.rows();
+  stats.features = batch.features.size();
+  stats.alerts = batch.alerts.size();
+  const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+  stats.seconds = std::chrono::duration<double>(nanos).count();
+  rows_written_.fetch_add(stats.rows, std::memory_order_relaxed);
+  features_written_.fetch_add(stats.features, std::memory_order_relaxed);
+  alerts_written_.fetch_add(stats.alerts, std::memory_order_relaxed);
+  write_nanos_.fetch_add(static_cast<uint64_t>(nanos.count()), std::memory_order_relaxed);
+  return stats;
+}
+
+WriteStats SQLiteStore::write_totals() const {
+  WriteStats stats;
+  stats.rows = rows_written_.load(std::memory_order_relaxed);
+  stats.features = features_written_.load(std::memory_order_relaxed);
+  stats.alerts = alerts_written_.load(std::memory_order_relaxed);
+  stats.seconds = write_nanos_.load(std::memory_order_relaxed) / 1e9;
+  return stats;
+}
+
+bool SQLiteStore::UpsertMarketLocked(const analytics::MarketSnapshot &snapshot, std::string_view raw_json) {
+  bool ok = false;
+  const int64_t payload = PutPayloadLocked(raw_json, &ok);
+  if (!ok) {
+    return false;
+  }
+  sqlite3_stmt *stmt = writer_.Statement(
+      "INSERT INTO markets"
+      " (ticker_id, ticker, event_ticker, status, category, yes_bid, yes_ask, last_price, volume, updated_at,"
+      " payload_hash)"
+      " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+      " ON CONFLICT(ticker_id) DO UPDATE SET"
       " event_ticker=excluded.event_ticker,"
       " status=excluded.status,"
       " category=excluded.category,"
@@ -68,91 +1023,108 @@ void SQLiteStore::UpsertMarket(const analytics::MarketSnapshot &snapshot, const
       " last_price=excluded.last_price,"
       " volume=excluded.volume,"
       " updated_at=excluded.updated_at,"
-      " raw_json=excluded.raw_json";
-
-  sqlite3_stmt *stmt = nullptr;
-  if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+      " payload_hash=excluded.payload_hash");
+  if (!stmt) {
     spdlog::error("Failed to prepare upsert market");
-    return;
+    return false;
   }
 
-  sqlite3_bind_text(stmt, 1, snapshot.ticker.c_str(), -1, SQLITE_TRANSIENT);
-  sqlite3_bind_text(stmt, 2, snapshot.event_ticker.c_str(), -1, SQLITE_TRANSIENT);
-  sqlite3_bind_text(stmt, 3, snapshot.status.c_str(), -1, SQLITE_TRANSIENT);
-  sqlite3_bind_text(stmt, 4, snapshot.category.c_str(), -1, SQLITE_TRANSIENT);
-  sqlite3_bind_double(stmt, 5, snapshot.yes_bid);
-  sqlite3_bind_double(stmt, 6, snapshot.yes_ask);
-  sqlite3_bind_double(stmt, 7, snapshot.last_price);
-  sqlite3_bind_double(stmt, 8, snapshot.volume);
-  sqlite3_bind_text(stmt, 9, snapshot.updated_at.c_str(), -1, SQLITE_TRANSIENT);
-  sqlite3_bind_text(stmt, 10, raw_json.c_str(), -1, SQLITE_TRANSIENT);
-
-  if (sqlite3_step(stmt) != SQLITE_DONE) {
-    spdlog::error("Failed to upsert market");
+  const std::string &ticker = analytics::TickerName(snapshot.ticker);
+  sqlite3_bind_int64(stmt, 1, snapshot.ticker);
+  sqlite3_bind_text(stmt, 2, ticker.c_str(), static_cast<int>(ticker.size()), SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 3, snapshot.event_ticker.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 4, snapshot.status.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 5, snapshot.category.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_double(stmt, 6, snapshot.yes_bid);
+  sqlite3_bind_double(stmt, 7, snapshot.yes_ask);
+  sqlite3_bind_double(stmt, 8, snapshot.last_price);
+  sqlite3_bind_double(stmt, 9, snapshot.volume);
+  sqlite3_bind_int64(stmt, 10, snapshot.updated_at);
+  if (payload != 0) {
+    sqlite3_bind_int64(stmt, 11, payload);
   }
 
-  sqlite3_finalize(stmt);
+  ok = sqlite3_step(stmt) == SQLITE_DONE;
+  if (!ok) {
+    spdlog::error("Failed to upsert market: {}", sqlite3_errmsg(writer_.db));
+  }
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return ok;
 }
 
-void SQLiteStore::InsertFeature(const analytics::FeatureRow &feature, const std::string &raw_json) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  const char *sql =
-      "INSERT INTO features (ticker, ts, mid, spread, prob, volume, raw_json)"
-      " VALUES (?, ?, ?, ?, ?, ?, ?)";
-
-  sqlite3_stmt *stmt = nullptr;
-  if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+bool SQLiteStore::InsertFeatureLocked(const analytics::FeatureRow &feature, std::string_view raw_json) {
+  // Unchanged markets hash to a payload already stored, so only the reference is written.
+  bool ok = false;
+  const int64_t payload = PutPayloadLocked(raw_json, &ok);
+  if (!ok) {
+    return false;
+  }
+  sqlite3_stmt *stmt = writer_.Statement(
+      "INSERT INTO features (ticker_id, ts, mid, spread, prob, volume, payload_hash, bid_depth, ask_depth, imbalance, microprice)"
+      " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+  if (!stmt) {
     spdlog::error("Failed to prepare insert feature");
-    return;
+    return false;
   }
 
-  sqlite3_bind_text(stmt, 1, feature.ticker.c_str(), -1, SQLITE_TRANSIENT);
-  sqlite3_bind_text(stmt, 2, feature.ts.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_int64(stmt, 1, feature.ticker);
+  sqlite3_bind_int64(stmt, 2, feature.ts);
   sqlite3_bind_double(stmt, 3, feature.mid);
   sqlite3_bind_double(stmt, 4, feature.spread);
   sqlite3_bind_double(stmt, 5, feature.prob);
   sqlite3_bind_double(stmt, 6, feature.volume);
-  sqlite3_bind_text(stmt, 7, raw_json.c_str(), -1, SQLITE_TRANSIENT);
-
-  if (sqlite3_step(stmt) != SQLITE_DONE) {
-    spdlog::error("Failed to insert feature");
+  if (payload != 0) {
+    sqlite3_bind_int64(stmt, 7, payload);
+  }
+  // Left NULL without a book so "no data" is distinguishable from an empty book.
+  if (feature.has_book) {
+    sqlite3_bind_double(stmt, 8, feature.bid_depth);
+    sqlite3_bind_double(stmt, 9, feature.ask_depth);
+    sqlite3_bind_double(stmt, 10, feature.imbalance);
+    sqlite3_bind_double(stmt, 11, feature.microprice);
   }
 
-  sqlite3_finalize(stmt);
+  ok = sqlite3_step(stmt) == SQLITE_DONE;
+  if (!ok) {
+    spdlog::error("Failed to insert feature: {}", sqlite3_errmsg(writer_.db));
+  }
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return ok;
 }
 
-void SQLiteStore::InsertAlert(const analytics::Alert &alert) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  const char *sql =
-      "INSERT INTO alerts (ticker, ts, type, score, details)"
-      " VALUES (?, ?, ?, ?, ?)";
-
-  sqlite3_stmt *stmt = nullptr;
-  if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+bool SQLiteStore::InsertAlertLocked(const analytics::Alert &alert) {
+  sqlite3_stmt *stmt = writer_.Statement(
+      "INSERT INTO alerts (ticker_id, ts, type, score, details)"
+      " VALUES (?, ?, ?, ?, ?)");
+  if (!stmt) {
     spdlog::error("Failed to prepare insert alert");
-    return;
+    return false;
   }
 
-  sqlite3_bind_text(stmt, 1, alert.ticker.c_str(), -1, SQLITE_TRANSIENT);
-  sqlite3_bind_text(stmt, 2, alert.ts.c_str(), -1, SQLITE_TRANSIENT);
-  sqlite3_bind_text(stmt, 3, alert.type.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_int64(stmt, 1, alert.ticker);
+  sqlite3_bind_int64(stmt, 2, alert.ts);
+  sqlite3_bind_text(stmt, 3, alert.type.c_str(), -1, SQLITE_STATIC);
   sqlite3_bind_double(stmt, 4, alert.score);
-  sqlite3_bind_text(stmt, 5, alert.details.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(stmt, 5, alert.details.c_str(), -1, SQLITE_STATIC);
 
-  if (sqlite3_step(stmt) != SQLITE_DONE) {
-    spdlog::error("Failed to insert alert");
+  const bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+  if (!ok) {
+    spdlog::error("Failed to insert alert: {}", sqlite3_errmsg(writer_.db));
   }
-
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return ok;
 }
 
 std::vector<analytics::Alert> SQLiteStore::RecentAlerts(int limit) const {
-  std::lock_guard<std::mutex> lock(mutex_);
+  ReadLease connection(*this);
   std::vector<analytics::Alert> results;
-  const char *sql = "SELECT ticker, ts, type, score, details FROM alerts ORDER BY id DESC LIMIT ?";
+  const char *sql = "SELECT ticker_id, ts, type, score, details FROM alerts ORDER BY id DESC LIMIT ?";
 
-  sqlite3_stmt *stmt = nullptr;
-  if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+  sqlite3_stmt *stmt = connection->Statement(sql);
+  if (!stmt) {
     spdlog::error("Failed to prepare recent alerts");
     return results;
   }
@@ -161,116 +1133,521 @@ std::vector<analytics::Alert> SQLiteStore::RecentAlerts(int limit) const {
 
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     analytics::Alert alert;
-    alert.ticker = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
-    alert.ts = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    alert.ticker = static_cast<analytics::TickerId>(sqlite3_column_int64(stmt, 0));
+    alert.ts = sqlite3_column_int64(stmt, 1);
     alert.type = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
     alert.score = sqlite3_column_double(stmt, 3);
     alert.details = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
     results.push_back(alert);
   }
 
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
   return results;
 }
 
-std::vector<analytics::FeatureRow> SQLiteStore::LatestFeatures(const std::string &ticker, int limit) const {
-  std::lock_guard<std::mutex> lock(mutex_);
+namespace {
+
+std::vector<analytics::FeatureRow> ReadFeatures(sqlite3_stmt *stmt) {
   std::vector<analytics::FeatureRow> results;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    analytics::FeatureRow feature;
+    feature.ticker = static_cast<analytics::TickerId>(sqlite3_column_int64(stmt, 0));
+    feature.ts = sqlite3_column_int64(stmt, 1);
+    feature.mid = sqlite3_column_double(stmt, 2);
+    feature.spread = sqlite3_column_double(stmt, 3);
+    feature.prob = sqlite3_column_double(stmt, 4);
+    feature.volume = sqlite3_column_double(stmt, 5);
+    feature.has_book = sqlite3_column_type(stmt, 6) != SQLITE_NULL;
+    feature.bid_depth = sqlite3_column_double(stmt, 6);
+    feature.ask_depth = sqlite3_column_double(stmt, 7);
+    feature.imbalance = sqlite3_column_double(stmt, 8);
+    feature.microprice = sqlite3_column_double(stmt, 9);
+    results.push_back(feature);
+  }
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return results;
+}
+
+std::string ColumnString(sqlite3_stmt *stmt, int column) {
+  const unsigned char *text = sqlite3_column_text(stmt, column);
+  return text ? reinterpret_cast<const char *>(text) : "";
+}
+
+// Columns: ticker_id, event_ticker, status, category, yes_bid, yes_ask, last_price,
+// volume, updated_at.
+std::vector<analytics::MarketSnapshot> ReadMarkets(sqlite3_stmt *stmt) {
+  std::vector<analytics::MarketSnapshot> results;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    analytics::MarketSnapshot snapshot;
+    snapshot.ticker = static_cast<analytics::TickerId>(sqlite3_column_int64(stmt, 0));
+    snapshot.event_ticker = ColumnString(stmt, 1);
+    snapshot.status = ColumnString(stmt, 2);
+    snapshot.category = ColumnString(stmt, 3);
+    snapshot.yes_bid = sqlite3_column_double(stmt, 4);
+    snapshot.yes_ask = sqlite3_column_double(stmt, 5);
+    snapshot.last_price = sqlite3_column_double(stmt, 6);
+    snapshot.volume = sqlite3_column_double(stmt, 7);
+    snapshot.updated_at = sqlite3_column_int64(stmt, 8);
+    results.push_back(snapshot);
+  }
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return results;
+}
+
+}  // namespace
+
+std::vector<analytics::FeatureRow> SQLiteStore::LatestFeatures(analytics::TickerId ticker, int limit) const {
+  ReadLease connection(*this);
   const char *sql =
-      "SELECT ticker, ts, mid, spread, prob, volume FROM features WHERE ticker = ? ORDER BY id DESC LIMIT ?";
+      "SELECT ticker_id, ts, mid, spread, prob, volume, bid_depth, ask_depth, imbalance, microprice"
+      " FROM features WHERE ticker_id = ? ORDER BY id DESC LIMIT ?";
 
-  sqlite3_stmt *stmt = nullptr;
-  if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+  sqlite3_stmt *stmt = connection->Statement(sql);
+  if (!stmt) {
     spdlog::error("Failed to prepare latest features");
+    return {};
+  }
+
+  sqlite3_bind_int64(stmt, 1, ticker);
+  sqlite3_bind_int(stmt, 2, limit);
+  return ReadFeatures(stmt);
+}
+
+std::vector<analytics::FeatureRow> SQLiteStore::LatestFeatures(const std::vector<analytics::TickerId> &tickers,
+                                                               int limit) const {
+  if (tickers.empty()) {
+    return {};
+  }
+  ReadLease connection(*this);
+  // The ids go in as one JSON array, so a single prepared statement serves any number
+  // of tickers; each still gets its own index seek, as in the single-ticker query.
+  const char *sql =
+      "SELECT f.ticker_id, f.ts, f.mid, f.spread, f.prob, f.volume, f.bid_depth, f.ask_depth, f.imbalance,"
+      " f.microprice FROM json_each(?) AS t JOIN features f"
+      " ON f.id IN (SELECT id FROM features WHERE ticker_id = t.value ORDER BY id DESC LIMIT ?)"
+      " ORDER BY t.key, f.id DESC";
+
+  sqlite3_stmt *stmt = connection->Statement(sql);
+  if (!stmt) {
+    // SQLite built without JSON functions: the same seeks, one statement per ticker,
+    // still under one lease.
+    sqlite3_stmt *single = connection->Statement(
+        "SELECT ticker_id, ts, mid, spread, prob, volume, bid_depth, ask_depth, imbalance, microprice"
+        " FROM features WHERE ticker_id = ? ORDER BY id DESC LIMIT ?");
+    if (!single) {
+      spdlog::error("Failed to prepare latest features");
+      return {};
+    }
+    std::vector<analytics::FeatureRow> results;
+    for (const analytics::TickerId ticker : tickers) {
+      sqlite3_bind_int64(single, 1, ticker);
+      sqlite3_bind_int(single, 2, limit);
+      const auto rows = ReadFeatures(single);
+      results.insert(results.end(), rows.begin(), rows.end());
+    }
     return results;
   }
 
-  sqlite3_bind_text(stmt, 1, ticker.c_str(), -1, SQLITE_TRANSIENT);
+  std::string ids = "[";
+  for (const analytics::TickerId ticker : tickers) {
+    if (ids.size() > 1) {
+      ids.push_back(',');
+    }
+    ids += std::to_string(ticker);
+  }
+  ids.push_back(']');
+  sqlite3_bind_text(stmt, 1, ids.data(), static_cast<int>(ids.size()), SQLITE_TRANSIENT);
   sqlite3_bind_int(stmt, 2, limit);
+  return ReadFeatures(stmt);
+}
+
+std::vector<analytics::FeatureRow> SQLiteStore::FeatureRange(analytics::TickerId ticker, int64_t from_nanos,
+                                                             int64_t to_nanos, int limit) const {
+  ReadLease connection(*this);
+  const char *sql =
+      "SELECT ticker_id, ts, mid, spread, prob, volume, bid_depth, ask_depth, imbalance, microprice"
+      " FROM features WHERE ticker_id = ? AND ts >= ? AND ts <= ? ORDER BY id DESC LIMIT ?";
+
+  sqlite3_stmt *stmt = connection->Statement(sql);
+  if (!stmt) {
+    spdlog::error("Failed to prepare feature range");
+    return {};
+  }
+
+  sqlite3_bind_int64(stmt, 1, ticker);
+  sqlite3_bind_int64(stmt, 2, from_nanos);
+  sqlite3_bind_int64(stmt, 3, to_nanos);
+  sqlite3_bind_int(stmt, 4, limit > 0 ? limit : -1);
+  return ReadFeatures(stmt);
+}
+
+std::vector<analytics::FeatureBar> SQLiteStore::FeatureHistory(analytics::TickerId ticker, Resolution resolution,
+                                                               int64_t from_nanos, int64_t to_nanos, int limit) const {
+  std::vector<analytics::FeatureBar> results;
+  const RollupTier *tier = FindTier(resolution);
+  if (!tier) {
+    spdlog::error("Feature history needs a rollup resolution, not {}", ResolutionName(resolution));
+    return results;
+  }
+
+  ReadLease connection(*this);
+  const std::string sql = std::string(
+                              "SELECT bucket, open, high, low, close, spread, prob, volume, volume_delta, samples"
+                              " FROM ") +
+                          tier->table + " WHERE ticker_id = ? AND bucket >= ? AND bucket <= ? ORDER BY bucket DESC LIMIT ?";
+  sqlite3_stmt *stmt = connection->Statement(sql);
+  if (!stmt) {
+    spdlog::error("Failed to prepare feature history");
+    return results;
+  }
+
+  sqlite3_bind_int64(stmt, 1, ticker);
+  sqlite3_bind_int64(stmt, 2, from_nanos);
+  sqlite3_bind_int64(stmt, 3, to_nanos);
+  sqlite3_bind_int(stmt, 4, limit > 0 ? limit : -1);
 
   while (sqlite3_step(stmt) == SQLITE_ROW) {
-    analytics::FeatureRow feature;
-    feature.ticker = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
-    feature.ts = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
-    feature.mid = sqlite3_column_double(stmt, 2);
-    feature.spread = sqlite3_column_double(stmt, 3);
-    feature.prob = sqlite3_column_double(stmt, 4);
-    feature.volume = sqlite3_column_double(stmt, 5);
-    results.push_back(feature);
+    analytics::FeatureBar bar;
+    bar.ticker = ticker;
+    bar.ts = sqlite3_column_int64(stmt, 0);
+    bar.seconds = tier->seconds;
+    bar.open = sqlite3_column_double(stmt, 1);
+    bar.high = sqlite3_column_double(stmt, 2);
+    bar.low = sqlite3_column_double(stmt, 3);
+    bar.close = sqlite3_column_double(stmt, 4);
+    bar.spread = sqlite3_column_double(stmt, 5);
+    bar.prob = sqlite3_column_double(stmt, 6);
+    bar.volume = sqlite3_column_double(stmt, 7);
+    bar.volume_delta = sqlite3_column_double(stmt, 8);
+    bar.samples = sqlite3_column_int(stmt, 9);
+    results.push_back(bar);
   }
 
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
   return results;
 }
 
-std::vector<analytics::MarketSnapshot> SQLiteStore::ListMarkets(int limit, const std::string &search) const {
+uint64_t SQLiteStore::RollupFeatures(size_t max_rows) {
   std::lock_guard<std::mutex> lock(mutex_);
+  sqlite3_stmt *begin = writer_.Statement("BEGIN IMMEDIATE");
+  const bool begun = begin && sqlite3_step(begin) == SQLITE_DONE;
+  sqlite3_reset(begin);
+  if (!begun) {
+    spdlog::error("Failed to begin rollup: {}", sqlite3_errmsg(writer_.db));
+    return 0;
+  }
+
+  bool ok = true;
+  int64_t watermark = 0;
+  sqlite3_stmt *state = writer_.Statement("SELECT last_feature_id FROM rollup_state WHERE id = 1");
+  if (state && sqlite3_step(state) == SQLITE_ROW) {
+    watermark = sqlite3_column_int64(state, 0);
+  } else {
+    ok = false;
+  }
+  sqlite3_reset(state);
+
+  // Previous cumulative volume per ticker, so each row contributes what traded since
+  // the row before it.
+  std::unordered_map<analytics::TickerId, double> last_volume;
+  sqlite3_stmt *last_bar =
+      writer_.Statement("SELECT volume FROM features_1h WHERE ticker_id = ? ORDER BY bucket DESC LIMIT 1");
+  std::map<std::pair<analytics::TickerId, int64_t>, BarAccumulator> bars[std::size(kRollupTiers)];
+  uint64_t consumed = 0;
+
+  sqlite3_stmt *rows = writer_.Statement(
+      "SELECT id, ticker_id, ts, mid, spread, prob, volume FROM features WHERE id > ? ORDER BY id LIMIT ?");
+  if (!rows || !last_bar) {
+    ok = false;
+  }
+  if (ok) {
+    sqlite3_bind_int64(rows, 1, watermark);
+    sqlite3_bind_int64(rows, 2, static_cast<int64_t>(max_rows));
+    while (sqlite3_step(rows) == SQLITE_ROW) {
+      ++consumed;
+      watermark = sqlite3_column_int64(rows, 0);
+      const auto ticker = static_cast<analytics::TickerId>(sqlite3_column_int64(rows, 1));
+      const int64_t nanos = sqlite3_column_int64(rows, 2);
+      const double volume = sqlite3_column_double(rows, 6);
+
+      auto previous = last_volume.find(ticker);
+      if (previous == last_volume.end()) {
+        double prior = volume;
+        sqlite3_bind_int64(last_bar, 1, ticker);
+        if (sqlite3_step(last_bar) == SQLITE_ROW) {
+          prior = sqlite3_column_double(last_bar, 0);
+        }
+        sqlite3_reset(last_bar);
+        sqlite3_clear_bindings(last_bar);
+        previous = last_volume.emplace(ticker, prior).first;
+      }
+      // Cumulative volume only grows; a drop is a data reset, not negative trading.
+      const double delta = std::max(0.0, volume - previous->second);
+      previous->second = volume;
+
+      for (size_t t = 0; t < std::size(kRollupTiers); ++t) {
+        bars[t][{ticker, BucketStart(nanos, kRollupTiers[t].seconds * utils::kNanosPerSecond)}].Add(
+            sqlite3_column_double(rows, 3), sqlite3_column_double(rows, 4), sqlite3_column_double(rows, 5), volume,
+            delta);
+      }
+    }
+    sqlite3_reset(rows);
+    sqlite3_clear_bindings(rows);
+  }
+
+  for (size_t t = 0; ok && t < std::size(kRollupTiers); ++t) {
+    // Merging into an existing bar keeps its open; everything in this pass is newer.
+    sqlite3_stmt *upsert = writer_.Statement(
+        std::string("INSERT INTO ") + kRollupTiers[t].table +
+        " (ticker_id, bucket, open, high, low, close, spread, prob, volume, volume_delta, samples)"
+        " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+        " ON CONFLICT(ticker_id, bucket) DO UPDATE SET"
+        " high=max(high, excluded.high),"
+        " low=min(low, excluded.low),"
+        " close=excluded.close,"
+        " spread=excluded.spread,"
+        " prob=excluded.prob,"
+        " volume=excluded.volume,"
+        " volume_delta=volume_delta + excluded.volume_delta,"
+        " samples=samples + excluded.samples");
+    if (!upsert) {
+      ok = false;
+      break;
+    }
+    for (const auto &entry : bars[t]) {
+      const BarAccumulator &bar = entry.second;
+      sqlite3_bind_int64(upsert, 1, entry.first.first);
+      sqlite3_bind_int64(upsert, 2, entry.first.second);
+      sqlite3_bind_double(upsert, 3, bar.open);
+      sqlite3_bind_double(upsert, 4, bar.high);
+      sqlite3_bind_double(upsert, 5, bar.low);
+      sqlite3_bind_double(upsert, 6, bar.close);
+      sqlite3_bind_double(upsert, 7, bar.spread);
+      sqlite3_bind_double(upsert, 8, bar.prob);
+      sqlite3_bind_double(upsert, 9, bar.volume);
+      sqlite3_bind_double(upsert, 10, bar.volume_delta);
+      sqlite3_bind_int(upsert, 11, bar.samples);
+      ok = sqlite3_step(upsert) == SQLITE_DONE;
+      sqlite3_reset(upsert);
+      sqlite3_clear_bindings(upsert);
+      if (!ok) {
+        spdlog::error("Failed to upsert {} bar: {}", kRollupTiers[t].table, sqlite3_errmsg(writer_.db));
+        break;
+      }
+    }
+  }
+
+  if (ok && consumed > 0) {
+    sqlite3_stmt *advance = writer_.Statement("UPDATE rollup_state SET last_feature_id = ? WHERE id = 1");
+    ok = advance != nullptr;
+    if (ok) {
+      sqlite3_bind_int64(advance, 1, watermark);
+      ok = sqlite3_step(advance) == SQLITE_DONE;
+      sqlite3_reset(advance);
+      sqlite3_clear_bindings(advance);
+    }
+  }
+
+  sqlite3_stmt *finish = writer_.Statement(ok ? "COMMIT" : "ROLLBACK");
+  if (sqlite3_step(finish) != SQLITE_DONE) {
+    spdlog::error("Failed to {} rollup: {}", ok ? "commit" : "roll back", sqlite3_errmsg(writer_.db));
+    ok = false;
+  }
+  sqlite3_reset(finish);
+  if (!ok) {
+    if (!sqlite3_get_autocommit(writer_.db)) {
+      sqlite3_exec(writer_.db, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+    return 0;
+  }
+  return consumed;
+}
+
+uint64_t SQLiteStore::PruneFeatures(int64_t before_nanos, std::vector<int64_t> *payloads) {
+  int64_t watermark = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sqlite3_stmt *state = writer_.Statement("SELECT last_feature_id FROM rollup_state WHERE id = 1");
+    if (state && sqlite3_step(state) == SQLITE_ROW) {
+      watermark = sqlite3_column_int64(state, 0);
+    }
+    sqlite3_reset(state);
+  }
+  if (payloads) {
+    // Read before the rows go; rows that share a payload report it once.
+    ReadLease connection(*this);
+    sqlite3_stmt *stmt = connection->Statement(
+        "SELECT DISTINCT payload_hash FROM features WHERE ts < ?1 AND id <= ?2 AND payload_hash IS NOT NULL");
+    if (stmt) {
+      sqlite3_bind_int64(stmt, 1, before_nanos);
+      sqlite3_bind_int64(stmt, 2, watermark);
+      while (sqlite3_step(stmt) == SQLITE_ROW) {
+        payloads->push_back(sqlite3_column_int64(stmt, 0));
+      }
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
+    }
+  }
+  return DeleteInBatches(
+      "DELETE FROM features WHERE id IN (SELECT id FROM features WHERE ts < ?1 AND id <= ?2 LIMIT 5000)", before_nanos,
+      watermark);
+}
+
+uint64_t SQLiteStore::PruneBars(Resolution resolution, int64_t before_nanos) {
+  const RollupTier *tier = FindTier(resolution);
+  if (!tier) {
+    return 0;
+  }
+  // WITHOUT ROWID tables: select victims by primary key.
+  return DeleteInBatches(std::string("DELETE FROM ") + tier->table +
+                             " WHERE (ticker_id, bucket) IN (SELECT ticker_id, bucket FROM " + tier->table +
+                             " WHERE bucket < ?1 LIMIT 5000)",
+                         before_nanos, 0);
+}
+
+uint64_t SQLiteStore::DeleteInBatches(const std::string &sql, int64_t first, int64_t second) {
+  uint64_t deleted = 0;
+  for (;;) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sqlite3_stmt *stmt = writer_.Statement(sql);
+    if (!stmt) {
+      spdlog::error("Failed to prepare delete");
+      return deleted;
+    }
+    sqlite3_bind_int64(stmt, 1, first);
+    sqlite3_bind_int64(stmt, 2, second);
+    const bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    if (!ok) {
+      spdlog::error("Failed to delete: {}", sqlite3_errmsg(writer_.db));
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    const int changes = ok ? sqlite3_changes(writer_.db) : 0;
+    deleted += static_cast<uint64_t>(changes);
+    if (changes == 0) {
+      return deleted;
+    }
+  }
+}
+
+std::vector<analytics::MarketSnapshot> SQLiteStore::ListMarkets(int limit, const std::string &search) const {
+  ReadLease connection(*this);
   std::vector<analytics::MarketSnapshot> results;
   std::string sql =
-      "SELECT ticker, event_ticker, status, category, yes_bid, yes_ask, last_price, volume, updated_at "
+      "SELECT ticker_id, event_ticker, status, category, yes_bid, yes_ask, last_price, volume, updated_at "
       "FROM markets";
   bool has_search = !search.empty();
-  if (has_search) {
+  const bool indexed = has_search && search_index_ && UseTrigramIndex(search);
+  if (indexed) {
+    sql += " WHERE rowid IN (SELECT rowid FROM markets_fts WHERE markets_fts MATCH ?)";
+  } else if (has_search) {
     sql += " WHERE ticker LIKE ? OR event_ticker LIKE ? OR category LIKE ?";
   }
   sql += " ORDER BY updated_at DESC LIMIT ?";
 
-  sqlite3_stmt *stmt = nullptr;
-  if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+  sqlite3_stmt *stmt = connection->Statement(sql);
+  if (!stmt) {
     spdlog::error("Failed to prepare list markets");
     return results;
   }
 
   int bind_index = 1;
   std::string wildcard;
-  if (has_search) {
+  if (indexed) {
+    sqlite3_bind_text(stmt, bind_index++, PhraseQuery(search).c_str(), -1, SQLITE_TRANSIENT);
+  } else if (has_search) {
     wildcard = "%" + search + "%";
     sqlite3_bind_text(stmt, bind_index++, wildcard.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, bind_index++, wildcard.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, bind_index++, wildcard.c_str(), -1, SQLITE_TRANSIENT);
   }
   sqlite3_bind_int(stmt, bind_index, limit);
+  return ReadMarkets(stmt);
+}
 
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
-    analytics::MarketSnapshot snapshot;
-    snapshot.ticker = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
-    snapshot.event_ticker = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
-    snapshot.status = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
-    snapshot.category = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
-    snapshot.yes_bid = sqlite3_column_double(stmt, 4);
-    snapshot.yes_ask = sqlite3_column_double(stmt, 5);
-    snapshot.last_price = sqlite3_column_double(stmt, 6);
-    snapshot.volume = sqlite3_column_double(stmt, 7);
-    snapshot.updated_at = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 8));
-    results.push_back(snapshot);
+std::vector<analytics::FeatureRow> SQLiteStore::LatestFeaturePerTicker(analytics::TickerId first,
+                                                                       analytics::TickerId last) const {
+  ReadLease connection(*this);
+  // One index seek per ticker rather than a MAX(id) scan over every row in the range.
+  const char *sql =
+      "SELECT f.ticker_id, f.ts, f.mid, f.spread, f.prob, f.volume, f.bid_depth, f.ask_depth, f.imbalance,"
+      " f.microprice FROM tickers t JOIN features f"
+      " ON f.id = (SELECT id FROM features WHERE ticker_id = t.id ORDER BY id DESC LIMIT 1)"
+      " WHERE t.id BETWEEN ? AND ? ORDER BY t.id";
+
+  sqlite3_stmt *stmt = connection->Statement(sql);
+  if (!stmt) {
+    spdlog::error("Failed to prepare latest feature per ticker");
+    return {};
   }
 
-  sqlite3_finalize(stmt);
-  return results;
+  sqlite3_bind_int64(stmt, 1, first);
+  sqlite3_bind_int64(stmt, 2, last);
+  return ReadFeatures(stmt);
+}
+
+std::vector<analytics::MarketSnapshot> SQLiteStore::MarketsByTicker(analytics::TickerId first,
+                                                                    analytics::TickerId last) const {
+  ReadLease connection(*this);
+  const char *sql =
+      "SELECT ticker_id, event_ticker, status, category, yes_bid, yes_ask, last_price, volume, updated_at "
+      "FROM markets WHERE ticker_id BETWEEN ? AND ? ORDER BY ticker_id";
+
+  sqlite3_stmt *stmt = connection->Statement(sql);
+  if (!stmt) {
+    spdlog::error("Failed to prepare markets by ticker");
+    return {};
+  }
+
+  sqlite3_bind_int64(stmt, 1, first);
+  sqlite3_bind_int64(stmt, 2, last);
+  return ReadMarkets(stmt);
 }
 
 std::vector<analytics::EventSummary> SQLiteStore::ListEvents(int limit, const std::string &search) const {
-  std::lock_guard<std::mutex> lock(mutex_);
+  ReadLease connection(*this);
   std::vector<analytics::EventSummary> results;
-  std::string sql =
-      "SELECT event_ticker, category, COUNT(*), COALESCE(SUM(volume), 0), MAX(updated_at) "
-      "FROM markets "
-      "WHERE event_ticker IS NOT NULL AND event_ticker != ''";
   bool has_search = !search.empty();
-  if (has_search) {
-    sql += " AND (event_ticker LIKE ? OR category LIKE ?)";
+  const bool indexed = has_search && search_index_ && UseTrigramIndex(search);
+  std::string sql;
+  if (event_summaries_) {
+    // Maintained by triggers on markets; this is an index walk, not an aggregate.
+    sql = "SELECT event_ticker, category, market_count, total_volume, updated_at FROM event_summaries";
+    if (indexed) {
+      sql += " WHERE (event_ticker, category) IN (SELECT event_ticker, COALESCE(category, '') FROM markets"
+             " WHERE rowid IN (SELECT rowid FROM markets_fts WHERE markets_fts MATCH ?))";
+    } else if (has_search) {
+      sql += " WHERE (event_ticker LIKE ? OR category LIKE ?)";
+    }
+    sql += " ORDER BY updated_at DESC LIMIT ?";
+  } else {
+    sql = "SELECT event_ticker, category, COUNT(*), COALESCE(SUM(volume), 0), MAX(updated_at) "
+          "FROM markets "
+          "WHERE event_ticker IS NOT NULL AND event_ticker != ''";
+    if (indexed) {
+      sql += " AND rowid IN (SELECT rowid FROM markets_fts WHERE markets_fts MATCH ?)";
+    } else if (has_search) {
+      sql += " AND (event_ticker LIKE ? OR category LIKE ?)";
+    }
+    sql += " GROUP BY event_ticker, category ORDER BY MAX(updated_at) DESC LIMIT ?";
   }
-  sql += " GROUP BY event_ticker, category ORDER BY MAX(updated_at) DESC LIMIT ?";
 
-  sqlite3_stmt *stmt = nullptr;
-  if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+  sqlite3_stmt *stmt = connection->Statement(sql);
+  if (!stmt) {
     spdlog::error("Failed to prepare list events");
     return results;
   }
 
   int bind_index = 1;
   std::string wildcard;
-  if (has_search) {
+  if (indexed) {
+    const std::string query = "{event_ticker category} : " + PhraseQuery(search);
+    sqlite3_bind_text(stmt, bind_index++, query.c_str(), -1, SQLITE_TRANSIENT);
+  } else if (has_search) {
     wildcard = "%" + search + "%";
     sqlite3_bind_text(stmt, bind_index++, wildcard.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, bind_index++, wildcard.c_str(), -1, SQLITE_TRANSIENT);
@@ -281,26 +1658,51 @@ std::vector<analytics::EventSummary> SQLiteStore::ListEvents(int limit, const st
     analytics::EventSummary summary;
     const unsigned char *event_ticker = sqlite3_column_text(stmt, 0);
     const unsigned char *category = sqlite3_column_text(stmt, 1);
-    const unsigned char *updated_at = sqlite3_column_text(stmt, 4);
     summary.event_ticker = event_ticker ? reinterpret_cast<const char *>(event_ticker) : "";
     summary.category = category ? reinterpret_cast<const char *>(category) : "";
     summary.market_count = sqlite3_column_int(stmt, 2);
     summary.total_volume = sqlite3_column_double(stmt, 3);
-    summary.updated_at = updated_at ? reinterpret_cast<const char *>(updated_at) : "";
+    summary.updated_at = sqlite3_column_int64(stmt, 4);
     results.push_back(summary);
   }
 
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
   return results;
 }
 
-void SQLiteStore::Exec(const std::string &sql) const {
+void SQLiteStore::AddColumnIfMissing(const std::string &table, const std::string &column, const std::string &type) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string sql = "PRAGMA table_info(" + table + ")";
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(writer_.db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+      spdlog::error("Failed to prepare table_info for {}", table);
+      return;
+    }
+    bool found = false;
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+      const unsigned char *name = sqlite3_column_text(stmt, 1);
+      found = name && column == reinterpret_cast<const char *>(name);
+    }
+    sqlite3_finalize(stmt);
+    if (found) {
+      return;
+    }
+  }
+  spdlog::info("Adding column {}.{}", table, column);
+  Exec("ALTER TABLE " + table + " ADD COLUMN " + column + " " + type);
+}
+
+bool SQLiteStore::Exec(const std::string &sql) const {
   std::lock_guard<std::mutex> lock(mutex_);
   char *err = nullptr;
-  if (sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+  if (sqlite3_exec(writer_.db, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
     spdlog::error("SQLite error: {}", err ? err : "unknown");
     sqlite3_free(err);
+    return false;
   }
+  return true;
 }
 
 }  // namespace storage
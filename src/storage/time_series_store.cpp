@@ -0,0 +1,558 @@
+#include "storage/time_series_store.h"
+
+#include "analytics/ticker_registry.h"
+#include "utils/time.h"
+
+#include <spdlog/spdlog.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+
+namespace storage {
+
+namespace {
+
+constexpr char kMagic[4] = {'K', 'T', 'S', '1'};
+constexpr uint32_t kColumns = 10;  // time + the nine SeriesChunk value columns
+constexpr size_t kHeaderBytes = 64;
+// A ticker's first segment; each next one doubles up to segment_rows. Most tickers see
+// few updates, and a full-size first segment would dirty one page per column.
+constexpr uint32_t kFirstSegmentRows = 64;
+
+enum Column : uint32_t {
+  kTime = 0,
+  kMid,
+  kSpread,
+  kProb,
+  kVolume,
+  kBidDepth,
+  kAskDepth,
+  kImbalance,
+  kMicroprice,
+};
+
+struct SegmentHeader {
+  char magic[4];
+  uint32_t columns;
+  uint32_t capacity;
+  uint32_t reserved;
+  // Written after the row's columns, so a crash mid-append never exposes a torn row.
+  uint64_t count;
+  int64_t first_time;
+  int64_t last_time;
+};
+static_assert(sizeof(SegmentHeader) <= kHeaderBytes, "segment header overflows its slot");
+
+size_t SegmentBytes(uint32_t capacity) {
+  return kHeaderBytes + static_cast<size_t>(kColumns) * capacity * sizeof(int64_t);
+}
+
+// Tickers become directory names; anything outside [A-Za-z0-9._-] (and a leading dot)
+// is percent-encoded so the mapping is reversible.
+std::string EncodeName(const std::string &ticker) {
+  static const char kHex[] = "0123456789ABCDEF";
+  std::string out;
+  out.reserve(ticker.size());
+  for (size_t i = 0; i < ticker.size(); ++i) {
+    const unsigned char c = static_cast<unsigned char>(ticker[i]);
+    if (std::isalnum(c) || c == '-' || c == '_' || (c == '.' && i > 0)) {
+      out.push_back(static_cast<char>(c));
+    } else {
+      out.push_back('%');
+      out.push_back(kHex[c >> 4]);
+      out.push_back(kHex[c & 0x0F]);
+    }
+  }
+  return out;
+}
+
+int HexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+// False for names EncodeName could not have produced, e.g. a stray directory.
+bool DecodeName(const std::string &name, std::string *ticker) {
+  ticker->clear();
+  ticker->reserve(name.size());
+  for (size_t i = 0; i < name.size(); ++i) {
+    if (name[i] != '%') {
+      ticker->push_back(name[i]);
+      continue;
+    }
+    const int high = i + 2 < name.size() ? HexDigit(name[i + 1]) : -1;
+    const int low = i + 2 < name.size() ? HexDigit(name[i + 2]) : -1;
+    if (high < 0 || low < 0) {
+      return false;
+    }
+    ticker->push_back(static_cast<char>(high * 16 + low));
+    i += 2;
+  }
+  return !ticker->empty();
+}
+
+// Index of a segment file name ("12.seg"), or false for anything else.
+bool SegmentIndex(const std::string &file_name, size_t *index) {
+  constexpr char kSuffix[] = ".seg";
+  const size_t digits = file_name.size() - std::min(file_name.size(), sizeof(kSuffix) - 1);
+  if (digits == 0 || digits > 9 || file_name.compare(digits, std::string::npos, kSuffix) != 0) {
+    return false;
+  }
+  size_t value = 0;
+  for (size_t i = 0; i < digits; ++i) {
+    if (!std::isdigit(static_cast<unsigned char>(file_name[i]))) {
+      return false;
+    }
+    value = value * 10 + static_cast<size_t>(file_name[i] - '0');
+  }
+  *index = value;
+  return true;
+}
+
+std::string SegmentPath(const std::string &series_path, size_t index) {
+  return series_path + "/" + std::to_string(index) + ".seg";
+}
+
+double BookValue(const analytics::FeatureRow &row, double value) {
+  return row.has_book ? value : std::numeric_limits<double>::quiet_NaN();
+}
+
+}  // namespace
+
+class TimeSeriesStore::Segment {
+ public:
+  // create makes a new file of capacity rows; otherwise the existing file's own
+  // capacity is used. Returns null (after logging) on failure.
+  static std::unique_ptr<Segment> Open(const std::string &path, uint32_t capacity, bool create) {
+    const int fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0644);
+    if (fd < 0) {
+      spdlog::error("Failed to open segment {}: {}", path, std::strerror(errno));
+      return nullptr;
+    }
+
+    size_t bytes = SegmentBytes(capacity);
+    if (create) {
+      if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        spdlog::error("Failed to size segment {}: {}", path, std::strerror(errno));
+        ::close(fd);
+        ::unlink(path.c_str());
+        return nullptr;
+      }
+    } else {
+      SegmentHeader header{};
+      struct stat info {};
+      if (::pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+          std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.columns != kColumns ||
+          header.count > header.capacity || ::fstat(fd, &info) != 0 ||
+          static_cast<size_t>(info.st_size) < SegmentBytes(header.capacity)) {
+        spdlog::error("Ignoring invalid segment {}", path);
+        ::close(fd);
+        return nullptr;
+      }
+      bytes = SegmentBytes(header.capacity);
+    }
+
+    void *base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping keeps the file open.
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      spdlog::error("Failed to map segment {}: {}", path, std::strerror(errno));
+      if (create) {
+        ::unlink(path.c_str());
+      }
+      return nullptr;
+    }
+
+    auto segment = std::unique_ptr<Segment>(new Segment(path, static_cast<char *>(base), bytes));
+    if (create) {
+      SegmentHeader *header = segment->header();
+      std::memcpy(header->magic, kMagic, sizeof(kMagic));
+      header->columns = kColumns;
+      header->capacity = capacity;
+      header->count = 0;
+    }
+    return segment;
+  }
+
+  ~Segment() { ::munmap(base_, bytes_); }
+
+  SegmentHeader *header() const { return reinterpret_cast<SegmentHeader *>(base_); }
+  uint64_t size() const { return header()->count; }
+  uint32_t capacity() const { return header()->capacity; }
+  bool full() const { return header()->count >= header()->capacity; }
+
+  template <typename T>
+  T *column(Column c) const {
+    return reinterpret_cast<T *>(base_ + kHeaderBytes + static_cast<size_t>(c) * header()->capacity * sizeof(T));
+  }
+
+  void Append(int64_t time, const analytics::FeatureRow &row) {
+    SegmentHeader *h = header();
+    const uint64_t i = h->count;
+    column<int64_t>(kTime)[i] = time;
+    column<double>(kMid)[i] = row.mid;
+    column<double>(kSpread)[i] = row.spread;
+    column<double>(kProb)[i] = row.prob;
+    column<double>(kVolume)[i] = row.volume;
+    column<double>(kBidDepth)[i] = BookValue(row, row.bid_depth);
+    column<double>(kAskDepth)[i] = BookValue(row, row.ask_depth);
+    column<double>(kImbalance)[i] = BookValue(row, row.imbalance);
+    column<double>(kMicroprice)[i] = BookValue(row, row.microprice);
+    if (i == 0) {
+      h->first_time = time;
+    }
+    h->last_time = time;
+    h->count = i + 1;
+  }
+
+  SeriesChunk Chunk(size_t begin, size_t end) const {
+    SeriesChunk chunk;
+    chunk.size = end - begin;
+    chunk.time = column<int64_t>(kTime) + begin;
+    chunk.mid = column<double>(kMid) + begin;
+    chunk.spread = column<double>(kSpread) + begin;
+    chunk.prob = column<double>(kProb) + begin;
+    chunk.volume = column<double>(kVolume) + begin;
+    chunk.bid_depth = column<double>(kBidDepth) + begin;
+    chunk.ask_depth = column<double>(kAskDepth) + begin;
+    chunk.imbalance = column<double>(kImbalance) + begin;
+    chunk.microprice = column<double>(kMicroprice) + begin;
+    return chunk;
+  }
+
+  void Sync() const { ::msync(base_, bytes_, MS_SYNC); }
+
+  const std::string &path() const { return path_; }
+
+  uint64_t DiskBytes() const {
+    struct stat info {};
+    return ::stat(path_.c_str(), &info) == 0 ? static_cast<uint64_t>(info.st_blocks) * 512 : 0;
+  }
+
+ private:
+  Segment(std::string path, char *base, size_t bytes) : path_(std::move(path)), base_(base), bytes_(bytes) {}
+
+  std::string path_;
+  char *base_;
+  size_t bytes_;
+};
+
+struct TimeSeriesStore::Series {
+  analytics::TickerId ticker = analytics::kNoTicker;
+  std::string path;
+  // Exclusive for Append, shared for scans.
+  mutable std::shared_mutex mutex;
+  std::vector<std::unique_ptr<Segment>> segments;
+  // File index of the next segment; past any invalid files skipped at load.
+  size_t next_index = 0;
+  int64_t last_time = std::numeric_limits<int64_t>::min();
+};
+
+namespace {
+
+analytics::FeatureRow RowAt(analytics::TickerId ticker, const SeriesChunk &chunk, size_t i) {
+  analytics::FeatureRow row;
+  row.ticker = ticker;
+  row.ts = chunk.time[i];
+  row.mid = chunk.mid[i];
+  row.spread = chunk.spread[i];
+  row.prob = chunk.prob[i];
+  row.volume = chunk.volume[i];
+  row.has_book = !std::isnan(chunk.bid_depth[i]);
+  if (row.has_book) {
+    row.bid_depth = chunk.bid_depth[i];
+    row.ask_depth = chunk.ask_depth[i];
+    row.imbalance = chunk.imbalance[i];
+    row.microprice = chunk.microprice[i];
+  }
+  return row;
+}
+
+}  // namespace
+
+TimeSeriesStore::TimeSeriesStore(std::string directory, TimeSeriesOptions options)
+    : directory_(std::move(directory)), options_(options) {
+  if (options_.segment_rows == 0) {
+    throw std::invalid_argument("Time series segments need at least one row");
+  }
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  if (error) {
+    throw std::runtime_error("Failed to create time series directory " + directory_ + ": " + error.message());
+  }
+
+  for (const auto &entry : std::filesystem::directory_iterator(directory_, error)) {
+    if (entry.is_directory()) {
+      LoadSeries(entry.path().filename().string());
+    }
+  }
+  const TimeSeriesStats loaded = stats();
+  spdlog::info("Time series store {}: {} series, {} rows in {} segments", directory_, loaded.series, loaded.rows,
+               loaded.segments);
+}
+
+TimeSeriesStore::~TimeSeriesStore() = default;
+
+void TimeSeriesStore::LoadSeries(const std::string &name) {
+  std::string ticker;
+  if (!DecodeName(name, &ticker)) {
+    spdlog::warn("Ignoring {}/{}: not a series directory", directory_, name);
+    return;
+  }
+  auto series = std::make_unique<Series>();
+  series->ticker = analytics::InternTicker(ticker);
+  if (series->ticker == analytics::kNoTicker) {
+    return;
+  }
+  series->path = directory_ + "/" + name;
+
+  std::vector<size_t> indexes;
+  std::error_code error;
+  for (const auto &entry : std::filesystem::directory_iterator(series->path, error)) {
+    size_t index = 0;
+    if (entry.is_regular_file() && SegmentIndex(entry.path().filename().string(), &index)) {
+      indexes.push_back(index);
+    }
+  }
+  std::sort(indexes.begin(), indexes.end());
+  for (const size_t index : indexes) {
+    // New segments go after every file on disk, valid or not, so appends never collide.
+    series->next_index = index + 1;
+    const std::string path = SegmentPath(series->path, index);
+    auto segment = Segment::Open(path, options_.segment_rows, false);
+    if (!segment) {
+      // Its rows are lost, but the segments around it stay in time order. Moved aside
+      // (and kept for inspection) so the next load does not trip over it again.
+      std::filesystem::rename(path, path + ".invalid", error);
+      ++invalid_segments_;
+      continue;
+    }
+    if (segment->size() > 0) {
+      series->last_time = segment->header()->last_time;
+    }
+    series->segments.push_back(std::move(segment));
+  }
+  series_.emplace(series->ticker, std::move(series));
+}
+
+TimeSeriesStore::Series *TimeSeriesStore::FindSeries(analytics::TickerId ticker) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  const auto iter = series_.find(ticker);
+  return iter != series_.end() ? iter->second.get() : nullptr;
+}
+
+TimeSeriesStore::Series &TimeSeriesStore::GetOrCreateSeries(analytics::TickerId ticker) {
+  if (Series *series = FindSeries(ticker)) {
+    return *series;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto &slot = series_[ticker];
+  if (!slot) {
+    slot = std::make_unique<Series>();
+    slot->ticker = ticker;
+    slot->path = directory_ + "/" + EncodeName(analytics::TickerName(ticker));
+  }
+  return *slot;
+}
+
+bool TimeSeriesStore::Append(const analytics::FeatureRow &row) {
+  if (row.ticker == analytics::kNoTicker) {
+    return false;
+  }
+  int64_t time = row.ts > 0 ? row.ts : utils::NowNanos();
+
+  Series &series = GetOrCreateSeries(row.ticker);
+  std::unique_lock<std::shared_mutex> lock(series.mutex);
+  if (series.segments.empty() || series.segments.back()->full()) {
+    if (series.segments.empty()) {
+      std::error_code error;
+      std::filesystem::create_directories(series.path, error);
+    }
+    const uint32_t capacity = series.segments.empty()
+                                  ? kFirstSegmentRows
+                                  : static_cast<uint32_t>(std::min<uint64_t>(
+                                        options_.segment_rows, uint64_t{series.segments.back()->capacity()} * 2));
+    // Advanced even on failure, so a file left in the way is stepped over next time.
+    auto segment = Segment::Open(SegmentPath(series.path, series.next_index++),
+                                 std::min(capacity, options_.segment_rows), true);
+    if (!segment) {
+      failed_appends_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    series.segments.push_back(std::move(segment));
+  }
+
+  time = std::max(time, series.last_time);
+  series.segments.back()->Append(time, row);
+  series.last_time = time;
+  return true;
+}
+
+void TimeSeriesStore::Scan(analytics::TickerId ticker, int64_t from_nanos, int64_t to_nanos,
+                           const std::function<void(const SeriesChunk &)> &visit) const {
+  const Series *series = FindSeries(ticker);
+  if (!series) {
+    return;
+  }
+  std::shared_lock<std::shared_mutex> lock(series->mutex);
+  for (const auto &segment : series->segments) {
+    const SegmentHeader *header = segment->header();
+    if (header->count == 0 || header->last_time < from_nanos || header->first_time > to_nanos) {
+      continue;
+    }
+    const int64_t *time = segment->column<int64_t>(kTime);
+    const int64_t *end = time + header->count;
+    const size_t begin = std::lower_bound(time, end, from_nanos) - time;
+    const size_t stop = std::upper_bound(time + begin, end, to_nanos) - time;
+    if (begin < stop) {
+      visit(segment->Chunk(begin, stop));
+    }
+  }
+}
+
+std::vector<analytics::FeatureRow> TimeSeriesStore::Latest(analytics::TickerId ticker, int limit) const {
+  std::vector<analytics::FeatureRow> results;
+  const Series *series = FindSeries(ticker);
+  if (!series || limit <= 0) {
+    return results;
+  }
+  std::shared_lock<std::shared_mutex> lock(series->mutex);
+  for (auto segment = series->segments.rbegin();
+       segment != series->segments.rend() && results.size() < static_cast<size_t>(limit); ++segment) {
+    const SeriesChunk chunk = (*segment)->Chunk(0, (*segment)->size());
+    for (size_t i = chunk.size; i > 0 && results.size() < static_cast<size_t>(limit); --i) {
+      results.push_back(RowAt(ticker, chunk, i - 1));
+    }
+  }
+  return results;
+}
+
+std::vector<analytics::FeatureRow> TimeSeriesStore::Range(analytics::TickerId ticker, int64_t from_nanos,
+                                                          int64_t to_nanos, int limit) const {
+  std::vector<analytics::FeatureRow> results;
+  const Series *series = FindSeries(ticker);
+  if (!series) {
+    return results;
+  }
+  const size_t wanted = limit > 0 ? static_cast<size_t>(limit) : std::numeric_limits<size_t>::max();
+  // Newest segment first, so a limited read stops without touching older segments.
+  std::shared_lock<std::shared_mutex> lock(series->mutex);
+  for (auto segment = series->segments.rbegin(); segment != series->segments.rend() && results.size() < wanted;
+       ++segment) {
+    const SegmentHeader *header = (*segment)->header();
+    if (header->count == 0 || header->first_time > to_nanos) {
+      continue;
+    }
+    if (header->last_time < from_nanos) {
+      break;
+    }
+    const int64_t *time = (*segment)->column<int64_t>(kTime);
+    const int64_t *end = time + header->count;
+    const size_t begin = std::lower_bound(time, end, from_nanos) - time;
+    const size_t stop = std::upper_bound(time + begin, end, to_nanos) - time;
+    const SeriesChunk chunk = (*segment)->Chunk(0, stop);
+    for (size_t i = stop; i > begin && results.size() < wanted; --i) {
+      results.push_back(RowAt(ticker, chunk, i - 1));
+    }
+  }
+  return results;
+}
+
+bool TimeSeriesStore::FirstTime(analytics::TickerId ticker, int64_t *first_nanos) const {
+  const Series *series = FindSeries(ticker);
+  if (!series) {
+    return false;
+  }
+  std::shared_lock<std::shared_mutex> lock(series->mutex);
+  for (const auto &segment : series->segments) {
+    if (segment->size() > 0) {
+      *first_nanos = segment->header()->first_time;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t TimeSeriesStore::DropBefore(int64_t before_nanos) {
+  std::vector<Series *> all;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    all.reserve(series_.size());
+    for (const auto &entry : series_) {
+      all.push_back(entry.second.get());
+    }
+  }
+
+  uint64_t rows = 0;
+  for (Series *series : all) {
+    // Exclusive, so no scan is still reading a mapping about to go away.
+    std::unique_lock<std::shared_mutex> lock(series->mutex);
+    size_t expired = 0;
+    while (expired < series->segments.size()) {
+      const Segment &segment = *series->segments[expired];
+      if (segment.size() == 0 || segment.header()->last_time >= before_nanos) {
+        break;
+      }
+      rows += segment.size();
+      if (::unlink(segment.path().c_str()) != 0) {
+        spdlog::warn("Failed to delete expired segment {}: {}", segment.path(), std::strerror(errno));
+      }
+      ++expired;
+    }
+    // last_time and next_index stay, so later rows still sort after the deleted ones and
+    // new files never reuse an old index.
+    series->segments.erase(series->segments.begin(), series->segments.begin() + static_cast<std::ptrdiff_t>(expired));
+    expired_segments_.fetch_add(expired, std::memory_order_relaxed);
+  }
+  return rows;
+}
+
+void TimeSeriesStore::Sync() {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  for (const auto &entry : series_) {
+    std::shared_lock<std::shared_mutex> series_lock(entry.second->mutex);
+    for (const auto &segment : entry.second->segments) {
+      segment->Sync();
+    }
+  }
+}
+
+TimeSeriesStats TimeSeriesStore::stats() const {
+  TimeSeriesStats stats;
+  stats.failed_appends = failed_appends_.load(std::memory_order_relaxed);
+  stats.invalid_segments = invalid_segments_;
+  stats.expired_segments = expired_segments_.load(std::memory_order_relaxed);
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  for (const auto &entry : series_) {
+    std::shared_lock<std::shared_mutex> series_lock(entry.second->mutex);
+    ++stats.series;
+    for (const auto &segment : entry.second->segments) {
+      ++stats.segments;
+      stats.rows += segment->size();
+      stats.disk_bytes += segment->DiskBytes();
+    }
+  }
+  return stats;
+}
+
+}  // namespace storage
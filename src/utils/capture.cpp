@@ -0,0 +1,69 @@
+#include "utils/capture.h"
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <stdexcept>
+
+namespace utils {
+
+namespace {
+constexpr char kMagic[] = "KRC1";
+}  // namespace
+
+CaptureWriter::CaptureWriter(const std::string &path) : out_(path, std::ios::binary | std::ios::app) {
+  if (!out_) {
+    throw std::runtime_error("Failed to open capture file: " + path);
+  }
+}
+
+void CaptureWriter::Write(long status, const std::string &url, const std::string &body) {
+  const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+  std::lock_guard<std::mutex> lock(mutex_);
+  out_ << kMagic << ' ' << now_ns << ' ' << status << ' ' << url.size() << ' ' << body.size() << '\n';
+  out_.write(url.data(), static_cast<std::streamsize>(url.size()));
+  out_.write(body.data(), static_cast<std::streamsize>(body.size()));
+  out_ << '\n';
+  // Flush per record so a crash loses at most the response in flight.
+  out_.flush();
+  ++records_;
+}
+
+uint64_t CaptureWriter::records() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return records_;
+}
+
+CaptureReader::CaptureReader(const std::string &path) : path_(path), in_(path, std::ios::binary) {
+  if (!in_) {
+    throw std::runtime_error("Failed to open capture file: " + path);
+  }
+}
+
+bool CaptureReader::Next(CaptureRecord *record) {
+  std::string magic;
+  size_t url_size = 0;
+  size_t body_size = 0;
+  if (!(in_ >> magic)) {
+    return false;
+  }
+  if (magic != kMagic || !(in_ >> record->captured_ns >> record->status >> url_size >> body_size) ||
+      in_.get() != '\n') {
+    spdlog::error("Corrupt capture record in {}", path_);
+    return false;
+  }
+
+  record->url.resize(url_size);
+  record->body.resize(body_size);
+  in_.read(&record->url[0], static_cast<std::streamsize>(url_size));
+  in_.read(&record->body[0], static_cast<std::streamsize>(body_size));
+  if (!in_ || in_.get() != '\n') {
+    spdlog::error("Truncated capture record in {}", path_);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace utils
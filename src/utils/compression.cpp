@@ -0,0 +1,164 @@
+#include "utils/compression.h"
+
+#include <zlib.h>
+
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+
+namespace utils {
+
+namespace {
+
+std::string_view Trim(std::string_view value) {
+  while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+    value.remove_prefix(1);
+  }
+  while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+    value.remove_suffix(1);
+  }
+  return value;
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if ((a[i] | 0x20) != (b[i] | 0x20)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+ContentEncoding NegotiateEncoding(std::string_view accept_encoding) {
+  bool gzip = false;
+  bool deflate = false;
+  while (!accept_encoding.empty()) {
+    const size_t comma = accept_encoding.find(',');
+    std::string_view item = accept_encoding.substr(0, comma);
+    accept_encoding = comma == std::string_view::npos ? std::string_view() : accept_encoding.substr(comma + 1);
+
+    const size_t semi = item.find(';');
+    const std::string_view coding = Trim(item.substr(0, semi));
+    bool accepted = true;
+    if (semi != std::string_view::npos) {
+      const std::string_view param = Trim(item.substr(semi + 1));
+      if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+        accepted = std::atof(std::string(param.substr(2)).c_str()) > 0.0;
+      }
+    }
+    if (EqualsIgnoreCase(coding, "gzip") || EqualsIgnoreCase(coding, "x-gzip")) {
+      gzip = accepted;
+    } else if (EqualsIgnoreCase(coding, "deflate")) {
+      deflate = accepted;
+    }
+  }
+  return gzip ? ContentEncoding::kGzip : deflate ? ContentEncoding::kDeflate : ContentEncoding::kIdentity;
+}
+
+const char *EncodingName(ContentEncoding encoding) {
+  switch (encoding) {
+    case ContentEncoding::kGzip:
+      return "gzip";
+    case ContentEncoding::kDeflate:
+      return "deflate";
+    case ContentEncoding::kIdentity:
+      break;
+  }
+  return "identity";
+}
+
+bool Compress(std::string_view input, ContentEncoding encoding, std::string *out, int level) {
+  if (encoding == ContentEncoding::kIdentity) {
+    return false;
+  }
+
+  z_stream stream{};
+  // windowBits + 16 selects the gzip wrapper; plain 15 is the zlib wrapper HTTP calls deflate.
+  const int window_bits = encoding == ContentEncoding::kGzip ? 15 + 16 : 15;
+  if (deflateInit2(&stream, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+
+  out->resize(deflateBound(&stream, static_cast<uLong>(input.size())) + 32);
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  stream.next_out = reinterpret_cast<Bytef *>(&(*out)[0]);
+  stream.avail_out = static_cast<uInt>(out->size());
+
+  const int result = deflate(&stream, Z_FINISH);
+  out->resize(stream.total_out);
+  deflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
+
+struct DictionaryCompressor::Stream {
+  z_stream z{};
+  bool ready = false;
+};
+
+DictionaryCompressor::DictionaryCompressor(std::string dictionary, int level)
+    : dictionary_(std::move(dictionary)), stream_(std::make_unique<Stream>()) {
+  // Negative window bits: raw deflate, no zlib header or checksum per document.
+  if (deflateInit2(&stream_->z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("Failed to initialise deflate stream");
+  }
+  stream_->ready = true;
+}
+
+DictionaryCompressor::~DictionaryCompressor() {
+  if (stream_->ready) {
+    deflateEnd(&stream_->z);
+  }
+}
+
+bool DictionaryCompressor::Compress(std::string_view input, std::string *out) {
+  z_stream &stream = stream_->z;
+  if (deflateReset(&stream) != Z_OK ||
+      deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dictionary_.data()),
+                           static_cast<uInt>(dictionary_.size())) != Z_OK) {
+    return false;
+  }
+
+  out->resize(deflateBound(&stream, static_cast<uLong>(input.size())) + 32);
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  stream.next_out = reinterpret_cast<Bytef *>(&(*out)[0]);
+  stream.avail_out = static_cast<uInt>(out->size());
+
+  const int result = deflate(&stream, Z_FINISH);
+  out->resize(stream.total_out);
+  return result == Z_STREAM_END;
+}
+
+bool InflateWithDictionary(std::string_view input, std::string_view dictionary, size_t expected_size,
+                           std::string *out) {
+  z_stream stream{};
+  if (inflateInit2(&stream, -15) != Z_OK) {
+    return false;
+  }
+  // Raw streams take the dictionary up front rather than on Z_NEED_DICT.
+  if (inflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dictionary.data()),
+                           static_cast<uInt>(dictionary.size())) != Z_OK) {
+    inflateEnd(&stream);
+    return false;
+  }
+
+  out->resize(expected_size);
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  stream.next_out = reinterpret_cast<Bytef *>(&(*out)[0]);
+  stream.avail_out = static_cast<uInt>(out->size());
+
+  const int result = inflate(&stream, Z_FINISH);
+  const bool ok = result == Z_STREAM_END && stream.total_out == expected_size;
+  out->resize(stream.total_out);
+  inflateEnd(&stream);
+  return ok;
+}
+
+}  // namespace utils
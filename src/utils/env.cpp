@@ -33,4 +33,27 @@ double GetEnvDouble(const std::string &key, double default_value) {
   return std::atof(value.c_str());
 }
 
+std::vector<std::string> GetEnvList(const std::string &key) {
+  return SplitList(GetEnv(key, ""));
+}
+
+std::vector<std::string> SplitList(const std::string &value) {
+  std::vector<std::string> items;
+  size_t start = 0;
+  while (start <= value.size()) {
+    size_t end = value.find(',', start);
+    if (end == std::string::npos) {
+      end = value.size();
+    }
+    std::string item = value.substr(start, end - start);
+    item.erase(0, item.find_first_not_of(" \t"));
+    item.erase(item.find_last_not_of(" \t") + 1);
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+    start = end + 1;
+  }
+  return items;
+}
+
 }  // namespace utils
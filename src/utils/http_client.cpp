@@ -39,75 +39,207 @@ size_t WriteHeader(char *buffer, size_t size, size_t nitems, void *userdata) {
 
 }  // namespace
 
-HttpClient::HttpClient() : curl_(curl_easy_init()) {
-  if (!curl_) {
+struct HttpClient::Transfer {
+  std::string url;
+  std::string method;
+  std::string body;
+  struct curl_slist *header_list = nullptr;
+  std::string response_body;
+  std::map<std::string, std::string> response_headers;
+  std::promise<HttpResponse> promise;
+
+  ~Transfer() {
+    if (header_list) {
+      curl_slist_free_all(header_list);
+    }
+  }
+};
+
+HttpClient::HttpClient(HttpClientOptions options)
+    : options_(options), multi_(curl_multi_init()), share_(curl_share_init()) {
+  if (!multi_ || !share_) {
     throw std::runtime_error("Failed to init curl");
   }
+
+  // All handles live on the loop thread, so the share needs no lock callbacks.
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+
+  curl_multi_setopt(multi_, CURLMOPT_PIPELINING, options_.http2 ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING);
+  curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, options_.max_host_connections);
+
+  worker_ = std::thread([this]() { Run(); });
 }
 
 HttpClient::~HttpClient() {
-  if (curl_) {
-    curl_easy_cleanup(curl_);
+  stop_ = true;
+  curl_multi_wakeup(multi_);
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+
+  for (auto &entry : active_) {
+    curl_multi_remove_handle(multi_, entry.first);
+    entry.second->promise.set_value(HttpResponse{});
+    curl_easy_cleanup(entry.first);
+  }
+  for (auto &transfer : queued_) {
+    transfer->promise.set_value(HttpResponse{});
+  }
+  for (CURL *easy : idle_handles_) {
+    curl_easy_cleanup(easy);
   }
+
+  curl_multi_cleanup(multi_);
+  curl_share_cleanup(share_);
 }
 
 HttpResponse HttpClient::Get(const std::string &url, const std::map<std::string, std::string> &headers) {
-  return Execute(url, "GET", "", headers);
+  return GetAsync(url, headers).get();
 }
 
 HttpResponse HttpClient::Post(const std::string &url,
                               const std::string &body,
                               const std::map<std::string, std::string> &headers) {
-  return Execute(url, "POST", body, headers);
+  return PostAsync(url, body, headers).get();
 }
 
-HttpResponse HttpClient::Execute(const std::string &url,
-                                 const std::string &method,
-                                 const std::string &body,
-                                 const std::map<std::string, std::string> &headers) {
-  HttpResponse response;
-  std::string response_body;
-  std::map<std::string, std::string> response_headers;
+std::future<HttpResponse> HttpClient::GetAsync(const std::string &url,
+                                               const std::map<std::string, std::string> &headers) {
+  return Submit(url, "GET", "", headers);
+}
 
-  curl_easy_reset(curl_);
-  curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, method.c_str());
-  curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, WriteBody);
-  curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &response_body);
-  curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, WriteHeader);
-  curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &response_headers);
-  curl_easy_setopt(curl_, CURLOPT_TIMEOUT, 20L);
-  curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L);
+std::future<HttpResponse> HttpClient::PostAsync(const std::string &url,
+                                                const std::string &body,
+                                                const std::map<std::string, std::string> &headers) {
+  return Submit(url, "POST", body, headers);
+}
 
-  struct curl_slist *header_list = nullptr;
+std::future<HttpResponse> HttpClient::Submit(const std::string &url,
+                                             const std::string &method,
+                                             const std::string &body,
+                                             const std::map<std::string, std::string> &headers) {
+  auto transfer = std::make_unique<Transfer>();
+  transfer->url = url;
+  transfer->method = method;
+  transfer->body = body;
   for (const auto &kv : headers) {
     std::string entry = kv.first + ": " + kv.second;
-    header_list = curl_slist_append(header_list, entry.c_str());
+    transfer->header_list = curl_slist_append(transfer->header_list, entry.c_str());
+  }
+
+  std::future<HttpResponse> result = transfer->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_.push_back(std::move(transfer));
+  }
+  curl_multi_wakeup(multi_);
+  return result;
+}
+
+void HttpClient::Run() {
+  while (!stop_) {
+    std::vector<std::unique_ptr<Transfer>> incoming;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      incoming.swap(queued_);
+    }
+    for (auto &transfer : incoming) {
+      Start(std::move(transfer));
+    }
+
+    int running = 0;
+    curl_multi_perform(multi_, &running);
+
+    int remaining = 0;
+    while (CURLMsg *msg = curl_multi_info_read(multi_, &remaining)) {
+      if (msg->msg == CURLMSG_DONE) {
+        Finish(msg->easy_handle, msg->data.result);
+      }
+    }
+
+    curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+  }
+}
+
+void HttpClient::Start(std::unique_ptr<Transfer> transfer) {
+  CURL *easy = nullptr;
+  if (!idle_handles_.empty()) {
+    easy = idle_handles_.back();
+    idle_handles_.pop_back();
+    curl_easy_reset(easy);
+  } else {
+    easy = curl_easy_init();
   }
-  if (header_list) {
-    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, header_list);
+  if (!easy) {
+    spdlog::error("HTTP {} {} failed: could not allocate curl handle", transfer->method, transfer->url);
+    transfer->promise.set_value(HttpResponse{});
+    return;
   }
 
-  if (method == "POST") {
-    curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, body.c_str());
-    curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+  curl_easy_setopt(easy, CURLOPT_URL, transfer->url.c_str());
+  curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, transfer->method.c_str());
+  curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteBody);
+  curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response_body);
+  curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, WriteHeader);
+  curl_easy_setopt(easy, CURLOPT_HEADERDATA, &transfer->response_headers);
+  curl_easy_setopt(easy, CURLOPT_TIMEOUT, options_.timeout_seconds);
+  curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(easy, CURLOPT_SHARE, share_);
+  if (options_.compression) {
+    // "" advertises every built-in coding (gzip, deflate, br, zstd as available).
+    curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "");
+  }
+  if (options_.http2) {
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    // Prefer waiting for a multiplexed stream over opening another connection.
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
   }
 
-  const CURLcode code = curl_easy_perform(curl_);
-  if (code != CURLE_OK) {
-    spdlog::error("HTTP {} {} failed: {}", method, url, curl_easy_strerror(code));
+  if (transfer->header_list) {
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->header_list);
   }
 
-  curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &response.status);
+  if (transfer->method == "POST") {
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDS, transfer->body.c_str());
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, static_cast<long>(transfer->body.size()));
+  }
 
-  response.body = std::move(response_body);
-  response.headers = std::move(response_headers);
+  curl_multi_add_handle(multi_, easy);
+  active_[easy] = std::move(transfer);
+}
 
-  if (header_list) {
-    curl_slist_free_all(header_list);
+void HttpClient::Finish(CURL *easy, CURLcode result) {
+  auto iter = active_.find(easy);
+  if (iter == active_.end()) {
+    return;
   }
+  std::unique_ptr<Transfer> transfer = std::move(iter->second);
+  active_.erase(iter);
+
+  if (result != CURLE_OK) {
+    spdlog::error("HTTP {} {} failed: {}", transfer->method, transfer->url, curl_easy_strerror(result));
+  }
+
+  HttpResponse response;
+  curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response.status);
+  response.body = std::move(transfer->response_body);
+  response.headers = std::move(transfer->response_headers);
+
+  curl_off_t wire = 0;
+  curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &wire);
+  wire_bytes_.fetch_add(static_cast<uint64_t>(wire), std::memory_order_relaxed);
+  decoded_bytes_.fetch_add(response.body.size(), std::memory_order_relaxed);
+  if (options_.capture && result == CURLE_OK) {
+    options_.capture->Write(response.status, transfer->url, response.body);
+  }
+
+  curl_multi_remove_handle(multi_, easy);
+  idle_handles_.push_back(easy);
 
-  return response;
+  transfer->promise.set_value(std::move(response));
 }
 
 }  // namespace utils
@@ -0,0 +1,58 @@
+#include "utils/latency_histogram.h"
+
+namespace utils {
+
+int LatencyHistogram::BucketFor(uint64_t nanos) {
+  if (nanos < kSubBuckets) {
+    return static_cast<int>(nanos);
+  }
+  int msb = 63;
+  while (!(nanos >> msb)) {
+    --msb;
+  }
+  const int shift = msb - kSubBits;
+  const int sub = static_cast<int>((nanos >> shift) & (kSubBuckets - 1));
+  return (shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::UpperEdge(int bucket) {
+  if (bucket < kSubBuckets) {
+    return static_cast<uint64_t>(bucket);
+  }
+  const int shift = bucket / kSubBuckets - 1;
+  const uint64_t sub = static_cast<uint64_t>(bucket % kSubBuckets);
+  return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t nanos) {
+  buckets_[BucketFor(nanos)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_.fetch_add(nanos, std::memory_order_relaxed);
+  uint64_t prev = max_.load(std::memory_order_relaxed);
+  while (nanos > prev && !max_.compare_exchange_weak(prev, nanos, std::memory_order_relaxed)) {
+  }
+}
+
+double LatencyHistogram::MeanNanos() const {
+  const uint64_t n = count();
+  return n > 0 ? static_cast<double>(total_.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+uint64_t LatencyHistogram::PercentileNanos(double p) const {
+  const uint64_t n = count();
+  if (n == 0) {
+    return 0;
+  }
+  const uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(n - 1)) + 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      const uint64_t edge = UpperEdge(i);
+      return edge < max() ? edge : max();
+    }
+  }
+  return max();
+}
+
+}  // namespace utils
@@ -0,0 +1,64 @@
+#include "utils/rate_limiter.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace utils {
+
+RateLimiter::RateLimiter(double requests_per_second, double burst)
+    : rate_(requests_per_second),
+      burst_(std::max(burst, 1.0)),
+      tokens_(std::max(burst, 1.0)),
+      last_refill_(Clock::now()),
+      paused_until_(Clock::now()) {}
+
+void RateLimiter::Acquire() {
+  bool waited = false;
+  while (true) {
+    Clock::duration wait{};
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto now = Clock::now();
+      if (now < paused_until_) {
+        wait = paused_until_ - now;
+      } else if (rate_ <= 0.0) {
+        break;
+      } else {
+        const double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+        tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+        last_refill_ = now;
+        if (tokens_ >= 1.0) {
+          tokens_ -= 1.0;
+          break;
+        }
+        wait = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1.0 - tokens_) / rate_));
+      }
+      if (!waited) {
+        waited = true;
+        ++waits_;
+      }
+    }
+    std::this_thread::sleep_for(wait);
+  }
+}
+
+void RateLimiter::Backoff(std::chrono::milliseconds delay) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  paused_until_ = std::max(paused_until_, Clock::now() + delay);
+  // Restart from an empty bucket so the resume is not an immediate burst.
+  tokens_ = 0.0;
+  last_refill_ = paused_until_;
+  ++backoffs_;
+}
+
+uint64_t RateLimiter::waits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return waits_;
+}
+
+uint64_t RateLimiter::backoffs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return backoffs_;
+}
+
+}  // namespace utils
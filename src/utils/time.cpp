@@ -0,0 +1,149 @@
+#include "utils/time.h"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+namespace utils {
+
+namespace {
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar (Howard Hinnant's
+// days_from_civil), so parsing does not depend on timegm/_mkgmtime.
+int64_t DaysFromCivil(int64_t year, unsigned month, unsigned day) {
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+  const unsigned day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
+
+bool ReadDigits(std::string_view text, size_t *pos, size_t count, int *value) {
+  if (*pos + count > text.size()) {
+    return false;
+  }
+  int result = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const char c = text[*pos + i];
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    result = result * 10 + (c - '0');
+  }
+  *pos += count;
+  *value = result;
+  return true;
+}
+
+bool Expect(std::string_view text, size_t *pos, char c) {
+  if (*pos >= text.size() || text[*pos] != c) {
+    return false;
+  }
+  ++*pos;
+  return true;
+}
+
+}  // namespace
+
+std::string FormatIso8601(int64_t unix_seconds) {
+  const std::time_t time = static_cast<std::time_t>(unix_seconds);
+  std::tm tm{};
+#if defined(_WIN32)
+  gmtime_s(&tm, &time);
+#else
+  gmtime_r(&time, &tm);
+#endif
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm);
+  return std::string(buffer);
+}
+
+std::string NowIso8601() {
+  using namespace std::chrono;
+  return FormatIso8601(duration_cast<seconds>(system_clock::now().time_since_epoch()).count());
+}
+
+std::string FormatIso8601Nanos(int64_t unix_nanos) {
+  int64_t seconds = unix_nanos / kNanosPerSecond;
+  int64_t fraction = unix_nanos % kNanosPerSecond;
+  if (fraction < 0) {
+    fraction += kNanosPerSecond;
+    --seconds;
+  }
+  std::string text = FormatIso8601(seconds);
+  if (fraction == 0) {
+    return text;
+  }
+  char digits[16];
+  std::snprintf(digits, sizeof(digits), ".%09lld", static_cast<long long>(fraction));
+  std::string_view trimmed(digits);
+  while (trimmed.back() == '0') {
+    trimmed.remove_suffix(1);
+  }
+  text.insert(text.size() - 1, trimmed.data(), trimmed.size());
+  return text;
+}
+
+bool ParseIso8601(std::string_view text, int64_t *unix_nanos) {
+  size_t pos = 0;
+  int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+  if (!ReadDigits(text, &pos, 4, &year) || !Expect(text, &pos, '-') || !ReadDigits(text, &pos, 2, &month) ||
+      !Expect(text, &pos, '-') || !ReadDigits(text, &pos, 2, &day) ||
+      !(Expect(text, &pos, 'T') || Expect(text, &pos, ' ')) || !ReadDigits(text, &pos, 2, &hour) ||
+      !Expect(text, &pos, ':') || !ReadDigits(text, &pos, 2, &minute) || !Expect(text, &pos, ':') ||
+      !ReadDigits(text, &pos, 2, &second)) {
+    return false;
+  }
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return false;
+  }
+
+  int64_t fraction = 0;
+  if (pos < text.size() && text[pos] == '.') {
+    ++pos;
+    int64_t scale = kNanosPerSecond;
+    const size_t start = pos;
+    for (; pos < text.size() && text[pos] >= '0' && text[pos] <= '9'; ++pos) {
+      if (scale > 1) {
+        scale /= 10;
+        fraction += (text[pos] - '0') * scale;
+      }
+    }
+    if (pos == start) {
+      return false;
+    }
+  }
+
+  int64_t offset_seconds = 0;
+  if (pos < text.size() && (text[pos] == 'Z' || text[pos] == 'z')) {
+    ++pos;
+  } else if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+    const int sign = text[pos] == '-' ? -1 : 1;
+    ++pos;
+    int offset_hours = 0, offset_minutes = 0;
+    if (!ReadDigits(text, &pos, 2, &offset_hours)) {
+      return false;
+    }
+    Expect(text, &pos, ':');
+    if (!ReadDigits(text, &pos, 2, &offset_minutes)) {
+      return false;
+    }
+    offset_seconds = sign * (offset_hours * 3600 + offset_minutes * 60);
+  }
+  if (pos != text.size()) {
+    return false;
+  }
+
+  const int64_t seconds = DaysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day)) * 86400 +
+                          hour * 3600 + minute * 60 + second - offset_seconds;
+  *unix_nanos = seconds * kNanosPerSecond + fraction;
+  return true;
+}
+
+int64_t NowNanos() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace utils
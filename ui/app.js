@@ -7,6 +7,8 @@ const state = {
   lastMarketLoad: null,
   autoRefresh: true,
   intervalId: null,
+  stream: null,
+  streamTicker: "",
   heatmapTickers: [],
   error: null,
   featureRequestId: 0,
@@ -104,6 +106,17 @@ async function fetchHealth() {
   }
 }
 
+async function waitForJob(job) {
+  const deadline = Date.now() + 120000;
+  while ((job.state === "queued" || job.state === "running") && Date.now() < deadline) {
+    await new Promise((resolve) => setTimeout(resolve, 500));
+    const res = await fetch(`/markets/refresh/${job.id}`);
+    if (!res.ok) break;
+    job = await res.json();
+  }
+  return job;
+}
+
 async function refreshMarkets() {
   const limit = parseInt(els.refreshLimit.value || "100", 10);
   els.refreshBtn.disabled = true;
@@ -114,6 +127,11 @@ async function refreshMarkets() {
       showError("Refresh", `HTTP ${res.status}`);
       return;
     }
+    const job = await waitForJob(await res.json());
+    if (job.state === "failed") {
+      showError("Refresh", job.error || "Refresh failed");
+      return;
+    }
     clearError("Refresh");
     state.lastRefresh = new Date();
     updateSystem();
@@ -169,6 +187,9 @@ async function loadFeatures() {
     state.features = data;
     renderFeatures();
     clearError("Features");
+    if (state.autoRefresh && state.streamTicker !== ticker) {
+      openStream();
+    }
   } catch (err) {
     console.error(err);
     if (requestId === state.featureRequestId) {
@@ -515,58 +536,26 @@ async function loadHeatmap() {
     return;
   }
 
-  const seriesMap = new Map();
-  await Promise.all(
-    candidates.map(async (ticker) => {
-      try {
-        const res = await fetch(`/features/${encodeURIComponent(ticker)}?limit=50`);
-        if (!res.ok) return;
-        const rows = await res.json();
-        const series = rows.slice().reverse().map((row) => row.mid).filter((v) => v > 0);
-        if (series.length >= 5) {
-          seriesMap.set(ticker, series);
-        }
-      } catch (err) {
-        console.error(err);
-      }
-    })
-  );
+  let data;
+  try {
+    const url = new URL("/correlations", window.location.origin);
+    url.searchParams.set("tickers", candidates.join(","));
+    const res = await fetch(url.toString());
+    if (!res.ok) return;
+    data = await res.json();
+  } catch (err) {
+    console.error(err);
+    return;
+  }
 
-  const tickers = Array.from(seriesMap.keys());
-  if (tickers.length < 2) {
+  // Maintained by the server over every refresh; null where a pair has no estimate yet.
+  if (data.tickers.length < 2) {
     renderHeatmap([], []);
     return;
   }
 
-  const minLen = Math.min(...Array.from(seriesMap.values()).map((s) => s.length));
-  const aligned = tickers.map((t) => seriesMap.get(t).slice(-minLen));
-  const matrix = tickers.map((_, i) =>
-    tickers.map((__, j) => (i === j ? 1 : pearson(aligned[i], aligned[j])))
-  );
-
-  state.heatmapTickers = tickers;
-  renderHeatmap(tickers, matrix);
-}
-
-function pearson(a, b) {
-  const n = Math.min(a.length, b.length);
-  if (n === 0) return 0;
-  let sumA = 0;
-  let sumB = 0;
-  let sumA2 = 0;
-  let sumB2 = 0;
-  let sumAB = 0;
-  for (let i = 0; i < n; i += 1) {
-    sumA += a[i];
-    sumB += b[i];
-    sumA2 += a[i] * a[i];
-    sumB2 += b[i] * b[i];
-    sumAB += a[i] * b[i];
-  }
-  const numerator = n * sumAB - sumA * sumB;
-  const denom = Math.sqrt((n * sumA2 - sumA * sumA) * (n * sumB2 - sumB * sumB));
-  if (denom === 0) return 0;
-  return numerator / denom;
+  state.heatmapTickers = data.tickers;
+  renderHeatmap(data.tickers, data.matrix);
 }
 
 function renderHeatmap(tickers, matrix) {
@@ -591,9 +580,10 @@ function renderHeatmap(tickers, matrix) {
       const value = matrix[i][j];
       const cell = document.createElement("div");
       cell.className = "heatmap-cell";
+      const text = value === null ? "–" : value.toFixed(2);
       cell.style.background = corrColor(value);
-      cell.textContent = value.toFixed(2);
-      cell.title = `${rowTicker} vs ${colTicker}: ${value.toFixed(2)}`;
+      cell.textContent = text;
+      cell.title = `${rowTicker} vs ${colTicker}: ${text}`;
       els.heatmapGrid.appendChild(cell);
     });
   });
@@ -612,6 +602,7 @@ function shortTicker(ticker) {
 }
 
 function corrColor(value) {
+  if (value === null) return "hsl(220, 10%, 35%)";
   const normalized = (value + 1) / 2;
   const hue = 10 + normalized * 110;
   return `hsl(${hue}, 70%, 50%)`;
@@ -625,29 +616,83 @@ function updateSystem() {
     ? state.lastRefresh.toLocaleTimeString()
     : "--";
   els.systemNote.textContent = state.autoRefresh
-    ? "Auto refresh is enabled. Alerts and features update every 10 seconds."
-    : "Auto refresh is paused. Use manual refresh or load features.";
+    ? "Live updates are enabled. Alerts and features are pushed as markets are ingested."
+    : "Live updates are paused. Use manual refresh or load features.";
+}
+
+function handleAlertEvent(event) {
+  state.alerts.unshift(JSON.parse(event.data));
+  state.alerts.length = Math.min(state.alerts.length, 100);
+  renderAlerts();
+  renderTimeline();
+  updateSystem();
+}
+
+function handleFeatureEvent(event) {
+  const feature = JSON.parse(event.data);
+  if (feature.ticker !== state.ticker) return;
+  state.features.unshift(feature);
+  state.features.length = Math.min(state.features.length, 80);
+  renderFeatures();
+  updateSystem();
+}
+
+// Reloads what the stream may have missed: before it (re)connected, or events the
+// server dropped because this tab fell behind.
+function resyncFromRest() {
+  loadAlerts();
+  if (state.ticker) {
+    loadFeatures();
+  }
+}
+
+function closeStream() {
+  if (state.stream) {
+    state.stream.close();
+    state.stream = null;
+  }
+  state.streamTicker = "";
+}
+
+function openStream() {
+  closeStream();
+  const url = new URL("/stream", window.location.origin);
+  if (state.ticker) {
+    url.searchParams.set("tickers", state.ticker);
+  }
+  const stream = new EventSource(url.toString());
+  stream.addEventListener("alert", handleAlertEvent);
+  stream.addEventListener("feature", handleFeatureEvent);
+  stream.addEventListener("lagged", resyncFromRest);
+  stream.addEventListener("open", () => {
+    clearError("Stream");
+    resyncFromRest();
+  });
+  // EventSource reconnects on its own; the open handler then fills the gap.
+  stream.addEventListener("error", () => {
+    if (stream.readyState !== EventSource.OPEN) {
+      showError("Stream", "Live updates disconnected, reconnecting");
+    }
+  });
+  state.stream = stream;
+  state.streamTicker = state.ticker;
 }
 
 function startAutoRefresh() {
   clearInterval(state.intervalId);
   if (!state.autoRefresh) {
+    closeStream();
     updateLiveIndicator();
     return;
   }
 
-  let tick = 0;
+  openStream();
+  // Alerts and features arrive on the stream; market lists are still polled, and
+  // answered with 304 while nothing changed.
   state.intervalId = setInterval(async () => {
-    tick += 1;
     await fetchHealth();
-    await loadAlerts();
-    if (state.ticker) {
-      await loadFeatures();
-    }
-    if (tick % 3 === 0) {
-      await loadMarkets();
-    }
-  }, 10000);
+    await loadMarkets();
+  }, 30000);
   updateLiveIndicator();
 }
 